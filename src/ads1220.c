@@ -0,0 +1,186 @@
+/* ****************************************************************************/
+/** ADS1220 Backend Library
+
+  @File Name
+    ads1220.c
+
+  @Summary
+    Strain gauge backend for the ti ads1220 24 bit delta sigma adc
+
+  @Description
+    Implements the register encoding, the decoding, and the nordic sdk spi / gpio glue.
+    Change the glue if you're using a different micro.
+******************************************************************************/
+
+#include "ads1220.h"
+
+static bool ads1220_is_ready(void);
+static int32_t ads1220_read_raw(void);
+
+// ratiometric, the reference is the excitation so the input range is +-VE/gain
+StrainGaugeBackend ads1220_backend = {
+    .name = "ads1220",
+    .is_ready = ads1220_is_ready,
+    .read_raw = ads1220_read_raw,
+    .sample_rate = 20,
+    .resolution_bits = 24,
+    .full_scale = 1.0f,
+    .gain = 128,
+};
+
+/*
+    @brief Build the configuration registers
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @param[in] gain ADS1220_GAIN_ value
+
+    @param[out] regs ADS1220_REG_COUNT register values, register 0 first
+*/
+void ads1220_encode_config(uint8_t rate, uint8_t gain, uint8_t * regs) {
+    if(rate > ADS1220_RATE_1000)
+	rate = ADS1220_RATE_20;
+    if(gain > ADS1220_GAIN_128)
+	gain = ADS1220_GAIN_128;
+    regs[0] = (uint8_t)(gain << 1); // MUX AIN0/AIN1, pga enabled
+    regs[1] = (uint8_t)(rate << 5) | 0x04; // normal mode, continuous conversion
+    regs[2] = 0x40; // external reference REFP0/REFN0, no 50/60 Hz filter, low side switch open
+    regs[3] = 0x00; // current sources off, DRDY on its own pin
+}
+
+/*
+    @brief Decode the bytes of one conversion
+
+    @param[in] rx ADS1220_DATA_BYTES bytes, msb first
+
+    @ret Sign extended 24 bit count
+*/
+int32_t ads1220_decode(const uint8_t * rx) {
+    uint32_t value = ((uint32_t)rx[0] << 16) | ((uint32_t)rx[1] << 8) | rx[2];
+    if(value & 0x800000)
+	value |= 0xFF000000; // sign extend
+    return (int32_t)value;
+}
+
+/*
+    @brief Conversions per second for a data rate
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @ret Conversions per second, 20 for out of range codes
+*/
+float ads1220_sample_rate(uint8_t rate) {
+    static const float rates[] = {20, 45, 90, 175, 330, 600, 1000};
+    return rate <= ADS1220_RATE_1000 ? rates[rate] : rates[ADS1220_RATE_20];
+}
+
+#ifndef ADS1220_HOST
+
+#include "nrf_drv_spi.h" // nordic sdk specific spi driver
+#include "nrf_gpio.h" // nordic sdk specific gpio
+#include "nrf_delay.h" // nordic sdk specific delays
+
+static const nrf_drv_spi_t spi = NRF_DRV_SPI_INSTANCE(1);
+static uint32_t drdy;
+
+/*
+    @brief DRDY is low while a conversion is waiting to be read
+*/
+static bool ads1220_is_ready(void) {
+    return nrf_gpio_pin_read(drdy) == 0;
+}
+
+/*
+    @brief Read the latest conversion
+
+    @note RDATA works in every mode and doesn't depend on where DRDY is, DRDY goes back high
+	once the data is clocked out
+
+    @ret Sign extended 24 bit count, SG_RAW_INVALID if the transfer failed
+*/
+static int32_t ads1220_read_raw(void) {
+    uint8_t tx[1 + ADS1220_DATA_BYTES] = {ADS1220_CMD_RDATA};
+    uint8_t rx[1 + ADS1220_DATA_BYTES];
+    if(nrf_drv_spi_transfer(&spi, tx, sizeof(tx), rx, sizeof(rx)) != NRF_SUCCESS)
+	return SG_RAW_INVALID; // 0 is a real mid scale count
+    return ads1220_decode(rx + 1);
+}
+
+/*
+    @brief Set up the ads1220 and fill in ads1220_backend
+
+    @param[in] sck_pin Spi clock
+
+    @param[in] mosi_pin Spi MOSI, ads1220 DIN
+
+    @param[in] miso_pin Spi MISO, ads1220 DOUT
+
+    @param[in] cs_pin Chip select
+
+    @param[in] drdy_pin ads1220 DRDY
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @param[in] gain ADS1220_GAIN_ value
+
+    @ret true if the adc was found and configured
+*/
+bool ads1220_init(uint32_t sck_pin, uint32_t mosi_pin, uint32_t miso_pin, uint32_t cs_pin,
+	uint32_t drdy_pin, uint8_t rate, uint8_t gain) {
+    nrf_drv_spi_config_t spi_config = NRF_DRV_SPI_DEFAULT_CONFIG;
+    spi_config.sck_pin = sck_pin;
+    spi_config.mosi_pin = mosi_pin;
+    spi_config.miso_pin = miso_pin;
+    spi_config.ss_pin = cs_pin;
+    spi_config.frequency = NRF_DRV_SPI_FREQ_4M;
+    spi_config.mode = NRF_DRV_SPI_MODE_1; // DIN latched and DOUT shifted on the falling edge
+    spi_config.bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST;
+    if(nrf_drv_spi_init(&spi, &spi_config, NULL, NULL) != NRF_SUCCESS) // no handler, blocking
+	return false;
+    drdy = drdy_pin;
+    nrf_gpio_cfg_input(drdy_pin, NRF_GPIO_PIN_PULLUP);
+
+    uint8_t reset = ADS1220_CMD_RESET;
+    if(nrf_drv_spi_transfer(&spi, &reset, 1, NULL, 0) != NRF_SUCCESS)
+	return false;
+    nrf_delay_us(100); // 50 us + 32 clocks after a reset
+
+    uint8_t regs[ADS1220_REG_COUNT];
+    ads1220_encode_config(rate, gain, regs);
+    uint8_t wreg[1 + ADS1220_REG_COUNT] = {ADS1220_CMD_WREG | (ADS1220_REG_COUNT - 1)};
+    for(uint8_t i = 0; i < ADS1220_REG_COUNT; i++)
+	wreg[1 + i] = regs[i];
+    if(nrf_drv_spi_transfer(&spi, wreg, sizeof(wreg), NULL, 0) != NRF_SUCCESS)
+	return false;
+
+    // read back, a missing or unpowered adc reads all 0 or all 1
+    uint8_t rreg[1 + ADS1220_REG_COUNT] = {ADS1220_CMD_RREG | (ADS1220_REG_COUNT - 1)};
+    uint8_t back[1 + ADS1220_REG_COUNT];
+    if(nrf_drv_spi_transfer(&spi, rreg, sizeof(rreg), back, sizeof(back)) != NRF_SUCCESS)
+	return false;
+    for(uint8_t i = 0; i < ADS1220_REG_COUNT; i++)
+	if(back[1 + i] != regs[i])
+	    return false;
+
+    uint8_t start = ADS1220_CMD_START;
+    if(nrf_drv_spi_transfer(&spi, &start, 1, NULL, 0) != NRF_SUCCESS)
+	return false;
+    ads1220_backend.sample_rate = ads1220_sample_rate(rate);
+    ads1220_backend.gain = 1 << (regs[0] >> 1);
+    return true;
+}
+
+#else
+
+/*
+    @brief Host build, nothing to read
+*/
+static bool ads1220_is_ready(void) {
+    return false;
+}
+
+static int32_t ads1220_read_raw(void) {
+    return SG_RAW_INVALID;
+}
+
+#endif // ADS1220_HOST
@@ -0,0 +1,130 @@
+/* ****************************************************************************/
+/** ADS1220 Backend Library
+
+  @File Name
+    ads1220.h
+
+  @Summary
+    Strain gauge backend for the ti ads1220 24 bit delta sigma adc
+
+  @Description
+    Defines a StrainGaugeBackend for the ads1220 on spi, a faster alternative to the hx711:
+    20 to 1000 SPS with a pga gain of 1 to 128. The bridge is read on AIN0/AIN1 with the
+    excitation wired to REFP0/REFN0, so the readings are ratiometric and the input range is
+    +-VE/gain. The adc runs in continuous conversion mode and DRDY low means a conversion
+    is ready.
+******************************************************************************/
+
+#ifndef ADS1220_H
+#define ADS1220_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "strain_gauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADS1220_REG_COUNT 4 // configuration registers
+#define ADS1220_DATA_BYTES 3 // bytes per conversion
+
+// commands
+#define ADS1220_CMD_RESET 0x06
+#define ADS1220_CMD_START 0x08 // start / sync
+#define ADS1220_CMD_RDATA 0x10
+#define ADS1220_CMD_RREG 0x20 // | register << 2 | (count - 1)
+#define ADS1220_CMD_WREG 0x40 // | register << 2 | (count - 1)
+
+// data rates in normal mode, DR bits of register 1
+typedef enum {
+    ADS1220_RATE_20 = 0,
+    ADS1220_RATE_45,
+    ADS1220_RATE_90,
+    ADS1220_RATE_175,
+    ADS1220_RATE_330,
+    ADS1220_RATE_600,
+    ADS1220_RATE_1000,
+}ads1220_rate_t;
+
+// pga gains, GAIN bits of register 0, the gain is 1 << code
+typedef enum {
+    ADS1220_GAIN_1 = 0,
+    ADS1220_GAIN_2,
+    ADS1220_GAIN_4,
+    ADS1220_GAIN_8,
+    ADS1220_GAIN_16,
+    ADS1220_GAIN_32,
+    ADS1220_GAIN_64,
+    ADS1220_GAIN_128,
+}ads1220_gain_t;
+
+// ads1220 backend, filled in by ads1220_init(), select with strain_gauge_set_backend()
+extern StrainGaugeBackend ads1220_backend;
+
+/*
+    @brief Build the configuration registers
+
+    @note AIN0/AIN1 through the pga, continuous conversion, external reference on
+	REFP0/REFN0, no current sources. Out of range codes fall back to 20 SPS and gain 128.
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @param[in] gain ADS1220_GAIN_ value
+
+    @param[out] regs ADS1220_REG_COUNT register values, register 0 first
+*/
+void ads1220_encode_config(uint8_t rate, uint8_t gain, uint8_t * regs);
+
+/*
+    @brief Decode the bytes of one conversion
+
+    @param[in] rx ADS1220_DATA_BYTES bytes, msb first
+
+    @ret Sign extended 24 bit count
+*/
+int32_t ads1220_decode(const uint8_t * rx);
+
+/*
+    @brief Conversions per second for a data rate
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @ret Conversions per second, 20 for out of range codes
+*/
+float ads1220_sample_rate(uint8_t rate);
+
+#ifndef ADS1220_HOST // define to build without the nordic glue, e.g. to check the encoding on a host
+
+/*
+    @brief Set up the ads1220 and fill in ads1220_backend
+
+    @note Resets the adc, writes the configuration, reads it back and starts continuous
+	conversions. The spi runs in mode 1 at 4 MHz with blocking transfers.
+
+    @param[in] sck_pin Spi clock
+
+    @param[in] mosi_pin Spi MOSI, ads1220 DIN
+
+    @param[in] miso_pin Spi MISO, ads1220 DOUT
+
+    @param[in] cs_pin Chip select
+
+    @param[in] drdy_pin ads1220 DRDY
+
+    @param[in] rate ADS1220_RATE_ value
+
+    @param[in] gain ADS1220_GAIN_ value
+
+    @ret true if the adc was found and configured
+*/
+bool ads1220_init(uint32_t sck_pin, uint32_t mosi_pin, uint32_t miso_pin, uint32_t cs_pin,
+	uint32_t drdy_pin, uint8_t rate, uint8_t gain);
+
+#endif // ADS1220_HOST
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADS1220_H
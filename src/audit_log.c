@@ -0,0 +1,176 @@
+/* ****************************************************************************/
+/** Audit Log Library 
+
+  @File Name
+    audit_log.c
+
+  @Summary
+    Append-only, crc chained log of calibration and configuration changes
+
+  @Description
+    Implements the audit log on top of crc32.c.
+******************************************************************************/
+
+#include "audit_log.h"
+#include <stddef.h>
+
+// head and count are uint8_t and head wraps with a mask, count reaches AUDIT_LOG_SIZE
+_Static_assert(AUDIT_LOG_SIZE > 0 && (AUDIT_LOG_SIZE & (AUDIT_LOG_SIZE - 1)) == 0 && AUDIT_LOG_SIZE <= 128,
+	"AUDIT_LOG_SIZE has to be a power of 2 up to 128");
+
+/*
+    @brief Calculate the crc of a record
+
+    @note Field by field, little endian, the same bytes a little endian part without padding
+	has in memory, so logs written before this was explicit still verify
+
+    @param[in] prev_crc Crc of the previous record
+
+    @param[in] record Record, everything before the crc field is covered
+
+    @ret Crc for the record
+*/
+static uint32_t record_crc(uint32_t prev_crc, const AuditRecord * record) {
+    uint32_t crc = crc32_update_u32(prev_crc, record->seq, 4);
+    crc = crc32_update_u32(crc, record->cal_counter, 2);
+    crc = crc32_update_u32(crc, record->type, 1);
+    crc = crc32_update_u32(crc, record->reserved, 1);
+    crc = crc32_update_float(crc, record->value[0]);
+    return crc32_update_float(crc, record->value[1]);
+}
+
+/*
+    @brief Initialize an empty log
+
+    @param[out] log Log to initialize
+*/
+void audit_log_init(AuditLog * log) {
+    log->next_seq = 0;
+    log->base_crc = AUDIT_CRC_SEED;
+    log->overwritten = 0;
+    log->cal_counter = 0;
+    log->head = 0;
+    log->count = 0;
+}
+
+/*
+    @brief Append a record
+
+    @param[in] log Log
+
+    @param[in] type AUDIT_ record type
+
+    @param[in] value0 First value
+
+    @param[in] value1 Second value
+
+    @ret true if appended, false if the log is full
+*/
+bool audit_log_append(AuditLog * log, uint8_t type, float value0, float value1) {
+    uint8_t prev = (log->head - 1) & (AUDIT_LOG_SIZE - 1);
+    uint32_t prev_crc = log->count > 0 ? log->records[prev].crc : log->base_crc;
+    AuditRecord * record = &log->records[log->head];
+
+    if(log->count == AUDIT_LOG_SIZE) {
+#if AUDIT_LOG_OVERWRITE
+	// the oldest record is about to go, its crc becomes the start of the chain
+	log->base_crc = record->crc;
+	log->overwritten++;
+#else
+	return false;
+#endif
+    }
+    else
+	log->count++;
+
+    if(type == AUDIT_EQUATION || type == AUDIT_GRAVITY || type == AUDIT_SCALE)
+	log->cal_counter++;
+    record->seq = log->next_seq++;
+    record->cal_counter = log->cal_counter;
+    record->type = type;
+    record->reserved = 0;
+    record->value[0] = value0;
+    record->value[1] = value1;
+    record->crc = record_crc(prev_crc, record);
+    log->head = (log->head + 1) & (AUDIT_LOG_SIZE - 1);
+    return true;
+}
+
+/*
+    @brief Check how many records can be appended
+
+    @param[in] log Log
+
+    @ret Free records
+*/
+uint16_t audit_log_room(const AuditLog * log) {
+#if AUDIT_LOG_OVERWRITE
+    (void)log;
+    return AUDIT_LOG_SIZE;
+#else
+    return AUDIT_LOG_SIZE - log->count;
+#endif
+}
+
+/*
+    @brief Drop the oldest records once they've been exported and stored
+
+    @param[in] log Log
+
+    @param[in] n Number of records to drop
+*/
+void audit_log_release(AuditLog * log, uint8_t n) {
+    if(n > log->count)
+	n = log->count;
+    if(n == 0)
+	return;
+    uint8_t oldest = (log->head - log->count) & (AUDIT_LOG_SIZE - 1);
+    log->base_crc = log->records[(oldest + n - 1) & (AUDIT_LOG_SIZE - 1)].crc;
+    log->count -= n;
+}
+
+/*
+    @brief Copy the records out oldest first
+
+    @param[in] log Log
+
+    @param[out] out Buffer for the records
+
+    @param[in] max Size of out
+
+    @param[out] base_crc Chain value before the first record copied
+
+    @ret Number of records copied
+*/
+uint8_t audit_log_export(const AuditLog * log, AuditRecord * out, uint8_t max, uint32_t * base_crc) {
+    uint8_t n = log->count < max ? log->count : max;
+    uint8_t skip = log->count - n; // copy the newest n
+    uint8_t oldest = (log->head - log->count) & (AUDIT_LOG_SIZE - 1);
+    *base_crc = skip > 0 ? log->records[(oldest + skip - 1) & (AUDIT_LOG_SIZE - 1)].crc : log->base_crc;
+    for(uint8_t i = 0; i < n; i++)
+	out[i] = log->records[(oldest + skip + i) & (AUDIT_LOG_SIZE - 1)];
+    return n;
+}
+
+/*
+    @brief Verify a chain of records
+
+    @param[in] records Records oldest first, as exported
+
+    @param[in] n Number of records
+
+    @param[in] base_crc Chain value before the first record
+
+    @ret Index of the first bad record, n if the chain is intact
+*/
+uint16_t audit_log_verify(const AuditRecord * records, uint16_t n, uint32_t base_crc) {
+    uint32_t crc = base_crc;
+    for(uint16_t i = 0; i < n; i++) {
+	if(record_crc(crc, &records[i]) != records[i].crc)
+	    return i;
+	if(i > 0 && records[i].seq != records[i-1].seq + 1)
+	    return i;
+	crc = records[i].crc;
+    }
+    return n;
+}
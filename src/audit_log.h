@@ -0,0 +1,153 @@
+/* ****************************************************************************/
+/** Audit Log Library 
+
+  @File Name
+    audit_log.h
+
+  @Summary
+    Append-only, crc chained log of calibration and configuration changes
+
+  @Description
+    Defines a fixed size log in the style of a legal-for-trade audit trail. Every record
+    carries a sequence number, the calibration event counter and a crc32 over the previous
+    record's crc and its own contents, so a record can't be changed, removed or reordered
+    without breaking the chain. The crcs are computed over the fields little endian, so a
+    log saved to flash as is can be checked on a host with audit_log_verify().
+******************************************************************************/
+
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "crc32.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef AUDIT_LOG_SIZE
+#define AUDIT_LOG_SIZE 32 // records kept, power of 2
+#endif
+#ifndef AUDIT_LOG_OVERWRITE
+#define AUDIT_LOG_OVERWRITE 0 // 1 to overwrite the oldest record when full, 0 to refuse the append
+#endif
+#define AUDIT_CRC_SEED CRC32_SEED // chain value before the first record
+
+// record types
+#define AUDIT_EQUATION 1 // calibration equation set, values are slope and intercept
+#define AUDIT_TARE 2 // tare, value[0] is the new offset
+#define AUDIT_GRAVITY 3 // gravity correction, value[0] is the correction factor
+#define AUDIT_CONFIG 4 // other configuration change, values depend on the application
+#define AUDIT_SCALE 5 // load cell scale restored, value[0] is kg per mV with the gravity correction
+
+// one log record, 20 bytes
+typedef struct {
+    uint32_t seq; // record number, never resets
+    uint16_t cal_counter; // calibration event counter after this record
+    uint8_t type; // AUDIT_ record type
+    uint8_t reserved; // keeps the record 4 byte aligned, always 0
+    float value[2]; // what changed, see the record types
+    uint32_t crc; // crc32 of the previous record's crc and this record up to here
+}AuditRecord;
+
+// log state, save the whole struct to keep the log across resets
+typedef struct {
+    AuditRecord records[AUDIT_LOG_SIZE];
+    uint32_t next_seq; // seq of the next record
+    uint32_t base_crc; // crc before the oldest kept record, so the chain can be checked after wrapping
+    uint32_t overwritten; // records overwritten before they were released, AUDIT_LOG_OVERWRITE only
+    uint16_t cal_counter; // calibration event counter
+    uint8_t head; // next slot to write
+    uint8_t count; // records in the log
+}AuditLog;
+
+/*
+    @brief Initialize an empty log
+
+    @param[out] log Log to initialize
+*/
+void audit_log_init(AuditLog * log);
+
+/*
+    @brief Append a record
+
+    @note O(1), a crc over one 16 byte record. Calibration changes (AUDIT_EQUATION,
+	AUDIT_GRAVITY and AUDIT_SCALE) count as calibration events, tares and config changes
+	don't.
+
+    @note When the log is full the append is refused, so nothing is lost without a trace.
+	Export the records and audit_log_release() them to make room. With
+	AUDIT_LOG_OVERWRITE the oldest record is overwritten instead and counted in
+	overwritten, and the gap shows in the sequence numbers.
+
+    @param[in] log Log
+
+    @param[in] type AUDIT_ record type
+
+    @param[in] value0 First value
+
+    @param[in] value1 Second value
+
+    @ret true if appended, false if the log is full
+*/
+bool audit_log_append(AuditLog * log, uint8_t type, float value0, float value1);
+
+/*
+    @brief Check how many records can be appended
+
+    @param[in] log Log
+
+    @ret Free records, AUDIT_LOG_SIZE with AUDIT_LOG_OVERWRITE since nothing is refused
+*/
+uint16_t audit_log_room(const AuditLog * log);
+
+/*
+    @brief Drop the oldest records once they've been exported and stored
+
+    @note The chain carries on from the last record dropped, so a log exported in parts
+	verifies as one
+
+    @param[in] log Log
+
+    @param[in] n Number of records to drop, at most the records in the log
+*/
+void audit_log_release(AuditLog * log, uint8_t n);
+
+/*
+    @brief Copy the records out oldest first
+
+    @param[in] log Log
+
+    @param[out] out Buffer for the records
+
+    @param[in] max Size of out
+
+    @param[out] base_crc Chain value before the first record copied, for audit_log_verify()
+
+    @ret Number of records copied
+*/
+uint8_t audit_log_export(const AuditLog * log, AuditRecord * out, uint8_t max, uint32_t * base_crc);
+
+/*
+    @brief Verify a chain of records
+
+    @note Checks every crc and that the sequence numbers have no gaps. Only needs this file and
+	crc32.c, so it can be compiled on a host to check logs read back from the field.
+
+    @param[in] records Records oldest first, as exported
+
+    @param[in] n Number of records
+
+    @param[in] base_crc Chain value before the first record
+
+    @ret Index of the first bad record, n if the chain is intact
+*/
+uint16_t audit_log_verify(const AuditRecord * records, uint16_t n, uint32_t base_crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIT_LOG_H
@@ -0,0 +1,570 @@
+/* ****************************************************************************/
+/** Remote Command Library
+
+  @File Name
+    command.c
+
+  @Summary
+    Request/response commands over a byte stream for remote taring, zeroing and calibration
+
+  @Description
+    Implements the request parser, the command handlers and a loopback transport. Requests
+    are collected in a buffer so a frame can arrive over any number of calls. A frame with a
+    bad length or crc is dropped from its sync byte only and the parser resyncs on the next
+    sync byte after it, which may be inside the dropped frame. Build with COMMAND_HOST for
+    the host side only, the encoding helpers and the loopback, without the driver.
+******************************************************************************/
+
+#include "command.h"
+#include "crc32.h"
+#include <string.h>
+
+// head and tail are uint16_t and wrap with a modulo
+_Static_assert(COMMAND_LOOPBACK_SIZE > 1 && COMMAND_LOOPBACK_SIZE <= UINT16_MAX,
+	"COMMAND_LOOPBACK_SIZE has to be 2 to 65535");
+
+//#define DEBUG_OUTPUT
+
+#ifdef DEBUG_OUTPUT
+#include <stdio.h>
+#endif
+
+#define FRAME_HEADER 4 // sync, cmd, seq, len
+#define CRC_SIZE 4
+
+/*
+    @brief Store a little endian u32
+
+    @param[out] buf 4 bytes
+
+    @param[in] v Value
+*/
+void command_put_u32(uint8_t * buf, uint32_t v) {
+    buf[0] = v & 0xFF;
+    buf[1] = (v >> 8) & 0xFF;
+    buf[2] = (v >> 16) & 0xFF;
+    buf[3] = v >> 24;
+}
+
+/*
+    @brief Load a little endian u32
+
+    @param[in] buf 4 bytes
+
+    @ret Value
+*/
+uint32_t command_get_u32(const uint8_t * buf) {
+    return buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+/*
+    @brief Store a float as its little endian IEEE-754 bits
+
+    @param[out] buf 4 bytes
+
+    @param[in] v Value
+*/
+void command_put_f32(uint8_t * buf, float v) {
+    sg_param_value_t bits;
+    bits.f = v;
+    command_put_u32(buf, bits.u32);
+}
+
+/*
+    @brief Load a float stored by command_put_f32()
+
+    @param[in] buf 4 bytes
+
+    @ret Value
+*/
+float command_get_f32(const uint8_t * buf) {
+    sg_param_value_t bits;
+    bits.u32 = command_get_u32(buf);
+    return bits.f;
+}
+
+#ifndef COMMAND_HOST
+
+/*
+    @brief Initialize a command processor
+
+    @param[out] cmd Processor to initialize
+
+    @param[in] transport Transport it reads requests from and writes responses to
+*/
+void command_init(Command * cmd, const CommandTransport * transport) {
+    cmd->transport = *transport;
+#if SG_USE_STATS
+    cmd->stats = NULL;
+#endif
+    cmd->frame_len = 0;
+    cmd->bad_frames = 0;
+    cmd->tx_len = 0;
+    cmd->tx_sent = 0;
+    cmd->pending_cmd = 0;
+}
+
+#if SG_USE_STATS
+/*
+    @brief Answer COMMAND_STATS from an accumulator
+
+    @param[in] cmd Processor
+
+    @param[in] st Accumulator, NULL to answer SG_ERR_INVALID
+*/
+void command_attach_stats(Command * cmd, Stats * st) {
+    cmd->stats = st;
+}
+#endif
+
+/*
+    @brief Write as much of the queued response as the transport takes
+
+    @param[in] cmd Processor
+
+    @ret true once the whole response is written
+*/
+static bool flush(Command * cmd) {
+    if(cmd->tx_sent < cmd->tx_len)
+	cmd->tx_sent += cmd->transport.write(cmd->transport.context, &cmd->tx[cmd->tx_sent], cmd->tx_len - cmd->tx_sent);
+    if(cmd->tx_sent < cmd->tx_len)
+	return false;
+    cmd->tx_len = cmd->tx_sent = 0;
+    return true;
+}
+
+/*
+    @brief Write a response
+
+    @note What the transport doesn't take is written by the following command_process()
+	calls, which handle nothing else until it's out
+
+    @param[in] cmd Processor, with no response queued
+
+    @param[in] id Command answered
+
+    @param[in] seq Sequence number of the request
+
+    @param[in] status Result
+
+    @param[in] payload Response payload, NULL if len is 0
+
+    @param[in] len Payload length
+*/
+static void respond(Command * cmd, uint8_t id, uint8_t seq, sg_status_t status, const uint8_t * payload, uint8_t len) {
+    uint8_t * frame = cmd->tx;
+    frame[0] = COMMAND_SYNC_RESPONSE;
+    frame[1] = id;
+    frame[2] = seq;
+    frame[3] = status;
+    frame[4] = len;
+    if(len > 0)
+	memcpy(&frame[5], payload, len);
+    uint32_t crc = crc32_update(CRC32_SEED, &frame[1], len + 4);
+    command_put_u32(&frame[5 + len], crc);
+    cmd->tx_len = len + COMMAND_RESPONSE_OVERHEAD;
+    cmd->tx_sent = 0;
+    flush(cmd);
+}
+
+/*
+    @brief Start a command that waits for samples
+
+    @param[in] cmd Processor
+
+    @param[in] id Command
+
+    @param[in] seq Sequence number of the request
+
+    @param[in] samples Samples it needs, for the timeout
+
+    @param[in] now_ms Millisecond tick
+*/
+static void pend(Command * cmd, uint8_t id, uint8_t seq, uint32_t samples, uint32_t now_ms) {
+    sg_param_value_t timeout;
+    strain_gauge_param_get(SG_PARAM_SAMPLE_TIMEOUT_MS, &timeout);
+    cmd->pending_cmd = id;
+    cmd->pending_seq = seq;
+    cmd->deadline_ms = now_ms + samples * timeout.u32;
+}
+
+/*
+    @brief Handle a request with a good crc
+
+    @param[in] cmd Processor
+
+    @param[in] now_ms Millisecond tick
+*/
+static void dispatch(Command * cmd, uint32_t now_ms) {
+    uint8_t id = cmd->frame[1];
+    uint8_t seq = cmd->frame[2];
+    uint8_t len = cmd->frame[3];
+    const uint8_t * req = &cmd->frame[FRAME_HEADER];
+    uint8_t out[COMMAND_MAX_PAYLOAD];
+    sg_param_value_t value;
+    sg_status_t status;
+
+#ifdef DEBUG_OUTPUT
+    printf("command 0x%02X seq %u len %u\n", id, seq, len);
+#endif
+
+    switch(id) {
+	case COMMAND_READ:
+	case COMMAND_TARE:
+	case COMMAND_ZERO:
+	case COMMAND_CAL_POINT:
+	case COMMAND_CAL_COMMIT:
+	case COMMAND_CAL_ABORT:
+	    if(cmd->pending_cmd != 0) {
+		respond(cmd, id, seq, SG_ERR_BUSY, NULL, 0);
+		return;
+	    }
+	    break;
+    }
+
+    switch(id) {
+	case COMMAND_READ:
+	    if(len != 0)
+		break;
+	    pend(cmd, id, seq, 1, now_ms);
+	    return;
+	case COMMAND_STATUS: {
+	    if(len != 0)
+		break;
+	    CalibrationSet cal;
+	    strain_gauge_get_calibration(&cal);
+	    out[0] = strain_gauge_get_mode();
+	    out[1] = strain_gauge_get_faults();
+	    out[2] = strain_gauge_is_valid();
+	    command_put_u32(&out[3], cal.version);
+	    respond(cmd, id, seq, SG_OK, out, 7);
+	    return;
+	}
+	case COMMAND_TARE:
+	case COMMAND_ZERO:
+	    if(len != 0)
+		break;
+	    if(id == COMMAND_TARE)
+		strain_gauge_tare_start(&cmd->job);
+	    else
+		strain_gauge_zero_start(&cmd->job);
+	    if(cmd->job.status != SG_BUSY) {
+		respond(cmd, id, seq, cmd->job.status, NULL, 0);
+		return;
+	    }
+	    pend(cmd, id, seq, cmd->job.times, now_ms);
+	    return;
+	case COMMAND_CAL_BEGIN:
+	    if(len != 0)
+		break;
+	    respond(cmd, id, seq, strain_gauge_cal_begin(), NULL, 0);
+	    return;
+	case COMMAND_CAL_POINT:
+	    if(len != 4)
+		break;
+	    strain_gauge_cal_point_start(&cmd->job, command_get_f32(req));
+	    if(cmd->job.status != SG_BUSY) {
+		respond(cmd, id, seq, cmd->job.status, NULL, 0);
+		return;
+	    }
+	    pend(cmd, id, seq, cmd->job.times, now_ms);
+	    return;
+	case COMMAND_CAL_COMMIT: {
+	    if(len != 0)
+		break;
+	    float equation[2];
+	    status = strain_gauge_cal_commit(equation);
+	    if(status != SG_OK) {
+		respond(cmd, id, seq, status, NULL, 0);
+		return;
+	    }
+	    command_put_f32(&out[0], equation[0]);
+	    command_put_f32(&out[4], equation[1]);
+	    respond(cmd, id, seq, SG_OK, out, 8);
+	    return;
+	}
+	case COMMAND_CAL_ABORT:
+	    if(len != 0)
+		break;
+	    strain_gauge_cal_abort();
+	    respond(cmd, id, seq, SG_OK, NULL, 0);
+	    return;
+#if SG_USE_STATS
+	case COMMAND_STATS:
+	    if(len != 1 || cmd->stats == NULL)
+		break;
+	    command_put_u32(&out[0], cmd->stats->count);
+	    command_put_f32(&out[4], (float)cmd->stats->mean);
+	    command_put_f32(&out[8], stats_stddev(cmd->stats));
+	    command_put_f32(&out[12], cmd->stats->min);
+	    command_put_f32(&out[16], cmd->stats->max);
+	    if(req[0])
+		stats_reset(cmd->stats);
+	    respond(cmd, id, seq, SG_OK, out, 20);
+	    return;
+#endif
+	case COMMAND_PARAM_GET:
+	case COMMAND_PARAM_SET: {
+	    if(len != (id == COMMAND_PARAM_GET ? 2 : 6))
+		break;
+	    uint16_t param = req[0] | req[1] << 8;
+	    if(id == COMMAND_PARAM_SET) {
+		value.u32 = command_get_u32(&req[2]);
+		status = strain_gauge_param_set(param, value);
+	    }
+	    else
+		status = strain_gauge_param_get(param, &value);
+	    if(status != SG_OK) {
+		respond(cmd, id, seq, status, NULL, 0);
+		return;
+	    }
+	    out[0] = req[0];
+	    out[1] = req[1];
+	    command_put_u32(&out[2], value.u32);
+	    respond(cmd, id, seq, SG_OK, out, 6);
+	    return;
+	}
+    }
+    // unknown command or wrong payload length
+    respond(cmd, id, seq, SG_ERR_INVALID, NULL, 0);
+}
+
+/*
+    @brief Advance the pending command
+
+    @param[in] cmd Processor
+
+    @param[in] now_ms Millisecond tick
+*/
+static void poll_pending(Command * cmd, uint32_t now_ms) {
+    uint8_t out[4];
+    float kgs;
+    sg_status_t status;
+    uint8_t id = cmd->pending_cmd;
+
+    if(id == COMMAND_READ)
+	status = strain_gauge_poll(&kgs);
+    else {
+	status = strain_gauge_job_poll(&cmd->job);
+	kgs = cmd->job.result;
+    }
+    if(status == SG_BUSY) {
+	if((int32_t)(now_ms - cmd->deadline_ms) < 0)
+	    return;
+	if(id != COMMAND_READ)
+	    strain_gauge_job_cancel(&cmd->job); // leaves taring mode
+	status = SG_ERR_TIMEOUT;
+    }
+    cmd->pending_cmd = 0;
+    if(status != SG_OK) {
+	respond(cmd, id, cmd->pending_seq, status, NULL, 0);
+	return;
+    }
+    command_put_f32(out, kgs);
+    respond(cmd, id, cmd->pending_seq, SG_OK, out, 4);
+}
+
+/*
+    @brief Drop bytes from the front of the receive buffer, up to the next sync byte
+
+    @param[in] cmd Processor
+
+    @param[in] n Bytes to drop at least
+*/
+static void skip(Command * cmd, uint8_t n) {
+    while(n < cmd->frame_len && cmd->frame[n] != COMMAND_SYNC_REQUEST)
+	n++;
+    if(n == 0)
+	return;
+    cmd->frame_len -= n;
+    memmove(cmd->frame, &cmd->frame[n], cmd->frame_len);
+}
+
+/*
+    @brief Handle the complete requests in the receive buffer
+
+    @note A frame with a bad length or crc is dropped from its sync byte only and the rest is
+	scanned again, so a request that starts inside a corrupted one isn't lost. Stops
+	while a response is still being written.
+
+    @param[in] cmd Processor
+
+    @param[in] now_ms Millisecond tick
+*/
+static void parse(Command * cmd, uint32_t now_ms) {
+    skip(cmd, 0); // resyncing
+    while(cmd->tx_len == 0 && cmd->frame_len >= FRAME_HEADER) {
+	uint8_t len = cmd->frame[3];
+	uint8_t size = len + FRAME_HEADER + CRC_SIZE;
+	if(len > COMMAND_MAX_PAYLOAD ||
+		(cmd->frame_len >= size &&
+		crc32_update(CRC32_SEED, &cmd->frame[1], len + FRAME_HEADER - 1) != command_get_u32(&cmd->frame[FRAME_HEADER + len]))) {
+	    cmd->bad_frames++;
+#ifdef DEBUG_OUTPUT
+	    printf("command bad length or crc\n");
+#endif
+	    skip(cmd, 1);
+	    continue;
+	}
+	if(cmd->frame_len < size)
+	    return; // rest still to come
+	dispatch(cmd, now_ms);
+	skip(cmd, size);
+    }
+}
+
+/*
+    @brief Handle received requests and advance the pending command
+
+    @param[in] cmd Processor
+
+    @param[in] now_ms Millisecond tick
+*/
+void command_process(Command * cmd, uint32_t now_ms) {
+    if(!flush(cmd))
+	return; // the host isn't reading, leave the requests in the transport
+    parse(cmd, now_ms);
+    size_t n;
+    while(cmd->tx_len == 0 && (n = cmd->transport.read(cmd->transport.context, &cmd->frame[cmd->frame_len],
+	    sizeof(cmd->frame) - cmd->frame_len)) > 0) {
+	cmd->frame_len += n;
+	parse(cmd, now_ms);
+    }
+    if(cmd->pending_cmd != 0 && cmd->tx_len == 0)
+	poll_pending(cmd, now_ms);
+}
+
+#endif // COMMAND_HOST
+
+/*
+    @brief Encode a request
+
+    @param[in] id Command
+
+    @param[in] seq Sequence number echoed in the response
+
+    @param[in] payload Request payload, NULL if len is 0
+
+    @param[in] len Payload length
+
+    @param[out] frame At least len + COMMAND_REQUEST_OVERHEAD bytes
+
+    @ret Frame length, 0 if len is too big
+*/
+size_t command_encode_request(uint8_t id, uint8_t seq, const uint8_t * payload, uint8_t len, uint8_t * frame) {
+    if(len > COMMAND_MAX_PAYLOAD)
+	return 0;
+    frame[0] = COMMAND_SYNC_REQUEST;
+    frame[1] = id;
+    frame[2] = seq;
+    frame[3] = len;
+    if(len > 0)
+	memcpy(&frame[FRAME_HEADER], payload, len);
+    command_put_u32(&frame[FRAME_HEADER + len], crc32_update(CRC32_SEED, &frame[1], len + 3));
+    return len + COMMAND_REQUEST_OVERHEAD;
+}
+
+/*
+    @brief Decode a response
+
+    @param[in] frame Bytes received, starting at the sync byte
+
+    @param[in] len Bytes available
+
+    @param[out] resp Decoded response
+
+    @ret Length of the response frame, or 0 if it's incomplete or corrupted
+*/
+size_t command_decode_response(const uint8_t * frame, size_t len, CommandResponse * resp) {
+    if(len < COMMAND_RESPONSE_OVERHEAD || frame[0] != COMMAND_SYNC_RESPONSE || frame[4] > COMMAND_MAX_PAYLOAD)
+	return 0;
+    uint8_t payload_len = frame[4];
+    if(len < (size_t)payload_len + COMMAND_RESPONSE_OVERHEAD)
+	return 0;
+    if(crc32_update(CRC32_SEED, &frame[1], payload_len + 4) != command_get_u32(&frame[5 + payload_len]))
+	return 0;
+    resp->cmd = frame[1];
+    resp->seq = frame[2];
+    resp->status = (sg_status_t)frame[3];
+    resp->len = payload_len;
+    memcpy(resp->payload, &frame[5], payload_len);
+    return payload_len + COMMAND_RESPONSE_OVERHEAD;
+}
+
+/*
+    @brief Queue bytes in a ring
+
+    @ret Bytes queued
+*/
+static size_t ring_write(CommandRing * ring, const uint8_t * buf, size_t len) {
+    size_t n = 0;
+    while(n < len) {
+	uint16_t next = (ring->head + 1) % COMMAND_LOOPBACK_SIZE;
+	if(next == ring->tail)
+	    break; // full
+	ring->buf[ring->head] = buf[n++];
+	ring->head = next;
+    }
+    return n;
+}
+
+/*
+    @brief Take bytes from a ring
+
+    @ret Bytes read
+*/
+static size_t ring_read(CommandRing * ring, uint8_t * buf, size_t len) {
+    size_t n = 0;
+    while(n < len && ring->tail != ring->head) {
+	buf[n++] = ring->buf[ring->tail];
+	ring->tail = (ring->tail + 1) % COMMAND_LOOPBACK_SIZE;
+    }
+    return n;
+}
+
+/*
+    @brief Device side read of the loopback
+*/
+static size_t loopback_read(void * context, uint8_t * buf, size_t len) {
+    return ring_read(&((CommandLoopback *)context)->to_device, buf, len);
+}
+
+/*
+    @brief Device side write of the loopback
+*/
+static size_t loopback_write(void * context, const uint8_t * buf, size_t len) {
+    return ring_write(&((CommandLoopback *)context)->to_host, buf, len);
+}
+
+/*
+    @brief Initialize an empty loopback
+
+    @param[out] lb Loopback to initialize
+
+    @param[out] device Transport to give command_init()
+*/
+void command_loopback_init(CommandLoopback * lb, CommandTransport * device) {
+    lb->to_device.head = lb->to_device.tail = 0;
+    lb->to_host.head = lb->to_host.tail = 0;
+    device->read = loopback_read;
+    device->write = loopback_write;
+    device->context = lb;
+}
+
+/*
+    @brief Send bytes to the command processor
+
+    @ret Bytes queued
+*/
+size_t command_loopback_send(CommandLoopback * lb, const uint8_t * buf, size_t len) {
+    return ring_write(&lb->to_device, buf, len);
+}
+
+/*
+    @brief Take the bytes the command processor wrote
+
+    @ret Bytes read
+*/
+size_t command_loopback_receive(CommandLoopback * lb, uint8_t * buf, size_t len) {
+    return ring_read(&lb->to_host, buf, len);
+}
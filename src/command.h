@@ -0,0 +1,229 @@
+/* ****************************************************************************/
+/** Remote Command Library
+
+  @File Name
+    command.h
+
+  @Summary
+    Request/response commands over a byte stream for remote taring, zeroing and calibration
+
+  @Description
+    Defines a small binary protocol for a host to drive the strain gauge over a uart, usb
+    or socket. Commands that need samples (reads, tares, zeros, calibration points) are
+    started and then advanced by command_process() from the main loop, so a command never
+    blocks acquisition. One such command runs at a time, others get SG_ERR_BUSY.
+
+    Request:  0xA5, cmd, seq, len, payload[len], crc32
+    Response: 0x5A, cmd, seq, status, len, payload[len], crc32
+
+    The crc32 is crc32_update() from CRC32_SEED over everything between the sync byte
+    and the crc. Multi-byte values are little endian, floats are sent as their IEEE-754 bits.
+    The seq byte is chosen by the host and echoed back so it can match responses to requests.
+    The status byte is an sg_status_t: SG_ERR_BUSY while another command is pending,
+    SG_ERR_INVALID for an unknown command or a bad payload, and SG_ERR_FULL when the
+    attached audit log has no room for a tare, zero, calibration or parameter change.
+******************************************************************************/
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "strain_gauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMMAND_SYNC_REQUEST 0xA5
+#define COMMAND_SYNC_RESPONSE 0x5A
+#ifndef COMMAND_MAX_PAYLOAD
+#define COMMAND_MAX_PAYLOAD 24 // largest payload, the stats response is 20
+#endif
+#define COMMAND_REQUEST_OVERHEAD 8 // sync, cmd, seq, len and crc
+#define COMMAND_RESPONSE_OVERHEAD 9 // sync, cmd, seq, status, len and crc
+#ifndef COMMAND_LOOPBACK_SIZE
+#define COMMAND_LOOPBACK_SIZE 128 // bytes buffered each way by the loopback transport
+#endif
+
+// commands, request payload -> response payload
+typedef enum {
+    COMMAND_READ = 0x01, // none -> f32 kg, waits for the next sample
+    COMMAND_STATUS = 0x02, // none -> u8 mode, u8 faults, u8 valid, u32 calibration version
+    COMMAND_TARE = 0x10, // none -> f32 offset
+    COMMAND_ZERO = 0x11, // none -> f32 offset, SG_ERR_INVALID if out of SG_ZERO_RANGE
+    COMMAND_CAL_BEGIN = 0x20, // none -> none
+    COMMAND_CAL_POINT = 0x21, // f32 known kg -> f32 measured kg from the load cell rating, before the fit
+    COMMAND_CAL_COMMIT = 0x22, // none -> f32 slope, f32 intercept
+    COMMAND_CAL_ABORT = 0x23, // none -> none
+    COMMAND_STATS = 0x30, // u8 reset -> u32 count, f32 mean, stddev, min, max
+    COMMAND_PARAM_GET = 0x40, // u16 id -> u16 id, u32 value
+    COMMAND_PARAM_SET = 0x41, // u16 id, u32 value -> u16 id, u32 value
+}command_id_t;
+
+// byte stream the commands travel over
+typedef struct {
+    size_t (*read)(void * context, uint8_t * buf, size_t len); // non-blocking, returns bytes read
+    size_t (*write)(void * context, const uint8_t * buf, size_t len); // returns bytes written
+    void * context;
+}CommandTransport;
+
+// a decoded response, for the host side
+typedef struct {
+    uint8_t cmd;
+    uint8_t seq;
+    sg_status_t status;
+    uint8_t len;
+    uint8_t payload[COMMAND_MAX_PAYLOAD];
+}CommandResponse;
+
+// command processor state
+typedef struct {
+    CommandTransport transport;
+#if SG_USE_STATS
+    Stats * stats; // answers COMMAND_STATS, NULL if none
+#endif
+    uint8_t frame[COMMAND_MAX_PAYLOAD + COMMAND_REQUEST_OVERHEAD]; // bytes received, from a sync byte
+    uint8_t frame_len; // bytes in frame
+    uint32_t bad_frames; // requests dropped for a bad length or crc
+    uint8_t tx[COMMAND_MAX_PAYLOAD + COMMAND_RESPONSE_OVERHEAD]; // response being written
+    uint8_t tx_len; // its length, 0 if none
+    uint8_t tx_sent; // bytes of it the transport took
+    uint8_t pending_cmd; // command waiting for samples, 0 if none
+    uint8_t pending_seq;
+    uint32_t deadline_ms; // when the pending command times out
+    SgAverageJob job; // job of the pending command
+}Command;
+
+// byte queue, one direction of the loopback
+typedef struct {
+    uint8_t buf[COMMAND_LOOPBACK_SIZE];
+    uint16_t head; // next byte to write
+    uint16_t tail; // next byte to read
+}CommandRing;
+
+// in-memory transport, a host and the command processor in the same program
+typedef struct {
+    CommandRing to_device; // requests
+    CommandRing to_host; // responses
+}CommandLoopback;
+
+#ifndef COMMAND_HOST // define to build only the host side, e.g. for a host tool without the driver
+
+/*
+    @brief Initialize a command processor
+
+    @param[out] cmd Processor to initialize
+
+    @param[in] transport Transport it reads requests from and writes responses to, copied
+*/
+void command_init(Command * cmd, const CommandTransport * transport);
+
+#if SG_USE_STATS
+/*
+    @brief Answer COMMAND_STATS from an accumulator
+
+    @note Usually the one passed to strain_gauge_attach_stats()
+
+    @param[in] cmd Processor
+
+    @param[in] st Accumulator, NULL to answer SG_ERR_INVALID
+*/
+void command_attach_stats(Command * cmd, Stats * st);
+#endif
+
+/*
+    @brief Handle received requests and advance the pending command
+
+    @note Call from the main loop. Never waits: reads the bytes the transport has, answers
+	requests that don't need samples straight away and polls the pending one once. A
+	response the transport only partly takes is finished by the next calls before any
+	more requests are read.
+
+    @param[in] cmd Processor
+
+    @param[in] now_ms Millisecond tick, used for the pending command timeout
+*/
+void command_process(Command * cmd, uint32_t now_ms);
+
+#endif // COMMAND_HOST
+
+/*
+    @brief Encode a request, for the host side
+
+    @param[in] id Command
+
+    @param[in] seq Sequence number echoed in the response
+
+    @param[in] payload Request payload, NULL if len is 0
+
+    @param[in] len Payload length, at most COMMAND_MAX_PAYLOAD
+
+    @param[out] frame At least len + COMMAND_REQUEST_OVERHEAD bytes
+
+    @ret Frame length, 0 if len is too big
+*/
+size_t command_encode_request(uint8_t id, uint8_t seq, const uint8_t * payload, uint8_t len, uint8_t * frame);
+
+/*
+    @brief Decode a response, for the host side
+
+    @param[in] frame Bytes received, starting at the sync byte
+
+    @param[in] len Bytes available
+
+    @param[out] resp Decoded response, only written when a frame is returned
+
+    @ret Length of the response frame, or 0 if it's incomplete or corrupted
+*/
+size_t command_decode_response(const uint8_t * frame, size_t len, CommandResponse * resp);
+
+/*
+    @brief Store a little endian u32
+*/
+void command_put_u32(uint8_t * buf, uint32_t v);
+
+/*
+    @brief Load a little endian u32
+*/
+uint32_t command_get_u32(const uint8_t * buf);
+
+/*
+    @brief Store a float as its little endian IEEE-754 bits
+*/
+void command_put_f32(uint8_t * buf, float v);
+
+/*
+    @brief Load a float stored by command_put_f32()
+*/
+float command_get_f32(const uint8_t * buf);
+
+/*
+    @brief Initialize an empty loopback
+
+    @param[out] lb Loopback to initialize
+
+    @param[out] device Transport to give command_init()
+*/
+void command_loopback_init(CommandLoopback * lb, CommandTransport * device);
+
+/*
+    @brief Send bytes to the command processor, the host side write
+
+    @ret Bytes queued, less than len if the ring is full
+*/
+size_t command_loopback_send(CommandLoopback * lb, const uint8_t * buf, size_t len);
+
+/*
+    @brief Take the bytes the command processor wrote, the host side read
+
+    @ret Bytes read
+*/
+size_t command_loopback_receive(CommandLoopback * lb, uint8_t * buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_H
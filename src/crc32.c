@@ -0,0 +1,86 @@
+/* ****************************************************************************/
+/** CRC32 Library 
+
+  @File Name
+    crc32.c
+
+  @Summary
+    Standard crc32 shared by the audit log, the calibration set and the command framing
+
+  @Description
+    Implements the crc with a 16 entry table, small enough for flash constrained parts.
+    Has no other dependencies, so it also builds on a host.
+******************************************************************************/
+
+#include "crc32.h"
+#include <string.h>
+
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+/*
+    @brief Add one byte
+
+    @param[in] crc Value so far
+
+    @param[in] byte Byte to add
+
+    @ret New value
+*/
+static uint32_t crc32_byte(uint32_t crc, uint8_t byte) {
+    crc ^= byte;
+    crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+    return (crc >> 4) ^ crc_table[crc & 0x0F];
+}
+
+/*
+    @brief Continue a crc32 over a buffer
+
+    @param[in] crc Value so far
+
+    @param[in] data Bytes to add
+
+    @param[in] len Number of bytes
+
+    @ret New value
+*/
+uint32_t crc32_update(uint32_t crc, const void * data, size_t len) {
+    const uint8_t * bytes = data;
+    for(size_t i = 0; i < len; i++)
+	crc = crc32_byte(crc, bytes[i]);
+    return crc;
+}
+
+/*
+    @brief Continue a crc32 over a value, little endian
+
+    @param[in] crc Value so far
+
+    @param[in] value Value to add
+
+    @param[in] size Bytes of value to add
+
+    @ret New value
+*/
+uint32_t crc32_update_u32(uint32_t crc, uint32_t value, uint8_t size) {
+    for(uint8_t i = 0; i < size; i++)
+	crc = crc32_byte(crc, (uint8_t)(value >> (8 * i)));
+    return crc;
+}
+
+/*
+    @brief Continue a crc32 over the bits of a float, little endian
+
+    @param[in] crc Value so far
+
+    @param[in] value Value to add
+
+    @ret New value
+*/
+uint32_t crc32_update_float(uint32_t crc, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return crc32_update_u32(crc, bits, 4);
+}
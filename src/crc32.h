@@ -0,0 +1,70 @@
+/* ****************************************************************************/
+/** CRC32 Library 
+
+  @File Name
+    crc32.h
+
+  @Summary
+    Standard crc32 shared by the audit log, the calibration set and the command framing
+
+  @Description
+    The reflected 0xEDB88320 crc32 without the final xor, so a crc can be continued across
+    calls and used as a chain value. The value helpers feed fields little endian one at a
+    time, so a crc over a struct doesn't depend on the compiler's padding or the byte order
+    of the part it was computed on.
+******************************************************************************/
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRC32_SEED 0xFFFFFFFFu // value before the first byte
+
+/*
+    @brief Continue a crc32 over a buffer
+
+    @param[in] crc Value so far, CRC32_SEED to start
+
+    @param[in] data Bytes to add
+
+    @param[in] len Number of bytes
+
+    @ret New value
+*/
+uint32_t crc32_update(uint32_t crc, const void * data, size_t len);
+
+/*
+    @brief Continue a crc32 over a value, little endian
+
+    @param[in] crc Value so far
+
+    @param[in] value Value to add
+
+    @param[in] size Bytes of value to add, 1 to 4
+
+    @ret New value
+*/
+uint32_t crc32_update_u32(uint32_t crc, uint32_t value, uint8_t size);
+
+/*
+    @brief Continue a crc32 over the IEEE 754 bits of a float, little endian
+
+    @param[in] crc Value so far
+
+    @param[in] value Value to add
+
+    @ret New value
+*/
+uint32_t crc32_update_float(uint32_t crc, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRC32_H
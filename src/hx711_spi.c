@@ -0,0 +1,194 @@
+/* ****************************************************************************/
+/** HX711 SPI Readout Library 
+
+  @File Name
+    hx711_spi.c
+
+  @Summary
+    Reads the hx711 with the spi peripheral and dma instead of bit-banging
+
+  @Description
+    Implements the pulse train encoding, the decoding, the backend, and the nordic sdk
+    spi / gpiote glue. Change the glue if you're using a different micro.
+******************************************************************************/
+
+#include "hx711_spi.h"
+
+static volatile int32_t latest; // last decoded count
+static volatile bool fresh; // latest hasn't been read yet
+
+static bool spi_is_ready(void);
+static int32_t spi_read_raw(void);
+
+// same hx711 as hx711_backend, only the readout differs
+const StrainGaugeBackend hx711_spi_backend = {
+    .name = "hx711_spi",
+    .is_ready = spi_is_ready,
+    .read_raw = spi_read_raw,
+    .sample_rate = 10,
+    .resolution_bits = 24,
+    .full_scale = 0.5f,
+    .gain = 128,
+};
+
+/*
+    @brief Build the MOSI pattern for one conversion
+
+    @param[in] gain_pulses HX711_GAIN_ value for the next conversion
+
+    @param[out] tx HX711_SPI_BYTES bytes to send
+*/
+void hx711_spi_encode(uint8_t gain_pulses, uint8_t * tx) {
+    static const uint8_t tail[4] = {0x00, 0x80, 0xA0, 0xA8}; // 0 to 3 pulses
+    if(gain_pulses < HX711_GAIN_A128 || gain_pulses > HX711_GAIN_A64)
+	gain_pulses = HX711_GAIN_A128;
+    for(uint8_t i = 0; i < 6; i++)
+	tx[i] = 0xAA; // 24 data clocks
+    tx[6] = tail[gain_pulses];
+}
+
+/*
+    @brief Decode the MISO bytes of one conversion
+
+    @param[in] rx HX711_SPI_BYTES bytes received
+
+    @ret Sign extended 24 bit count
+*/
+int32_t hx711_spi_decode(const uint8_t * rx) {
+    uint32_t value = 0;
+    for(uint8_t i = 0; i < 6; i++) {
+	// odd bits of each byte, msb first: 0x40, 0x10, 0x04, 0x01
+	uint8_t b = rx[i];
+	value = (value << 4) | ((b >> 3) & 0x08) | ((b >> 2) & 0x04) | ((b >> 1) & 0x02) | (b & 0x01);
+    }
+    if(value & 0x800000)
+	value |= 0xFF000000; // sign extend
+    return (int32_t)value;
+}
+
+/*
+    @brief Hand a finished transfer to the driver
+
+    @param[in] rx HX711_SPI_BYTES bytes received
+*/
+void hx711_spi_transfer_done(const uint8_t * rx) {
+    int32_t raw = hx711_spi_decode(rx);
+    latest = raw;
+    fresh = true;
+#if SG_USE_RAW_RING
+    strain_gauge_push_raw(raw);
+#endif
+}
+
+/*
+    @brief A transfer has finished since the last read
+*/
+static bool spi_is_ready(void) {
+    return fresh;
+}
+
+/*
+    @brief Read the last decoded count
+
+    @note Doesn't touch the spi, the readout runs on its own. A transfer that finishes in
+	between is skipped rather than read twice.
+*/
+static int32_t spi_read_raw(void) {
+    int32_t raw = latest;
+    fresh = false;
+    return raw;
+}
+
+#ifndef HX711_SPI_HOST
+
+#include "nrf_drv_spi.h" // nordic sdk specific spi driver
+#include "nrf_drv_gpiote.h" // nordic sdk specific gpiote driver
+#include "nrf_gpio.h" // nordic sdk specific gpio functions
+
+static const nrf_drv_spi_t spi = NRF_DRV_SPI_INSTANCE(0);
+static uint8_t tx_buf[HX711_SPI_BYTES];
+static uint8_t rx_buf[HX711_SPI_BYTES];
+static uint32_t drdy_pin;
+
+/*
+    @brief Read out the waiting conversion
+
+    @note The edge event is turned off while the transfer toggles DOUT. If a transfer is
+	already running it's left alone, its done handler re-arms.
+*/
+static void start_transfer(void) {
+    nrf_drv_gpiote_in_event_disable(drdy_pin);
+    nrf_drv_spi_transfer(&spi, tx_buf, HX711_SPI_BYTES, rx_buf, HX711_SPI_BYTES);
+}
+
+/*
+    @brief Wait for the next conversion
+
+    @note DOUT may already be low, a conversion that was waiting before the event was
+	enabled has no falling edge left to report it, so it's read out straight away
+*/
+static void arm(void) {
+    nrf_drv_gpiote_in_event_enable(drdy_pin, true);
+    if(nrf_gpio_pin_read(drdy_pin) == 0)
+	start_transfer();
+}
+
+/*
+    @brief Data ready, DOUT went low
+*/
+static void drdy_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+    (void)pin;
+    (void)action;
+    start_transfer();
+}
+
+/*
+    @brief Transfer done, decode and hand the count to the driver
+*/
+static void spi_handler(nrf_drv_spi_evt_t const * event, void * context) {
+    (void)context;
+    if(event->type == NRF_DRV_SPI_EVENT_DONE)
+	hx711_spi_transfer_done(rx_buf);
+    arm(); // DOUT may have gone low again during the transfer
+}
+
+/*
+    @brief Start the spi readout
+
+    @param[in] pd_sck_pin Pin wired to hx711 PD_SCK, driven by spi MOSI
+
+    @param[in] dout_pin Pin wired to hx711 DOUT, spi MISO and data ready
+
+    @param[in] spare_sck_pin Unconnected pin for the spi clock
+
+    @param[in] gain_pulses HX711_GAIN_ value for every conversion
+
+    @ret true if the spi and gpiote were set up
+*/
+bool hx711_spi_init(uint32_t pd_sck_pin, uint32_t dout_pin, uint32_t spare_sck_pin, uint8_t gain_pulses) {
+    hx711_spi_encode(gain_pulses, tx_buf);
+    drdy_pin = dout_pin;
+
+    nrf_drv_spi_config_t spi_config = NRF_DRV_SPI_DEFAULT_CONFIG;
+    spi_config.sck_pin = spare_sck_pin;
+    spi_config.mosi_pin = pd_sck_pin;
+    spi_config.miso_pin = dout_pin;
+    spi_config.ss_pin = NRF_DRV_SPI_PIN_NOT_USED;
+    spi_config.frequency = NRF_DRV_SPI_FREQ_1M;
+    spi_config.mode = NRF_DRV_SPI_MODE_0; // MISO sampled mid bit
+    spi_config.bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST;
+    spi_config.orc = 0x00; // keeps PD_SCK low
+    if(nrf_drv_spi_init(&spi, &spi_config, spi_handler, NULL) != NRF_SUCCESS)
+	return false;
+
+    // data ready on the falling edge of DOUT, port event so it can share the MISO pin
+    if(!nrf_drv_gpiote_is_init() && nrf_drv_gpiote_init() != NRF_SUCCESS)
+	return false;
+    nrf_drv_gpiote_in_config_t drdy_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+    if(nrf_drv_gpiote_in_init(dout_pin, &drdy_config, drdy_handler) != NRF_SUCCESS)
+	return false;
+    arm(); // a conversion is usually already waiting after power up
+    return true;
+}
+
+#endif // HX711_SPI_HOST
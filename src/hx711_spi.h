@@ -0,0 +1,104 @@
+/* ****************************************************************************/
+/** HX711 SPI Readout Library 
+
+  @File Name
+    hx711_spi.h
+
+  @Summary
+    Reads the hx711 with the spi peripheral and dma instead of bit-banging
+
+  @Description
+    Defines a readout where spi MOSI drives the hx711 PD_SCK pin and spi MISO samples DOUT.
+    The spi runs at twice the hx711 clock and every hx711 clock is the bit pair 1,0 on
+    MOSI, so one transfer of HX711_SPI_BYTES generates the whole 25-27 pulse train and
+    captures the 24 data bits. The transfer is started from the DOUT falling edge (data
+    ready), or straight away if DOUT is already low when init or a transfer finishes, and
+    decoded in the transfer done handler, which keeps the count for hx711_spi_backend and
+    pushes it into the raw ring for strain_gauge_acquire(), so the cpu only spends a few
+    instructions per sample.
+******************************************************************************/
+
+#ifndef HX711_SPI_H
+#define HX711_SPI_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "strain_gauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HX711_SPI_BYTES 7 // 27 pulses at 2 bits each fit in 7 bytes
+
+// pulses after the 24 data bits, they set the channel and gain of the next conversion
+#define HX711_GAIN_A128 1
+#define HX711_GAIN_B32 2
+#define HX711_GAIN_A64 3
+
+// hx711 read over spi, select with strain_gauge_set_backend() after hx711_spi_init(),
+// channel A gain 128 at 10 SPS, copy it and change gain / sample_rate for other settings
+extern const StrainGaugeBackend hx711_spi_backend;
+
+/*
+    @brief Build the MOSI pattern for one conversion
+
+    @note 0xAA is four hx711 clocks, the last byte carries the gain pulses and ends low so
+	PD_SCK idles low between conversions (held high for 60us powers the hx711 down)
+
+    @param[in] gain_pulses HX711_GAIN_ value for the next conversion
+
+    @param[out] tx HX711_SPI_BYTES bytes to send
+*/
+void hx711_spi_encode(uint8_t gain_pulses, uint8_t * tx);
+
+/*
+    @brief Decode the MISO bytes of one conversion
+
+    @note Data bit n (msb first) is shifted out on the rising edge of hx711 clock n and is
+	sampled in the low half of that clock, which is spi bit 2n+1
+
+    @param[in] rx HX711_SPI_BYTES bytes received
+
+    @ret Sign extended 24 bit count
+*/
+int32_t hx711_spi_decode(const uint8_t * rx);
+
+/*
+    @brief Hand a finished transfer to the driver
+
+    @note Called from the spi transfer done handler. Decodes the count, keeps it for
+	hx711_spi_backend and pushes it into the raw ring. Isr safe, one producer only.
+
+    @param[in] rx HX711_SPI_BYTES bytes received
+*/
+void hx711_spi_transfer_done(const uint8_t * rx);
+
+#ifndef HX711_SPI_HOST // define to build without the nordic glue, e.g. to check the readout on a host
+
+/*
+    @brief Start the spi readout
+
+    @note Runs the spi at 1 MHz, a 500 kHz hx711 clock. The spi SCK pin isn't connected to
+	anything, give it a free pin. From here on samples arrive on their own, read them
+	through hx711_spi_backend or strain_gauge_acquire().
+
+    @param[in] pd_sck_pin Pin wired to hx711 PD_SCK, driven by spi MOSI
+
+    @param[in] dout_pin Pin wired to hx711 DOUT, spi MISO and data ready
+
+    @param[in] spare_sck_pin Unconnected pin for the spi clock
+
+    @param[in] gain_pulses HX711_GAIN_ value for every conversion
+
+    @ret true if the spi and gpiote were set up
+*/
+bool hx711_spi_init(uint32_t pd_sck_pin, uint32_t dout_pin, uint32_t spare_sck_pin, uint8_t gain_pulses);
+
+#endif // HX711_SPI_HOST
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HX711_SPI_H
@@ -0,0 +1,162 @@
+/* ****************************************************************************/
+/** Kalman Filter Library 
+
+  @File Name
+    kalman.c
+
+  @Summary
+    Two state (mass, mass rate) Kalman filter for a strain gauge stream
+
+  @Description
+    Implements the constant rate model x = [mass, rate], F = [1 dt; 0 1], H = [1 0],
+    with white noise on the rate (continuous white noise acceleration)
+******************************************************************************/
+
+#include "kalman.h"
+#include <math.h>
+
+/*
+    @brief Initialize a float filter
+
+    @param[out] kf Filter to initialize
+
+    @param[in] q Process noise in (kg/s)^2/s
+
+    @param[in] r Measurement noise variance in kg^2
+*/
+void kalman_init(Kalman * kf, float q, float r) {
+    kf->mass = 0;
+    kf->rate = 0;
+    kf->p00 = 0;
+    kf->p01 = 0;
+    kf->p11 = 0;
+    kf->q = q;
+    kf->r = r;
+    kf->innovation = 0;
+    kf->nis = 0;
+    kf->nis_avg = 1;
+    kf->last_ms = 0;
+    kf->initialized = false;
+    kf->rate_known = false;
+}
+
+/*
+    @brief Update a float filter with a reading
+
+    @param[in] kf Filter
+
+    @param[in] kgs Reading in kg
+
+    @param[in] timestamp_ms When the reading was taken
+*/
+void kalman_update(Kalman * kf, float kgs, uint32_t timestamp_ms) {
+    if(isnan(kgs))
+	return;
+    if(!kf->initialized) {
+	// start at the reading, with the rate unknown
+	kf->mass = kgs;
+	kf->rate = 0;
+	kf->p00 = kf->r;
+	kf->p01 = 0;
+	kf->p11 = 0;
+	kf->last_ms = timestamp_ms;
+	kf->initialized = true;
+	kf->rate_known = false;
+	return;
+    }
+    float dt = (uint32_t)(timestamp_ms - kf->last_ms) / 1000.0f; // wraps correctly
+    if(!kf->rate_known) {
+	// two point start, the rate is the difference of two readings with variance r each
+	if(dt <= 0)
+	    return;
+	kf->rate = (kgs - kf->mass) / dt;
+	kf->mass = kgs;
+	kf->p00 = kf->r;
+	kf->p01 = kf->r / dt;
+	kf->p11 = 2 * kf->r / (dt * dt);
+	kf->last_ms = timestamp_ms;
+	kf->rate_known = true;
+	return;
+    }
+    kf->last_ms = timestamp_ms;
+
+    // predict, P = F P F' + Q
+    float dt2 = dt * dt;
+    kf->mass += kf->rate * dt;
+    kf->p00 += dt * (2 * kf->p01 + dt * kf->p11) + kf->q * dt2 * dt / 3;
+    kf->p01 += dt * kf->p11 + kf->q * dt2 / 2;
+    kf->p11 += kf->q * dt;
+
+    // update
+    float s = kf->p00 + kf->r; // innovation variance
+    float k0 = kf->p00 / s;
+    float k1 = kf->p01 / s;
+    kf->innovation = kgs - kf->mass;
+    kf->mass += k0 * kf->innovation;
+    kf->rate += k1 * kf->innovation;
+    kf->p11 -= k1 * kf->p01;
+    kf->p01 -= k0 * kf->p01;
+    kf->p00 -= k0 * kf->p00;
+
+    kf->nis = kf->innovation * kf->innovation / s;
+    kf->nis_avg += KALMAN_NIS_WEIGHT * (kf->nis - kf->nis_avg);
+}
+
+/*
+    @brief Check the innovation statistics for a fault
+
+    @param[in] kf Filter
+
+    @param[in] limit Largest acceptable running nis
+
+    @ret true if the readings are consistent with the model
+*/
+bool kalman_consistent(const Kalman * kf, float limit) {
+    return kf->nis_avg <= limit;
+}
+
+/*
+    @brief Initialize a fixed point filter from a converged float filter
+
+    @note The steady state gains come from the predicted covariance, the same k0 and k1 the
+	float filter would use for its next reading
+
+    @param[out] kx Filter to initialize
+
+    @param[in] kf Converged float filter
+
+    @param[in] dt Sample period in s
+*/
+void kalman_fixed_init(KalmanFixed * kx, const Kalman * kf, float dt) {
+    float dt2 = dt * dt;
+    float p00 = kf->p00 + dt * (2 * kf->p01 + dt * kf->p11) + kf->q * dt2 * dt / 3;
+    float p01 = kf->p01 + dt * kf->p11 + kf->q * dt2 / 2;
+    float s = p00 + kf->r;
+    kx->mass = 0;
+    kx->rate = 0;
+    kx->dt = (int32_t)lroundf(dt * 65536.0f);
+    kx->k0 = (int32_t)lroundf(p00 / s * 1073741824.0f);
+    kx->k1 = (int32_t)lroundf(p01 / s * 65536.0f);
+    kx->innovation = 0;
+    kx->initialized = false;
+}
+
+/*
+    @brief Update a fixed point filter with a reading
+
+    @param[in] kx Filter
+
+    @param[in] kgs Reading in kg, Q16.16
+*/
+void kalman_fixed_update(KalmanFixed * kx, int32_t kgs) {
+    if(!kx->initialized) {
+	kx->mass = kgs;
+	kx->rate = 0;
+	kx->initialized = true;
+	return;
+    }
+    kx->mass += (int32_t)(((int64_t)kx->rate * kx->dt) >> 16);
+    kx->innovation = kgs - kx->mass;
+    kx->mass += (int32_t)(((int64_t)kx->k0 * kx->innovation) >> 30);
+    kx->rate += (int32_t)(((int64_t)kx->k1 * kx->innovation) >> 16);
+}
@@ -0,0 +1,129 @@
+/* ****************************************************************************/
+/** Kalman Filter Library 
+
+  @File Name
+    kalman.h
+
+  @Summary
+    Two state (mass, mass rate) Kalman filter for a strain gauge stream
+
+  @Description
+    Defines a constant rate Kalman filter that estimates the weight and how fast it's
+    changing from timestamped readings. Meant for dosing and conveyors, where it settles
+    faster than read_average() and doesn't lag behind a steady fill. A float version
+    tracks the full covariance, a fixed point version runs with the steady state gains
+    of a converged float filter for parts without an fpu.
+******************************************************************************/
+
+#ifndef KALMAN_H
+#define KALMAN_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KALMAN_NIS_WEIGHT 0.05f // weight of each sample in the running average of the nis
+
+// float filter state
+typedef struct {
+    float mass; // kg
+    float rate; // kg/s
+    float p00, p01, p11; // state covariance, symmetric so p10 isn't stored
+    float q; // process noise, spectral density of the rate changes in (kg/s)^2/s
+    float r; // measurement noise variance in kg^2
+    float innovation; // last reading minus the predicted mass, kg
+    float nis; // last normalized innovation squared
+    float nis_avg; // running average of the nis, about 1 when q and r are right
+    uint32_t last_ms; // timestamp of the last update
+    bool initialized; // set by the first update
+    bool rate_known; // set by the second update, which starts the rate
+}Kalman;
+
+// fixed point filter state, values are Q16.16
+typedef struct {
+    int32_t mass; // kg
+    int32_t rate; // kg/s
+    int32_t dt; // sample period, s
+    int32_t k0; // mass gain, Q2.30
+    int32_t k1; // rate gain, 1/s
+    int32_t innovation; // last reading minus the predicted mass, kg
+    bool initialized; // set by the first update
+}KalmanFixed;
+
+/*
+    @brief Initialize a float filter
+
+    @note Larger q follows load changes faster, smaller q smooths more. r is the variance of
+	the readings with a constant load, e.g. the square of the rms from noise_calculate().
+
+    @param[out] kf Filter to initialize
+
+    @param[in] q Process noise in (kg/s)^2/s
+
+    @param[in] r Measurement noise variance in kg^2
+*/
+void kalman_init(Kalman * kf, float q, float r);
+
+/*
+    @brief Update a float filter with a reading
+
+    @note The first two readings initialize the state: the mass from the first, the rate from
+	the difference between the two with a covariance of r/dt^2 to match. Starting the
+	rate with a variance of r instead would take many readings to pick up a load that is
+	already moving. Readings that are NAN, and a second reading with the same timestamp
+	as the first, are skipped.
+
+    @param[in] kf Filter
+
+    @param[in] kgs Reading in kg
+
+    @param[in] timestamp_ms When the reading was taken
+*/
+void kalman_update(Kalman * kf, float kgs, uint32_t timestamp_ms);
+
+/*
+    @brief Check the innovation statistics for a fault
+
+    @note A running nis well above 1 means the readings don't behave like the model, e.g. a
+	mechanical fault or something leaning on the scale
+
+    @param[in] kf Filter
+
+    @param[in] limit Largest acceptable running nis, 3 to 5 is typical
+
+    @ret true if the readings are consistent with the model
+*/
+bool kalman_consistent(const Kalman * kf, float limit);
+
+/*
+    @brief Initialize a fixed point filter from a converged float filter
+
+    @note Run the float filter on a host or at startup with the same sample period until the
+	gains settle, then use its covariance here. The fixed point filter only does a handful
+	of integer multiplies per sample.
+
+    @param[out] kx Filter to initialize
+
+    @param[in] kf Converged float filter
+
+    @param[in] dt Sample period in s
+*/
+void kalman_fixed_init(KalmanFixed * kx, const Kalman * kf, float dt);
+
+/*
+    @brief Update a fixed point filter with a reading
+
+    @param[in] kx Filter
+
+    @param[in] kgs Reading in kg, Q16.16
+*/
+void kalman_fixed_update(KalmanFixed * kx, int32_t kgs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KALMAN_H
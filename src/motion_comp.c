@@ -0,0 +1,111 @@
+/* ****************************************************************************/
+/** Motion Compensation Library 
+
+  @File Name
+    motion_comp.c
+
+  @Summary
+    Removes inertial forces from strain gauge readings on moving platforms
+
+  @Description
+    Implements the time alignment and g/(g+a) correction. Timestamps are compared as
+    signed differences so the ms counter can wrap.
+******************************************************************************/
+
+#include "motion_comp.h"
+#include <math.h>
+
+// head and count are uint8_t and head wraps with a mask, count reaches MOTION_IMU_BUFFER
+_Static_assert(MOTION_IMU_BUFFER > 1 && (MOTION_IMU_BUFFER & (MOTION_IMU_BUFFER - 1)) == 0 && MOTION_IMU_BUFFER <= 128,
+	"MOTION_IMU_BUFFER has to be a power of 2 from 2 to 128");
+
+/*
+    @brief Initialize a fusion stage
+
+    @param[out] mc Stage to initialize
+
+    @param[in] g Local gravity in m/s^2
+
+    @param[in] delay_ms Strain gauge delay relative to the imu
+*/
+void motion_comp_init(MotionComp * mc, float g, int32_t delay_ms) {
+    mc->head = 0;
+    mc->count = 0;
+    mc->g = g;
+    mc->delay_ms = delay_ms;
+}
+
+/*
+    @brief Add an imu sample
+
+    @param[in] mc Stage
+
+    @param[in] accel Vertical acceleration in m/s^2
+
+    @param[in] timestamp_ms When the sample was taken
+*/
+void motion_comp_push_imu(MotionComp * mc, float accel, uint32_t timestamp_ms) {
+    mc->t_ms[mc->head] = timestamp_ms;
+    mc->accel[mc->head] = accel;
+    mc->head = (mc->head + 1) & (MOTION_IMU_BUFFER - 1);
+    if(mc->count < MOTION_IMU_BUFFER)
+	mc->count++;
+}
+
+/*
+    @brief Get the acceleration at a point in time
+
+    @param[in] mc Stage
+
+    @param[in] timestamp_ms Time to look up
+
+    @param[out] accel Acceleration in m/s^2
+
+    @ret false if the buffer doesn't cover timestamp_ms
+*/
+bool motion_comp_accel_at(const MotionComp * mc, uint32_t timestamp_ms, float * accel) {
+    if(mc->count == 0)
+	return false;
+    // walk back from the newest sample, readings are usually close to it
+    uint8_t newer = (mc->head - 1) & (MOTION_IMU_BUFFER - 1);
+    int32_t ahead = (int32_t)(timestamp_ms - mc->t_ms[newer]);
+    if(ahead >= 0) {
+	if(ahead > MOTION_MAX_HOLD_MS)
+	    return false;
+	*accel = mc->accel[newer];
+	return true;
+    }
+    for(uint8_t i = 1; i < mc->count; i++) {
+	uint8_t older = (mc->head - 1 - i) & (MOTION_IMU_BUFFER - 1);
+	int32_t since = (int32_t)(timestamp_ms - mc->t_ms[older]);
+	if(since >= 0) {
+	    int32_t span = (int32_t)(mc->t_ms[newer] - mc->t_ms[older]);
+	    float frac = span > 0 ? (float)since / span : 0;
+	    *accel = mc->accel[older] + frac * (mc->accel[newer] - mc->accel[older]);
+	    return true;
+	}
+	newer = older;
+    }
+    return false; // older than anything buffered
+}
+
+/*
+    @brief Remove the inertial force from a reading
+
+    @param[in] mc Stage
+
+    @param[in] kgs Gross strain gauge reading in kg
+
+    @param[in] timestamp_ms When the reading was taken
+
+    @ret Corrected reading in kg, NAN if there's no imu data for it or the platform is near free fall
+*/
+float motion_comp_apply(const MotionComp * mc, float kgs, uint32_t timestamp_ms) {
+    float accel;
+    if(!motion_comp_accel_at(mc, timestamp_ms - mc->delay_ms, &accel))
+	return NAN;
+    float effective_g = mc->g + accel;
+    if(effective_g < MOTION_MIN_G * mc->g)
+	return NAN;
+    return kgs * mc->g / effective_g;
+}
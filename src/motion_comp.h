@@ -0,0 +1,105 @@
+/* ****************************************************************************/
+/** Motion Compensation Library 
+
+  @File Name
+    motion_comp.h
+
+  @Summary
+    Removes inertial forces from strain gauge readings on moving platforms
+
+  @Description
+    Defines a fusion stage that takes the vertical acceleration from an imu alongside the
+    strain gauge readings. The cell measures m*(g+a), so each reading is scaled by
+    g/(g+a) using the acceleration at the time the reading was taken.
+******************************************************************************/
+
+#ifndef MOTION_COMP_H
+#define MOTION_COMP_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MOTION_IMU_BUFFER
+#define MOTION_IMU_BUFFER 32 // imu samples kept for time alignment, power of 2
+#endif
+#define MOTION_MAX_HOLD_MS 20 // how far past the newest imu sample a reading can be and still use it
+#define MOTION_MIN_G 0.2f // fraction of g below which (near free fall) readings aren't corrected
+
+// fusion state
+typedef struct {
+    uint32_t t_ms[MOTION_IMU_BUFFER]; // imu sample timestamps
+    float accel[MOTION_IMU_BUFFER]; // vertical acceleration, m/s^2, up is positive, gravity removed
+    uint8_t head; // next slot to write
+    uint8_t count; // samples in the buffer
+    float g; // local gravity, m/s^2
+    int32_t delay_ms; // how much later the strain gauge reports a load than the imu sees it
+}MotionComp;
+
+/*
+    @brief Initialize a fusion stage
+
+    @note delay_ms lines the two streams up, the hx711 and any averaging delay the strain gauge
+	readings compared to the imu. Measure it by shaking the platform and finding the shift
+	that best lines up the two signals.
+
+    @param[out] mc Stage to initialize
+
+    @param[in] g Local gravity in m/s^2
+
+    @param[in] delay_ms Strain gauge delay relative to the imu
+*/
+void motion_comp_init(MotionComp * mc, float g, int32_t delay_ms);
+
+/*
+    @brief Add an imu sample
+
+    @param[in] mc Stage
+
+    @param[in] accel Vertical acceleration in m/s^2, up is positive, gravity removed
+
+    @param[in] timestamp_ms When the sample was taken, same clock as the strain gauge readings
+*/
+void motion_comp_push_imu(MotionComp * mc, float accel, uint32_t timestamp_ms);
+
+/*
+    @brief Get the acceleration at a point in time
+
+    @note Linearly interpolated between the two imu samples around timestamp_ms
+
+    @param[in] mc Stage
+
+    @param[in] timestamp_ms Time to look up
+
+    @param[out] accel Acceleration in m/s^2
+
+    @ret false if the buffer doesn't cover timestamp_ms
+*/
+bool motion_comp_accel_at(const MotionComp * mc, uint32_t timestamp_ms, float * accel);
+
+/*
+    @brief Remove the inertial force from a reading
+
+    @note The inertial force acts on everything the cell carries, so correct the gross reading,
+	before the tare is subtracted, or the tare's share is left in. The driver does this
+	for every conversion with strain_gauge_attach_motion_comp(). For a platform on several
+	cells, correct each gross reading (or their sum) with the same stage.
+
+    @param[in] mc Stage
+
+    @param[in] kgs Gross strain gauge reading in kg
+
+    @param[in] timestamp_ms When the reading was taken
+
+    @ret Corrected reading in kg, NAN if there's no imu data for it or the platform is near free fall
+*/
+float motion_comp_apply(const MotionComp * mc, float kgs, uint32_t timestamp_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_COMP_H
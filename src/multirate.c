@@ -0,0 +1,121 @@
+/* ****************************************************************************/
+/** Multirate Decimation Library 
+
+  @File Name
+    multirate.c
+
+  @Summary
+    Fans one sample stream out to consumers that each want their own output rate
+
+  @Description
+    Implements a cascaded boxcar decimation stage. The average of equal length averages
+    is the average of the whole window, so feeding a slow output from a faster one gives
+    the same result as averaging the raw stream.
+******************************************************************************/
+
+#include "multirate.h"
+#include <math.h>
+#include <stddef.h>
+
+_Static_assert(MULTIRATE_MAX_OUTPUTS > 0 && MULTIRATE_MAX_OUTPUTS <= UINT8_MAX,
+	"MULTIRATE_MAX_OUTPUTS has to fit output_cnt, a uint8_t");
+
+/*
+    @brief Initialize a fan out stage with no outputs
+
+    @param[out] mr Stage to initialize
+*/
+void multirate_init(Multirate * mr) {
+    mr->output_cnt = 0;
+    mr->last = NAN;
+    mr->held = 0;
+}
+
+/*
+    @brief Pick the parent of every output and restart the windows
+
+    @note The parent is the output with the largest factor that divides this one, fewest
+	values to add up per output
+
+    @param[in] mr Stage
+*/
+static void multirate_link(Multirate * mr) {
+    for(uint8_t i = 0; i < mr->output_cnt; i++) {
+	MultirateOutput * out = &mr->outputs[i];
+	out->parent = -1;
+	out->stage_factor = out->factor;
+	for(uint8_t j = 0; j < i; j++) {
+	    uint32_t f = mr->outputs[j].factor;
+	    if(f < out->factor && out->factor % f == 0 && out->factor / f < out->stage_factor) {
+		out->parent = j;
+		out->stage_factor = out->factor / f;
+	    }
+	}
+	out->sum = 0;
+	out->count = 0;
+    }
+}
+
+/*
+    @brief Add an output
+
+    @param[in] mr Stage
+
+    @param[in] factor Input samples per output
+
+    @param[in] handler Called with each output value
+
+    @param[in] context Passed to handler
+
+    @ret true if added, false if the stage is full or factor is 0
+*/
+bool multirate_add(Multirate * mr, uint32_t factor, multirate_handler_t handler, void * context) {
+    if(mr->output_cnt >= MULTIRATE_MAX_OUTPUTS || factor == 0 || handler == NULL)
+	return false;
+    // insert in factor order
+    uint8_t pos = mr->output_cnt;
+    while(pos > 0 && mr->outputs[pos-1].factor > factor) {
+	mr->outputs[pos] = mr->outputs[pos-1];
+	pos--;
+    }
+    mr->outputs[pos].factor = factor;
+    mr->outputs[pos].handler = handler;
+    mr->outputs[pos].context = context;
+    mr->output_cnt++;
+    multirate_link(mr);
+    return true;
+}
+
+/*
+    @brief Push an input sample
+
+    @param[in] mr Stage
+
+    @param[in] sample Input sample
+*/
+void multirate_push(Multirate * mr, float sample) {
+    float value[MULTIRATE_MAX_OUTPUTS]; // value produced by each output this sample
+    bool produced[MULTIRATE_MAX_OUTPUTS];
+    if(!isfinite(sample)) {
+	if(!isfinite(mr->last))
+	    return; // nothing good to hold yet
+	sample = mr->last;
+	mr->held++;
+    }
+    else
+	mr->last = sample;
+    for(uint8_t i = 0; i < mr->output_cnt; i++) {
+	MultirateOutput * out = &mr->outputs[i];
+	produced[i] = false;
+	if(out->parent >= 0 && !produced[out->parent])
+	    continue;
+	out->sum += out->parent >= 0 ? value[out->parent] : sample;
+	if(++out->count < out->stage_factor)
+	    continue;
+	value[i] = out->sum / out->stage_factor;
+	produced[i] = true;
+	out->sum = 0;
+	out->count = 0;
+	out->handler(value[i], out->context);
+    }
+}
@@ -0,0 +1,103 @@
+/* ****************************************************************************/
+/** Multirate Decimation Library 
+
+  @File Name
+    multirate.h
+
+  @Summary
+    Fans one sample stream out to consumers that each want their own output rate
+
+  @Description
+    Defines a decimation stage where every output is a boxcar average over a whole number
+    of input samples. Outputs are cascaded: an output whose factor is a multiple of another
+    output's factor is fed from that output instead of the raw stream, so slow consumers
+    share the work already done for fast ones.
+******************************************************************************/
+
+#ifndef MULTIRATE_H
+#define MULTIRATE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MULTIRATE_MAX_OUTPUTS
+#define MULTIRATE_MAX_OUTPUTS 8 // consumers per stream
+#endif
+
+/*
+    @brief Output handler
+
+    @param[in] value Average of the samples in the output window
+
+    @param[in] context Pointer passed in when adding the output
+*/
+typedef void (*multirate_handler_t)(float value, void * context);
+
+// one decimated output
+typedef struct {
+    uint32_t factor; // input samples per output
+    uint32_t stage_factor; // parent outputs per output
+    int8_t parent; // output feeding this one, -1 for the input stream
+    float sum; // sum of the parent values in the current window
+    uint32_t count; // parent values in the current window
+    multirate_handler_t handler;
+    void * context;
+}MultirateOutput;
+
+// fan out stage, outputs are kept sorted by factor so parents come before children
+typedef struct {
+    MultirateOutput outputs[MULTIRATE_MAX_OUTPUTS];
+    uint8_t output_cnt;
+    float last; // last finite input, NAN until there is one
+    uint32_t held; // NAN inputs replaced by last
+}Multirate;
+
+/*
+    @brief Initialize a fan out stage with no outputs
+
+    @param[out] mr Stage to initialize
+*/
+void multirate_init(Multirate * mr);
+
+/*
+    @brief Add an output
+
+    @note Re-links the cascade, so the windows of every output restart
+
+    @param[in] mr Stage
+
+    @param[in] factor Input samples per output, e.g. 8 for 10 Hz from an 80 SPS stream
+
+    @param[in] handler Called with each output value
+
+    @param[in] context Passed to handler
+
+    @ret true if added, false if the stage is full or factor is 0
+*/
+bool multirate_add(Multirate * mr, uint32_t factor, multirate_handler_t handler, void * context);
+
+/*
+    @brief Push an input sample
+
+    @note Outputs whose parent didn't produce a value this sample are skipped, so the cost per
+	sample is set by the fast outputs, not the number of slow ones
+
+    @note A NAN or infinite sample, e.g. a faulted read, is replaced by the last finite one
+	and counted in held, so one bad sample doesn't spoil a whole window of every output.
+	Samples before the first finite one are dropped.
+
+    @param[in] mr Stage
+
+    @param[in] sample Input sample
+*/
+void multirate_push(Multirate * mr, float sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MULTIRATE_H
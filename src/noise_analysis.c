@@ -0,0 +1,108 @@
+/* ****************************************************************************/
+/** Noise Analysis Library 
+
+  @File Name
+    noise_analysis.c
+
+  @Summary
+    Noise characterization for a raw strain gauge stream
+
+  @Description
+    Implements functions that compute noise statistics and an Allan deviation curve
+    from a buffer of raw adc counts, either on the device or on a host from a log
+******************************************************************************/
+
+#include "noise_analysis.h"
+#include <math.h>
+
+/*
+    @brief Calculate noise statistics of a raw capture
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] adc_bits Resolution of the adc the samples came from
+
+    @param[out] stats Noise statistics
+*/
+void noise_calculate(const int32_t * samples, uint32_t n, uint8_t adc_bits, NoiseStats * stats) {
+    int64_t sum = 0;
+    int32_t min = INT32_MAX, max = INT32_MIN;
+    double mean, var = 0;
+    uint32_t i;
+
+    stats->mean = 0;
+    stats->rms = 0;
+    stats->peak_to_peak = 0;
+    stats->effective_bits = 0;
+    stats->noise_free_bits = 0;
+    if(n == 0)
+	return;
+
+    for(i = 0; i < n; i++) {
+	sum += samples[i];
+	if(samples[i] < min)
+	    min = samples[i];
+	if(samples[i] > max)
+	    max = samples[i];
+    }
+    mean = (double)sum / n;
+    for(i = 0; i < n; i++) {
+	double d = samples[i] - mean;
+	var += d * d;
+    }
+    if(n > 1)
+	var /= n - 1;
+
+    stats->mean = mean;
+    stats->rms = sqrt(var);
+    stats->peak_to_peak = max - min;
+    // a noiseless capture is limited by the adc itself
+    stats->effective_bits = stats->rms > 0 ? adc_bits - log2(stats->rms) : adc_bits;
+    stats->noise_free_bits = stats->peak_to_peak > 0 ? adc_bits - log2(stats->peak_to_peak) : adc_bits;
+}
+
+/*
+    @brief Calculate the overlapping Allan deviation at octave averaging times
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] sample_rate Sample rate in Hz, used to convert m to an averaging time
+
+    @param[out] tau Averaging times in seconds
+
+    @param[out] adev Allan deviation in counts at each averaging time
+
+    @param[in] max_points Size of the tau and adev arrays
+
+    @ret Number of points written
+*/
+uint8_t noise_allan_deviation(const int32_t * samples, uint32_t n, float sample_rate,
+			      float * tau, float * adev, uint8_t max_points) {
+    uint8_t points = 0;
+    for(uint32_t m = 1; 2 * m <= n && points < max_points; m *= 2) {
+	int64_t sum_a = 0, sum_b = 0; // sums of the two adjacent windows of m samples
+	double acc = 0;
+	uint32_t j, terms = n - 2 * m + 1;
+	for(j = 0; j < m; j++) {
+	    sum_a += samples[j];
+	    sum_b += samples[j + m];
+	}
+	for(j = 0; ; j++) {
+	    double d = (double)(sum_b - sum_a);
+	    acc += d * d;
+	    if(j + 1 == terms)
+		break;
+	    // slide both windows one sample to the right
+	    sum_a += samples[j + m] - samples[j];
+	    sum_b += samples[j + 2 * m] - samples[j + m];
+	}
+	tau[points] = m / sample_rate;
+	adev[points] = sqrt(acc / (2.0 * m * m * terms));
+	points++;
+    }
+    return points;
+}
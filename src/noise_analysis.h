@@ -0,0 +1,68 @@
+/* ****************************************************************************/
+/** Noise Analysis Library 
+
+  @File Name
+    noise_analysis.h
+
+  @Summary
+    Noise characterization for a raw strain gauge stream
+
+  @Description
+    Defines functions that compute noise statistics and an Allan deviation curve
+    from a buffer of raw adc counts, either on the device or on a host from a log
+******************************************************************************/
+
+#ifndef NOISE_ANALYSIS_H
+#define NOISE_ANALYSIS_H
+
+#include <inttypes.h>
+
+// noise statistics of a raw capture, all values in counts unless noted
+typedef struct {
+    float mean; // mean count
+    float rms; // rms noise (standard deviation)
+    int32_t peak_to_peak; // max - min
+    float effective_bits; // effective resolution, log2(2^adc_bits / rms)
+    float noise_free_bits; // noise-free resolution, log2(2^adc_bits / peak_to_peak)
+}NoiseStats;
+
+/*
+    @brief Calculate noise statistics of a raw capture
+
+    @note Two passes over the buffer, the variance is computed around the mean so it doesn't
+	lose precision on a large dc offset
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] adc_bits Resolution of the adc the samples came from, e.g. 24 for the hx711
+
+    @param[out] stats Noise statistics
+*/
+void noise_calculate(const int32_t * samples, uint32_t n, uint8_t adc_bits, NoiseStats * stats);
+
+/*
+    @brief Calculate the overlapping Allan deviation at octave averaging times
+
+    @note Evaluated at m = 1, 2, 4, ... samples while 2m <= n. Each point uses sliding window
+	sums, so a point costs O(n) and the whole curve O(n log n) with no extra memory.
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] sample_rate Sample rate in Hz, used to convert m to an averaging time
+
+    @param[out] tau Averaging times in seconds
+
+    @param[out] adev Allan deviation in counts at each averaging time
+
+    @param[in] max_points Size of the tau and adev arrays
+
+    @ret Number of points written
+*/
+uint8_t noise_allan_deviation(const int32_t * samples, uint32_t n, float sample_rate,
+			      float * tau, float * adev, uint8_t max_points);
+
+#endif // NOISE_ANALYSIS_H
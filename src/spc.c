@@ -0,0 +1,190 @@
+/* ****************************************************************************/
+/** Statistical Process Control Library 
+
+  @File Name
+    spc.c
+
+  @Summary
+    Control charts and alarms for filled package weights
+
+  @Description
+    Implements X-bar/R charts with limits from the baseline subgroups, a tabular CUSUM,
+    an EWMA chart and underfill counting, all updated one package at a time
+******************************************************************************/
+
+#include "spc.h"
+#include <math.h>
+
+// control chart constants for subgroup sizes 2 to 10
+static const float A2[] = {1.880f, 1.023f, 0.729f, 0.577f, 0.483f, 0.419f, 0.373f, 0.337f, 0.308f};
+static const float D3[] = {0, 0, 0, 0, 0, 0.076f, 0.136f, 0.184f, 0.223f};
+static const float D4[] = {3.267f, 2.574f, 2.282f, 2.114f, 2.004f, 1.924f, 1.864f, 1.816f, 1.777f};
+static const float d2[] = {1.128f, 1.693f, 2.059f, 2.326f, 2.534f, 2.704f, 2.847f, 2.970f, 3.078f};
+
+/*
+    @brief Initialize an spc stage
+
+    @param[out] spc Stage to initialize
+
+    @param[in] target Target fill in kg
+
+    @param[in] lower_limit Lower tolerance limit in kg
+
+    @param[in] subgroup_size Packages per X-bar/R subgroup
+
+    @param[in] sigma Process standard deviation in kg, 0 to estimate it
+
+    @ret true if initialized, false if the subgroup size is out of range
+*/
+bool spc_init(Spc * spc, float target, float lower_limit, uint8_t subgroup_size, float sigma) {
+    if(subgroup_size < SPC_MIN_SUBGROUP || subgroup_size > SPC_MAX_SUBGROUP)
+	return false;
+    spc->target = target;
+    spc->lower_limit = lower_limit;
+    spc->sigma = sigma > 0 ? sigma : 0;
+    spc->subgroup_size = subgroup_size;
+    spc->xbar = NAN;
+    spc->range = NAN;
+    spc->xbar_sum = 0;
+    spc->range_sum = 0;
+    spc->baseline_cnt = 0;
+    spc_reset(spc);
+    return true;
+}
+
+/*
+    @brief Start a new lot
+
+    @param[in] spc Stage
+*/
+void spc_reset(Spc * spc) {
+    // a partial subgroup belongs to the old lot
+    spc->sub_cnt = 0;
+    spc->sub_sum = 0;
+    spc->sub_min = NAN;
+    spc->sub_max = NAN;
+    spc->cusum_high = 0;
+    spc->cusum_low = 0;
+    spc->ewma = spc->target;
+    spc->ewma_decay = 1;
+    spc->packages = 0;
+    spc->underfills = 0;
+}
+
+/*
+    @brief Close a subgroup and check it against the X-bar/R limits
+
+    @note The first SPC_BASELINE_SUBGROUPS subgroups set the limits: xbar +- A2*Rbar and
+	D3*Rbar to D4*Rbar. Without a given sigma it's estimated as Rbar/d2.
+
+    @param[in] spc Stage
+
+    @ret SPC_ALARM_ bits for the subgroup
+*/
+static uint16_t close_subgroup(Spc * spc) {
+    uint16_t alarms = SPC_ALARM_NONE;
+    uint8_t c = spc->subgroup_size - SPC_MIN_SUBGROUP;
+    spc->xbar = spc->sub_sum / spc->sub_cnt;
+    spc->range = spc->sub_max - spc->sub_min;
+    spc->sub_cnt = 0;
+
+    if(spc->baseline_cnt < SPC_BASELINE_SUBGROUPS) {
+	spc->xbar_sum += spc->xbar;
+	spc->range_sum += spc->range;
+	if(++spc->baseline_cnt < SPC_BASELINE_SUBGROUPS)
+	    return alarms;
+	float rbar = spc->range_sum / SPC_BASELINE_SUBGROUPS;
+	spc->xbar_center = spc->xbar_sum / SPC_BASELINE_SUBGROUPS;
+	spc->xbar_ucl = spc->xbar_center + A2[c] * rbar;
+	spc->xbar_lcl = spc->xbar_center - A2[c] * rbar;
+	spc->range_center = rbar;
+	spc->range_ucl = D4[c] * rbar;
+	spc->range_lcl = D3[c] * rbar;
+	if(spc->sigma == 0)
+	    spc->sigma = rbar / d2[c];
+	return alarms;
+    }
+
+    if(spc->xbar > spc->xbar_ucl)
+	alarms |= SPC_ALARM_XBAR_HIGH;
+    else if(spc->xbar < spc->xbar_lcl)
+	alarms |= SPC_ALARM_XBAR_LOW;
+    if(spc->range > spc->range_ucl)
+	alarms |= SPC_ALARM_RANGE_HIGH;
+    else if(spc->range < spc->range_lcl)
+	alarms |= SPC_ALARM_RANGE_LOW;
+    return alarms;
+}
+
+/*
+    @brief Add a package weight
+
+    @param[in] spc Stage
+
+    @param[in] kgs Package weight in kg
+
+    @ret SPC_ALARM_ bits raised by this package
+*/
+uint16_t spc_push(Spc * spc, float kgs) {
+    uint16_t alarms = SPC_ALARM_NONE;
+    if(isnan(kgs))
+	return alarms;
+
+    spc->packages++;
+    if(kgs < spc->lower_limit) {
+	spc->underfills++;
+	alarms |= SPC_ALARM_UNDERFILL;
+    }
+
+    if(spc->sub_cnt == 0) {
+	spc->sub_sum = 0;
+	spc->sub_min = kgs;
+	spc->sub_max = kgs;
+    }
+    spc->sub_sum += kgs;
+    if(kgs < spc->sub_min)
+	spc->sub_min = kgs;
+    if(kgs > spc->sub_max)
+	spc->sub_max = kgs;
+    if(++spc->sub_cnt == spc->subgroup_size)
+	alarms |= close_subgroup(spc);
+
+    if(spc->sigma == 0)
+	return alarms;
+
+    // tabular cusum, restarts after an alarm
+    float k = SPC_CUSUM_K * spc->sigma;
+    float h = SPC_CUSUM_H * spc->sigma;
+    spc->cusum_high = fmaxf(0, spc->cusum_high + kgs - spc->target - k);
+    spc->cusum_low = fmaxf(0, spc->cusum_low + spc->target - k - kgs);
+    if(spc->cusum_high > h) {
+	alarms |= SPC_ALARM_CUSUM_HIGH;
+	spc->cusum_high = 0;
+    }
+    if(spc->cusum_low > h) {
+	alarms |= SPC_ALARM_CUSUM_LOW;
+	spc->cusum_low = 0;
+    }
+
+    // ewma, the limits start narrow and widen to the steady state width
+    spc->ewma += SPC_EWMA_LAMBDA * (kgs - spc->ewma);
+    spc->ewma_decay *= (1 - SPC_EWMA_LAMBDA) * (1 - SPC_EWMA_LAMBDA);
+    float limit = SPC_EWMA_L * spc->sigma *
+	sqrtf(SPC_EWMA_LAMBDA / (2 - SPC_EWMA_LAMBDA) * (1 - spc->ewma_decay));
+    if(spc->ewma > spc->target + limit)
+	alarms |= SPC_ALARM_EWMA_HIGH;
+    else if(spc->ewma < spc->target - limit)
+	alarms |= SPC_ALARM_EWMA_LOW;
+    return alarms;
+}
+
+/*
+    @brief Function for reading the underfill rate
+
+    @param[in] spc Stage
+
+    @ret Fraction of packages below the lower limit, 0 before the first package
+*/
+float spc_underfill_rate(const Spc * spc) {
+    return spc->packages ? (float)spc->underfills / spc->packages : 0;
+}
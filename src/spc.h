@@ -0,0 +1,139 @@
+/* ****************************************************************************/
+/** Statistical Process Control Library 
+
+  @File Name
+    spc.h
+
+  @Summary
+    Control charts and alarms for filled package weights
+
+  @Description
+    Defines an incremental SPC stage that takes one weight per package, e.g. from a
+    checkweigher. It keeps X-bar/R charts over rational subgroups, a tabular CUSUM and an
+    EWMA chart against the target fill, and counts packages under the lower tolerance
+    limit. The chart limits are learned from the first subgroups, then every package is
+    checked in O(1) with a handful of float operations.
+******************************************************************************/
+
+#ifndef SPC_H
+#define SPC_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPC_MIN_SUBGROUP 2
+#define SPC_MAX_SUBGROUP 10 // range of subgroup sizes in the control chart constant table
+#define SPC_BASELINE_SUBGROUPS 20 // subgroups used to set the X-bar/R limits
+#define SPC_CUSUM_K 0.5f // cusum reference value in sigma, detects a 1 sigma shift
+#define SPC_CUSUM_H 5.0f // cusum decision interval in sigma
+#define SPC_EWMA_LAMBDA 0.2f // ewma weight of each package
+#define SPC_EWMA_L 3.0f // ewma limit width in sigma of the ewma
+
+// alarm bits
+#define SPC_ALARM_NONE 0x0000
+#define SPC_ALARM_XBAR_HIGH 0x0001 // subgroup mean above the upper control limit
+#define SPC_ALARM_XBAR_LOW 0x0002 // subgroup mean below the lower control limit
+#define SPC_ALARM_RANGE_HIGH 0x0004 // subgroup range above its upper control limit
+#define SPC_ALARM_RANGE_LOW 0x0008 // subgroup range below its lower control limit
+#define SPC_ALARM_CUSUM_HIGH 0x0010 // sustained shift above target
+#define SPC_ALARM_CUSUM_LOW 0x0020 // sustained shift below target
+#define SPC_ALARM_EWMA_HIGH 0x0040
+#define SPC_ALARM_EWMA_LOW 0x0080
+#define SPC_ALARM_UNDERFILL 0x0100 // package under the lower tolerance limit
+
+// spc stage state
+typedef struct {
+    // configuration
+    float target; // target fill, kg
+    float lower_limit; // packages below this are underfilled, kg
+    float sigma; // process standard deviation, kg, 0 until known
+    uint8_t subgroup_size;
+
+    // current subgroup
+    float sub_sum;
+    float sub_min;
+    float sub_max;
+    uint8_t sub_cnt;
+
+    // X-bar/R charts, limits are valid once baseline_cnt reaches SPC_BASELINE_SUBGROUPS
+    float xbar; // last subgroup mean
+    float range; // last subgroup range
+    float xbar_sum; // baseline sums
+    float range_sum;
+    uint8_t baseline_cnt;
+    float xbar_center, xbar_ucl, xbar_lcl;
+    float range_center, range_ucl, range_lcl;
+
+    // cusum and ewma against the target, run once sigma is known
+    float cusum_high;
+    float cusum_low;
+    float ewma;
+    float ewma_decay; // (1 - lambda)^(2i), narrows the ewma limits to steady state
+
+    // underfill tracking
+    uint32_t packages;
+    uint32_t underfills;
+}Spc;
+
+/*
+    @brief Initialize an spc stage
+
+    @param[out] spc Stage to initialize
+
+    @param[in] target Target fill in kg, the center line for cusum and ewma
+
+    @param[in] lower_limit Lower tolerance limit in kg, e.g. nominal minus the tolerable
+	negative error
+
+    @param[in] subgroup_size Packages per X-bar/R subgroup (SPC_MIN_SUBGROUP to SPC_MAX_SUBGROUP)
+
+    @param[in] sigma Process standard deviation in kg if known, 0 to estimate it from the
+	baseline ranges
+
+    @ret true if initialized, false if the subgroup size is out of range
+*/
+bool spc_init(Spc * spc, float target, float lower_limit, uint8_t subgroup_size, float sigma);
+
+/*
+    @brief Add a package weight
+
+    @note X-bar/R alarms can only be raised on the package that completes a subgroup after
+	the baseline. A cusum restarts after it alarms, so a sustained shift alarms again
+	every few packages until it's corrected. NAN weights are ignored.
+
+    @param[in] spc Stage
+
+    @param[in] kgs Package weight in kg
+
+    @ret SPC_ALARM_ bits raised by this package
+*/
+uint16_t spc_push(Spc * spc, float kgs);
+
+/*
+    @brief Function for reading the underfill rate
+
+    @param[in] spc Stage
+
+    @ret Fraction of packages below the lower limit, 0 before the first package
+*/
+float spc_underfill_rate(const Spc * spc);
+
+/*
+    @brief Start a new lot
+
+    @note Keeps the learned chart limits and sigma, clears the partial subgroup, the cusum,
+	the ewma and the underfill counts
+
+    @param[in] spc Stage
+*/
+void spc_reset(Spc * spc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPC_H
@@ -0,0 +1,209 @@
+/* ****************************************************************************/
+/** Streaming Statistics Library 
+
+  @File Name
+    stats.c
+
+  @Summary
+    Running mean, variance, min/max and percentiles of a sample stream
+
+  @Description
+    Implements Welford's running mean and variance and the P-square percentile estimator
+    (Jain and Chlamtac), both O(1) per sample with no sample storage
+******************************************************************************/
+
+#include "stats.h"
+#include <math.h>
+#include <stddef.h>
+
+_Static_assert(STATS_MAX_QUANTILES <= UINT8_MAX, "STATS_MAX_QUANTILES has to fit quantile_cnt, a uint8_t");
+
+/*
+    @brief Initialize an accumulator with no percentiles
+
+    @param[out] st Accumulator to initialize
+*/
+void stats_init(Stats * st) {
+    st->quantile_cnt = 0;
+    stats_reset(st);
+}
+
+/*
+    @brief Restart a percentile estimator
+
+    @param[in] q Estimator
+*/
+static void quantile_reset(StatsQuantile * q) {
+    float p = q->p;
+    for(uint8_t i = 0; i < STATS_MARKERS; i++) {
+	q->height[i] = 0;
+	q->pos[i] = i;
+    }
+    q->desired[0] = 0;
+    q->desired[1] = 2 * p;
+    q->desired[2] = 4 * p;
+    q->desired[3] = 2 + 2 * p;
+    q->desired[4] = 4;
+}
+
+/*
+    @brief Track a percentile
+
+    @param[in] st Accumulator
+
+    @param[in] p Percentile as a fraction, between 0 and 1 exclusive
+
+    @ret true if added, false if the accumulator is full or p is out of range
+*/
+bool stats_add_quantile(Stats * st, float p) {
+    if(st->quantile_cnt >= STATS_MAX_QUANTILES || !(p > 0 && p < 1))
+	return false;
+    StatsQuantile * q = &st->quantiles[st->quantile_cnt++];
+    q->p = p;
+    quantile_reset(q);
+    return true;
+}
+
+/*
+    @brief Clear the samples for a new batch, keeping the tracked percentiles
+
+    @param[in] st Accumulator
+*/
+void stats_reset(Stats * st) {
+    st->count = 0;
+    st->mean = 0;
+    st->m2 = 0;
+    st->min = INFINITY;
+    st->max = -INFINITY;
+    for(uint8_t i = 0; i < st->quantile_cnt; i++)
+	quantile_reset(&st->quantiles[i]);
+}
+
+/*
+    @brief Add a sample to a percentile estimator
+
+    @note The first 5 samples are kept sorted as the markers. After that each sample moves the
+	markers above it up one position, and a middle marker that is a position or more off
+	its desired position is moved one step, along a parabola through its neighbours or in
+	a straight line if the parabola would pass them.
+
+    @param[in] q Estimator
+
+    @param[in] x Sample
+
+    @param[in] count Samples before this one
+*/
+static void quantile_push(StatsQuantile * q, float x, uint32_t count) {
+    int8_t k;
+    if(count < STATS_MARKERS) {
+	// insertion sort into the markers
+	for(k = count; k > 0 && q->height[k - 1] > x; k--)
+	    q->height[k] = q->height[k - 1];
+	q->height[k] = x;
+	return;
+    }
+
+    // cell the sample falls in, the end markers track the min and max
+    if(x < q->height[0]) {
+	q->height[0] = x;
+	k = 0;
+    }
+    else if(x >= q->height[4]) {
+	q->height[4] = x;
+	k = 3;
+    }
+    else {
+	for(k = 0; x >= q->height[k + 1]; k++)
+	    ;
+    }
+    for(uint8_t i = k + 1; i < STATS_MARKERS; i++)
+	q->pos[i]++;
+    q->desired[1] += q->p / 2;
+    q->desired[2] += q->p;
+    q->desired[3] += (1 + q->p) / 2;
+    q->desired[4] += 1;
+
+    for(uint8_t i = 1; i < STATS_MARKERS - 1; i++) {
+	float d = q->desired[i] - q->pos[i];
+	if((d >= 1 && q->pos[i + 1] - q->pos[i] > 1) || (d <= -1 && q->pos[i - 1] - q->pos[i] < -1)) {
+	    int8_t s = d > 0 ? 1 : -1;
+	    float h = q->height[i];
+	    float below = q->pos[i] - q->pos[i - 1];
+	    float above = q->pos[i + 1] - q->pos[i];
+	    float parabolic = h + s / (float)(q->pos[i + 1] - q->pos[i - 1]) *
+		((below + s) * (q->height[i + 1] - h) / above + (above - s) * (h - q->height[i - 1]) / below);
+	    if(q->height[i - 1] < parabolic && parabolic < q->height[i + 1])
+		q->height[i] = parabolic;
+	    else
+		q->height[i] = h + s * (q->height[i + s] - h) / (q->pos[i + s] - q->pos[i]);
+	    q->pos[i] += s;
+	}
+    }
+}
+
+/*
+    @brief Add a sample
+
+    @param[in] st Accumulator
+
+    @param[in] x Sample
+*/
+void stats_push(Stats * st, float x) {
+    if(isnan(x))
+	return;
+    for(uint8_t i = 0; i < st->quantile_cnt; i++)
+	quantile_push(&st->quantiles[i], x, st->count);
+    st->count++;
+    double delta = x - st->mean;
+    st->mean += delta / st->count;
+    st->m2 += delta * (x - st->mean);
+    if(x < st->min)
+	st->min = x;
+    if(x > st->max)
+	st->max = x;
+}
+
+/*
+    @brief Function for reading the sample variance
+
+    @param[in] st Accumulator
+
+    @ret Variance with n - 1 in the denominator, 0 with fewer than 2 samples
+*/
+float stats_variance(const Stats * st) {
+    return st->count > 1 ? (float)(st->m2 / (st->count - 1)) : 0;
+}
+
+/*
+    @brief Function for reading the standard deviation
+
+    @param[in] st Accumulator
+
+    @ret Sample standard deviation
+*/
+float stats_stddev(const Stats * st) {
+    return sqrtf(stats_variance(st));
+}
+
+/*
+    @brief Function for reading a percentile estimate
+
+    @param[in] st Accumulator
+
+    @param[in] p Percentile passed to stats_add_quantile()
+
+    @ret Estimate, NAN if p isn't tracked or there are no samples
+*/
+float stats_quantile(const Stats * st, float p) {
+    if(st->count == 0)
+	return NAN;
+    for(uint8_t i = 0; i < st->quantile_cnt; i++) {
+	const StatsQuantile * q = &st->quantiles[i];
+	if(q->p != p)
+	    continue;
+	if(st->count <= STATS_MARKERS) // still the sorted samples
+	    return q->height[(uint8_t)lroundf(p * (st->count - 1))];
+	return q->height[2];
+    }
+    return NAN;
+}
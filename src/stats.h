@@ -0,0 +1,124 @@
+/* ****************************************************************************/
+/** Streaming Statistics Library 
+
+  @File Name
+    stats.h
+
+  @Summary
+    Running mean, variance, min/max and percentiles of a sample stream
+
+  @Description
+    Defines a statistics accumulator updated in O(1) per sample with fixed memory: Welford's
+    algorithm for the mean and variance, and the P-square estimator for percentiles, which
+    tracks each percentile with five markers instead of keeping the samples. One accumulator
+    per channel, reset it at the start of each batch or lot.
+******************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef STATS_MAX_QUANTILES
+#define STATS_MAX_QUANTILES 4 // percentiles tracked per accumulator
+#endif
+#define STATS_MARKERS 5 // P-square markers per percentile
+
+// P-square estimator for one percentile
+typedef struct {
+    float p; // percentile as a fraction, e.g. 0.95
+    float height[STATS_MARKERS]; // marker heights, height[2] is the estimate
+    int32_t pos[STATS_MARKERS]; // actual marker positions
+    float desired[STATS_MARKERS]; // desired marker positions
+}StatsQuantile;
+
+// statistics of a sample stream
+typedef struct {
+    double mean; // double, in float a long run of heavy readings loses the small spread
+    double m2; // sum of squared differences from the mean
+    uint32_t count;
+    float min;
+    float max;
+    StatsQuantile quantiles[STATS_MAX_QUANTILES];
+    uint8_t quantile_cnt;
+}Stats;
+
+/*
+    @brief Initialize an accumulator with no percentiles
+
+    @param[out] st Accumulator to initialize
+*/
+void stats_init(Stats * st);
+
+/*
+    @brief Track a percentile
+
+    @note Add the percentiles before pushing samples, the estimate needs the whole stream
+
+    @param[in] st Accumulator
+
+    @param[in] p Percentile as a fraction, between 0 and 1 exclusive
+
+    @ret true if added, false if the accumulator is full or p is out of range
+*/
+bool stats_add_quantile(Stats * st, float p);
+
+/*
+    @brief Clear the samples for a new batch, keeping the tracked percentiles
+
+    @param[in] st Accumulator
+*/
+void stats_reset(Stats * st);
+
+/*
+    @brief Add a sample
+
+    @note NAN samples (faulted readings) are ignored
+
+    @param[in] st Accumulator
+
+    @param[in] x Sample
+*/
+void stats_push(Stats * st, float x);
+
+/*
+    @brief Function for reading the sample variance
+
+    @param[in] st Accumulator
+
+    @ret Variance with n - 1 in the denominator, 0 with fewer than 2 samples
+*/
+float stats_variance(const Stats * st);
+
+/*
+    @brief Function for reading the standard deviation
+
+    @param[in] st Accumulator
+
+    @ret Sample standard deviation
+*/
+float stats_stddev(const Stats * st);
+
+/*
+    @brief Function for reading a percentile estimate
+
+    @note Exact while there are 5 samples or fewer
+
+    @param[in] st Accumulator
+
+    @param[in] p Percentile passed to stats_add_quantile()
+
+    @ret Estimate, NAN if p isn't tracked or there are no samples
+*/
+float stats_quantile(const Stats * st, float p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATS_H
@@ -14,132 +14,1423 @@
 #include "strain_gauge.h"
 #include "hx711_adc.h"
 #include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
 #include "nrf_delay.h" // nordic sdk specific delay
 
 #define delay_ms(time) nrf_delay_ms(time) // macro to redirect to SDK specific delay function
+#define delay_us(time) nrf_delay_us(time) // macro to redirect to SDK specific delay function
+#define memory_barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST) // keeps the calibration swap ordered
+#define compare_and_swap(ptr, expected, desired) \
+    __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+// how much of the calibration convert_kgs() applies
+#define CONVERT_RAW 0 // load cell specifications only, used while calibrating
+#define CONVERT_UNTARED 1 // plus the line of best fit, used while taring
+#define CONVERT_FULL 2 // plus the tare offset
 
 //#define DEBUG_OUTPUT // comment this line to turn off prints
 
-StrainGauge sg; // strain gauge instance
+StrainGauge sg; // strain gauge instance
+
+// hx711 through the hx711f driver, AVDD is the excitation so the input range is +-0.5*VE/gain
+const StrainGaugeBackend hx711_backend = {
+    .name = "hx711",
+    .is_ready = adc_is_ready,
+    .read_raw = adc_read,
+    .sample_rate = 10,
+    .resolution_bits = 24,
+    .full_scale = 0.5f,
+    .gain = 128,
+};
+static const StrainGaugeBackend * backend = &hx711_backend; // adc front end in use
+static uint16_t stable_samples = 8; // SG_PARAM_STABLE_TIME_MS at the backend's sample rate
+
+// parameter table, indexed by sg_param_id_t
+static const SgParamInfo param_info[SG_PARAM_COUNT] = {
+    [SG_PARAM_TARE_SAMPLES] = {"tare_samples", SG_PARAM_TYPE_U32, {.u32 = 1}, {.u32 = UINT8_MAX}, {.u32 = 15}},
+    [SG_PARAM_CAL_SAMPLES] = {"cal_samples", SG_PARAM_TYPE_U32, {.u32 = 1}, {.u32 = UINT8_MAX}, {.u32 = 20}},
+    [SG_PARAM_CAL_SETTLE_MS] = {"cal_settle_ms", SG_PARAM_TYPE_U32, {.u32 = 0}, {.u32 = 600000}, {.u32 = 15000}},
+    [SG_PARAM_SAMPLE_TIMEOUT_MS] = {"sample_timeout_ms", SG_PARAM_TYPE_U32, {.u32 = 1}, {.u32 = 60000}, {.u32 = SG_DEFAULT_TIMEOUT_MS}},
+    [SG_PARAM_STABLE_BAND] = {"stable_band", SG_PARAM_TYPE_FLOAT, {.f = 0}, {.f = 1000}, {.f = SG_STABLE_BAND}},
+    [SG_PARAM_STABLE_TIME_MS] = {"stable_time_ms", SG_PARAM_TYPE_U32, {.u32 = 1}, {.u32 = 60000}, {.u32 = SG_STABLE_TIME_MS}},
+    [SG_PARAM_OVERLOAD] = {"overload", SG_PARAM_TYPE_FLOAT, {.f = 0}, {.f = 100000}, {.f = 0}},
+    [SG_PARAM_FILTER] = {"filter", SG_PARAM_TYPE_U32, {.u32 = SG_FILTER_NONE}, {.u32 = SG_FILTER_OVERSAMPLE}, {.u32 = SG_FILTER_NONE}},
+    [SG_PARAM_FILTER_LENGTH] = {"filter_length", SG_PARAM_TYPE_U32, {.u32 = 1}, {.u32 = UINT8_MAX}, {.u32 = 1}},
+    [SG_PARAM_UNITS] = {"units", SG_PARAM_TYPE_U32, {.u32 = SG_UNITS_KG}, {.u32 = SG_UNITS_G}, {.u32 = SG_UNITS_KG}},
+    [SG_PARAM_DIVISION] = {"division", SG_PARAM_TYPE_FLOAT, {.f = 0}, {.f = 1000}, {.f = 0}},
+    [SG_PARAM_OVERSAMPLE_BITS] = {"oversample_bits", SG_PARAM_TYPE_U32, {.u32 = 0}, {.u32 = SG_READ_MAX_OVERSAMPLE_BITS}, {.u32 = 2}},
+};
+static sg_param_value_t params[SG_PARAM_COUNT]; // set from the defaults by strain_gauge_init()
+
+extern bool read_sg; // read strain gauge flag, set on interrupt in main.c, used in read_average() to prevent timing issues
+
+// calibration, double buffered. Readers use cal_slots[cal_active]. Writers fill the other slot
+// and then flip cal_active with one store, so a change is never seen half done. cal_seq is odd
+// while a slot is being written, so a reader that was preempted across two updates retries.
+static CalibrationSet cal_slots[2];
+static volatile uint8_t cal_active = 0;
+static volatile uint32_t cal_seq[2];
+
+static void (*wait_hook)(void) = NULL; // called while waiting for a sample, e.g. to feed a watchdog
+static uint32_t (*clock_ms)(void) = NULL; // ms since power on, set by the application
+
+#if SG_USE_THRESHOLDS
+// weight threshold, the table is sorted by level
+typedef struct {
+    float level; // kg
+    float hysteresis; // kg
+    sg_event_handler_t handler;
+    void * context;
+    int8_t id;
+    bool above; // weight has reached level and hasn't fallen below level - hysteresis since
+}Threshold;
+#endif
+
+// state change subscriber
+typedef struct {
+    uint32_t mask; // SG_EVENT_MASK() bits
+    sg_event_handler_t handler;
+    void * context;
+}Listener;
+
+// event state
+#if SG_USE_THRESHOLDS
+static Threshold thresholds[SG_MAX_THRESHOLDS];
+static uint8_t threshold_cnt = 0;
+static int8_t next_threshold_id = 0;
+static float max_hysteresis = 0; // widest hysteresis in the table, bounds the search window
+_Static_assert(SG_MAX_THRESHOLDS <= UINT8_MAX, "SG_MAX_THRESHOLDS has to fit threshold_cnt, a uint8_t");
+#endif
+static Listener listeners[SG_MAX_LISTENERS];
+static uint8_t listener_cnt = 0;
+_Static_assert(SG_MAX_LISTENERS <= UINT8_MAX, "SG_MAX_LISTENERS has to fit listener_cnt, a uint8_t");
+static float last_weight = NAN; // previous calibrated weight
+static float stable_avg = 0; // running average used for stability detection
+static uint16_t stable_cnt = 0; // consecutive readings inside SG_PARAM_STABLE_BAND
+static bool stable = false;
+static bool overloaded = false;
+static uint8_t last_faults = SG_FAULT_NONE;
+#if SG_USE_MULTIRATE
+static Multirate * multirate = NULL; // fan out stage fed with every sample
+#endif
+#if SG_USE_STATS
+static Stats * stats = NULL; // statistics of the weights read
+#endif
+#if SG_USE_AUDIT_LOG
+static AuditLog * audit_log = NULL; // calibration and configuration changes are appended here
+#endif
+#if SG_USE_MOTION_COMP
+static MotionComp * motion = NULL; // removes inertial forces from each conversion
+#endif
+
+// startup
+static bool valid = false; // startup finished
+static uint32_t boot_latency_ms = 0;
+
+// warm-up drift compensation
+#if SG_USE_WARMUP
+static WarmupModel warmup;
+static bool warmup_enabled = false;
+#endif
+
+// calibration workspace, only used in calibrating mode so one calibration owns it at a time
+static float cal_x[SG_MAX_CAL_POINTS + 1]; // measured averages
+static float cal_y[SG_MAX_CAL_POINTS + 1]; // known weights
+static bool cal_session = false; // step by step calibration running, it owns calibrating mode
+static uint8_t cal_points = 0; // points captured in the session
+_Static_assert(SG_MAX_CAL_POINTS > 0 && SG_MAX_CAL_POINTS < UINT8_MAX,
+	"SG_MAX_CAL_POINTS + 1 has to fit cal_points, a uint8_t");
+
+#if SG_USE_RAW_RING
+// raw sample ring, the isr only moves raw_head and the reader only moves raw_tail.
+// Both run freely and wrap, the difference is the fill level.
+static int32_t raw_ring[SG_RAW_RING_SIZE];
+static volatile uint32_t raw_head = 0;
+static volatile uint32_t raw_tail = 0;
+static volatile uint32_t raw_overruns = 0;
+_Static_assert(SG_RAW_RING_SIZE > 0 && (SG_RAW_RING_SIZE & (SG_RAW_RING_SIZE - 1)) == 0,
+	"SG_RAW_RING_SIZE has to be a power of 2, the indexes wrap with a mask");
+#endif
+
+// bridge diagnostics state
+static float diag_last = 0; // previous sense voltage
+static float diag_diff = 0; // previous sample to sample difference
+static uint8_t diag_noisy_cnt = 0; // consecutive large reversals
+static uint8_t diag_rail_cnt = 0; // consecutive readings at a rail
+static uint8_t diag_stuck_cnt = 0; // consecutive identical readings
+
+/*
+    @brief Start a calibration update
+
+    @note Only one writer at a time, calibration changes should all come from the same task
+
+    @ret The inactive slot, holding a copy of the active calibration to modify
+*/
+static CalibrationSet * calibration_begin(void) {
+    uint8_t next = cal_active ^ 1;
+    cal_seq[next]++; // odd, writing
+    memory_barrier();
+    cal_slots[next] = cal_slots[cal_active];
+    return &cal_slots[next];
+}
+
+/*
+    @brief Publish a calibration update
+
+    @param[in] cal Slot returned by calibration_begin()
+*/
+static void calibration_commit(CalibrationSet * cal) {
+    uint8_t next = cal - cal_slots;
+    cal->version = cal_slots[cal_active].version + 1;
+    memory_barrier();
+    cal_seq[next]++; // even, done
+    memory_barrier();
+    cal_active = next;
+}
+
+/*
+    @brief Take a consistent copy of the active calibration
+
+    @note An isr can't be preempted by the writer, so it always gets it on the first try
+
+    @param[out] cal Copy of the active calibration
+*/
+static void calibration_snapshot(CalibrationSet * cal) {
+    uint8_t idx;
+    uint32_t seq;
+    do {
+	idx = cal_active;
+	seq = cal_seq[idx];
+	memory_barrier();
+	*cal = cal_slots[idx];
+	memory_barrier();
+    } while((seq & 1) || seq != cal_seq[idx]);
+}
+
+/*
+    @brief Strain Gauge Initialization
+
+    @note Sets specifications used for calculating kgs
+
+    @param[in] ve Excitation / Power Supply Voltage (usually 5V)
+
+    @param[in] capacity Load Cell capacity (3kg, 10kg, 50kg, etc.)
+
+    @param[in] ro Rated Output in mV/V
+*/
+void strain_gauge_init(float ve, uint16_t capacity, float ro) {
+    sg.capacity = capacity;
+    sg.VE = ve;
+    sg.RO = ro;
+    CalibrationSet * cal = calibration_begin();
+    cal->scale = capacity/(ve*ro);
+    cal->gravity = 1;
+    cal->offset = 0;
+    calibration_commit(cal);
+    sg.faults = SG_FAULT_NONE;
+    sg.mode = SG_MODE_IDLE;
+    strain_gauge_param_defaults();
+}
+
+/*
+    @brief Calculate the adc input range
+
+    @ret Positive full scale in mV
+*/
+static float full_scale_mv(void) {
+    return 1000.0f * backend->full_scale * sg.VE / backend->gain;
+}
+
+/*
+    @brief Limit the oversampling so the decimated count fits an int32_t
+
+    @param[in] extra_bits Bits of resolution asked for
+
+    @ret Bits of resolution that can be used with this backend
+*/
+static uint8_t oversample_limit(uint8_t extra_bits) {
+    // counts run from -2^(resolution_bits - 1) to 2^(resolution_bits - 1) - 1, so the decimated
+    // count needs resolution_bits + extra_bits bits including the sign
+    uint8_t limit = 32 - backend->resolution_bits;
+    if(limit > SG_MAX_OVERSAMPLE_BITS)
+	limit = SG_MAX_OVERSAMPLE_BITS;
+    return extra_bits > limit ? limit : extra_bits;
+}
+
+/*
+    @brief Convert a raw adc count to the sense voltage
+
+    @note Uses the backend's input range, a fraction of VE for ratiometric wiring
+
+    @param[in] counts Raw or decimated adc count
+
+    @param[in] extra_bits Extra bits of resolution carried by counts
+
+    @ret Sense voltage in mV, NAN for SG_RAW_INVALID
+*/
+static float counts_to_mv(int32_t counts, uint8_t extra_bits) {
+    if(counts == SG_RAW_INVALID)
+	return NAN;
+    return ldexpf((float)counts, 1 - backend->resolution_bits - extra_bits) * full_scale_mv();
+}
+
+/*
+    @brief Calculate the warm-up drift left in the current conversion
+
+    @note Time since power on comes from the clock, so it's right however the conversions
+	were read and however long the gaps between reads were
+
+    @ret Drift in mV, 0 once the model has settled, without a model or without a clock
+*/
+static float warmup_drift_mv(void) {
+#if SG_USE_WARMUP
+    if(!warmup_enabled || clock_ms == NULL)
+	return 0;
+    float drift = warmup_model_drift(&warmup, clock_ms() / 1000.0f);
+    if(drift == 0)
+	warmup_enabled = false; // settled, skip the model from now on
+    return ldexpf(drift, 1 - backend->resolution_bits) * full_scale_mv();
+#else
+    return 0;
+#endif
+}
+
+/*
+    @brief Check a sample for bridge faults
+
+    @note Cheap enough to run on every sample: a couple of compares and one running average.
+	Sets sg.faults, a fault clears once the samples look healthy again.
+
+    @param[in] sense_voltage Measured voltage in mV, NAN if the backend failed to read it
+
+    @ret SG_FAULT_ bits for this sample
+*/
+static uint8_t diagnose_sample(float sense_voltage) {
+    if(isnan(sense_voltage)) {
+	// nothing was read, leave the running checks as they were
+	sg.faults = SG_FAULT_READ;
+	return SG_FAULT_READ;
+    }
+    float full_scale = full_scale_mv();
+    float rail = SG_DIAG_RAIL_LEVEL * full_scale;
+    float diff = sense_voltage - diag_last;
+    uint8_t faults = SG_FAULT_NONE;
+
+    // saturation, a broken signal wire lets the input float to a rail
+    if(sense_voltage >= rail || sense_voltage <= -rail) {
+	if(diag_rail_cnt < SG_DIAG_RAIL_COUNT)
+	    diag_rail_cnt++;
+    }
+    else
+	diag_rail_cnt = 0;
+    if(diag_rail_cnt >= SG_DIAG_RAIL_COUNT)
+	faults |= sense_voltage > 0 ? SG_FAULT_RAIL_HIGH : SG_FAULT_RAIL_LOW;
+
+    // a live bridge adc always has a few counts of noise, identical readings mean it stopped converting
+    if(diff == 0) {
+	if(diag_stuck_cnt < SG_DIAG_STUCK_COUNT)
+	    diag_stuck_cnt++;
+    }
+    else
+	diag_stuck_cnt = 0;
+    if(diag_stuck_cnt >= SG_DIAG_STUCK_COUNT)
+	faults |= SG_FAULT_STUCK;
+
+    // noise, only reversals count (up then down or down then up) so load steps and ramps
+    // don't trip it, the smaller of the two differences is the size of the reversal
+    float reversal = 0;
+    if(diff * diag_diff < 0)
+	reversal = fabsf(diff) < fabsf(diag_diff) ? fabsf(diff) : fabsf(diag_diff);
+    if(reversal > SG_DIAG_NOISE_LEVEL * full_scale) {
+	if(diag_noisy_cnt < SG_DIAG_NOISY_COUNT)
+	    diag_noisy_cnt++;
+    }
+    else
+	diag_noisy_cnt = 0;
+    diag_diff = diff;
+    if(diag_noisy_cnt >= SG_DIAG_NOISY_COUNT)
+	faults |= SG_FAULT_NOISY;
+
+    diag_last = sense_voltage;
+    sg.faults = faults;
+#ifdef DEBUG_OUTPUT
+    if(faults != SG_FAULT_NONE)
+	printf("bridge fault: 0x%02x\n", faults);
+#endif
+    return faults;
+}
+
+/*
+    @brief Wait for a sample to be ready
+
+    @note Polls instead of spinning on the flags so the deadline can be counted with the delay
+	function, no timer is needed. The budget is shared by all the samples of one call.
+
+    @param[in] wait_timer Wait for the read_sg timer flag as well as the amplifier
+
+    @param[in,out] budget_us Time left before the deadline, decremented while waiting
+
+    @ret SG_OK when a conversion is ready, SG_ERR_TIMEOUT if the budget ran out
+*/
+static sg_status_t wait_sample(bool wait_timer, uint32_t * budget_us) {
+    while((wait_timer && !read_sg) || !backend->is_ready()) {
+	if(*budget_us < SG_WAIT_POLL_US) {
+	    sg.faults |= SG_FAULT_TIMEOUT;
+#ifdef DEBUG_OUTPUT
+	    printf("sample timeout\n");
+#endif
+	    return SG_ERR_TIMEOUT;
+	}
+	delay_us(SG_WAIT_POLL_US);
+	*budget_us -= SG_WAIT_POLL_US;
+	if(wait_hook)
+	    wait_hook();
+    }
+    return SG_OK;
+}
+
+/*
+    @brief Convert a timeout to a wait budget
+
+    @param[in] timeout_ms Timeout in ms
+
+    @ret Timeout in us, saturated at UINT32_MAX
+*/
+static uint32_t budget_us(uint32_t timeout_ms) {
+    return timeout_ms > UINT32_MAX / 1000 ? UINT32_MAX : timeout_ms * 1000;
+}
+
+/*
+    @brief Enter taring or calibrating mode
+
+    @note Fails if a tare or calibration already owns the driver, so two can't run at once
+
+    @param[in] to SG_MODE_TARING or SG_MODE_CALIBRATING
+
+    @ret true if the mode was entered
+*/
+static bool mode_enter(uint8_t to) {
+    uint8_t from = sg.mode;
+    do {
+	if(from == SG_MODE_TARING || from == SG_MODE_CALIBRATING)
+	    return false;
+    } while(!compare_and_swap(&sg.mode, &from, to));
+    return true;
+}
+
+/*
+    @brief Leave taring or calibrating mode
+
+    @param[in] from Mode entered with mode_enter()
+*/
+static void mode_exit(uint8_t from) {
+    uint8_t expected = from;
+    compare_and_swap(&sg.mode, &expected, sg.faults ? SG_MODE_FAULT : SG_MODE_MEASURING);
+}
+
+/*
+    @brief Track faults in the mode after a sample
+
+    @note Taring and calibrating are left alone, their owner leaves them
+
+    @param[in] faults SG_FAULT_ bits of the sample
+*/
+static void mode_sample(uint8_t faults) {
+    uint8_t from = sg.mode;
+    uint8_t to = faults ? SG_MODE_FAULT : SG_MODE_MEASURING;
+    while(from != to && from != SG_MODE_TARING && from != SG_MODE_CALIBRATING) {
+	if(compare_and_swap(&sg.mode, &from, to))
+	    break;
+    }
+}
+
+/*
+    @brief Convert a sense voltage to kilograms
+
+    @note Applies load cell specifications, line of best fit, and tare offset from one
+	calibration snapshot, so a concurrent update can't mix old and new factors
+
+    @param[in] sense_voltage Measured voltage in mV
+
+    @param[in] stage CONVERT_ stage, how much of the calibration to apply
+
+    @ret Kilogram measurement (float)
+*/
+static float convert_kgs(float sense_voltage, uint8_t stage) {
+    CalibrationSet cal;
+    calibration_snapshot(&cal);
+    float kilograms = sense_voltage*cal.scale;
+#ifdef DEBUG_OUTPUT
+    printf("kilograms: %f\n", kilograms);
+#endif	
+    
+    // if calibrating, we don't have a slope or intercept yet
+    if(stage == CONVERT_RAW)
+	return kilograms;
+
+    // manipulate kilograms based on best fit equation, the same line for either sign
+    kilograms = cal.slope * kilograms + cal.intercept;
+#if SG_USE_MOTION_COMP
+    // the cell carries the load, the container and the tare, correct all of it but not the
+    // bridge's electrical zero, which the intercept has already taken off
+    if(motion != NULL && clock_ms != NULL)
+	kilograms = motion_comp_apply(motion, kilograms, clock_ms());
+#endif
+    
+    // if we're taring, don't consider previous offset
+    if(stage == CONVERT_UNTARED)
+	return kilograms;
+    
+    // the offset is the untared reading at tare, whatever its sign
+    return kilograms - cal.offset;
+}
+
+/*
+    @brief Dispatch an event to the subscribers
+
+    @param[in] event Event that happened
+
+    @param[in] weight Weight that caused the event
+*/
+static void dispatch_event(sg_event_t event, float weight) {
+    for(uint8_t i = 0; i < listener_cnt; i++) {
+	if(listeners[i].mask & SG_EVENT_MASK(event))
+	    listeners[i].handler(event, weight, listeners[i].context);
+    }
+}
+
+/*
+    @brief Append a record to the attached audit log
+
+    @param[in] type AUDIT_ record type
+
+    @param[in] value0 First value
+
+    @param[in] value1 Second value
+*/
+static void audit(uint8_t type, float value0, float value1) {
+#if SG_USE_AUDIT_LOG
+    if(audit_log)
+	audit_log_append(audit_log, type, value0, value1);
+#else
+    (void)type;
+    (void)value0;
+    (void)value1;
+#endif
+}
+
+/*
+    @brief Check the audit log can take the records for a change, before making it
+
+    @note A change that can't be logged isn't made, so the log never misses one
+
+    @param[in] n Records the change appends
+
+    @ret true if there is room, or no log is attached
+*/
+static bool audit_room(uint16_t n) {
+#if SG_USE_AUDIT_LOG
+    return audit_log == NULL || audit_log_room(audit_log) >= n;
+#else
+    (void)n;
+    return true;
+#endif
+}
+
+#if SG_USE_THRESHOLDS
+/*
+    @brief Find the first threshold at or above a level
+
+    @param[in] level Weight in kg
+
+    @ret Index into the thresholds table, threshold_cnt if every level is below
+*/
+static uint8_t threshold_lower_bound(float level) {
+    uint8_t lo = 0, hi = threshold_cnt;
+    while(lo < hi) {
+	uint8_t mid = (lo + hi) / 2;
+	if(thresholds[mid].level < level)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+    @brief Check the thresholds for a new weight
+
+    @note A threshold can only change state if its level is between the previous and current
+	weight, or up to max_hysteresis above them for a falling edge, so only that slice of the
+	sorted table is visited.
+
+    @param[in] weight Calibrated weight in kg
+*/
+static void update_thresholds(float weight) {
+    if(isnan(last_weight)) {
+	// first sample, just set the threshold states
+	for(uint8_t i = 0; i < threshold_cnt; i++)
+	    thresholds[i].above = weight >= thresholds[i].level;
+	return;
+    }
+    float lo = weight < last_weight ? weight : last_weight;
+    float hi = (weight > last_weight ? weight : last_weight) + max_hysteresis;
+    for(uint8_t i = threshold_lower_bound(lo); i < threshold_cnt && thresholds[i].level <= hi; i++) {
+	Threshold * t = &thresholds[i];
+	if(!t->above && weight >= t->level) {
+	    t->above = true;
+	    t->handler(SG_EVENT_RISING, weight, t->context);
+	}
+	else if(t->above && weight < t->level - t->hysteresis) {
+	    t->above = false;
+	    t->handler(SG_EVENT_FALLING, weight, t->context);
+	}
+    }
+}
+#endif
+
+/*
+    @brief Run the event checks for a new sample
+
+    @param[in] weight Calibrated weight in kg, NAN if the sample was faulted
+*/
+static void process_events(float weight) {
+    if(sg.faults != last_faults) {
+	last_faults = sg.faults;
+	dispatch_event(SG_EVENT_FAULT, NAN);
+    }
+    if(isnan(weight))
+	return;
+#if SG_USE_STATS
+    if(stats)
+	stats_push(stats, weight);
+#endif
+
+#if SG_USE_THRESHOLDS
+    update_thresholds(weight);
+#endif
+    if(isnan(last_weight))
+	stable_avg = weight; // first sample
+    last_weight = weight;
+
+    // stability, readings have to stay near a running average, which restarts when they leave the band
+    float dev = weight - stable_avg;
+    float band = params[SG_PARAM_STABLE_BAND].f;
+    if(dev < band && dev > -band) {
+	stable_avg += dev / 8;
+	if(stable_cnt < stable_samples)
+	    stable_cnt++;
+    }
+    else {
+	stable_avg = weight;
+	stable_cnt = 0;
+    }
+    if(!stable && stable_cnt >= stable_samples) {
+	stable = true;
+	dispatch_event(SG_EVENT_STABLE, weight);
+    }
+    else if(stable && stable_cnt == 0) {
+	stable = false;
+	dispatch_event(SG_EVENT_UNSTABLE, weight);
+    }
+
+    float overload = params[SG_PARAM_OVERLOAD].f > 0 ? params[SG_PARAM_OVERLOAD].f : sg.capacity;
+    if(!overloaded && weight > overload) {
+	overloaded = true;
+	dispatch_event(SG_EVENT_OVERLOAD, weight);
+    }
+    else if(overloaded && weight <= overload)
+	overloaded = false;
+}
+
+/*
+    @brief Calculate local gravity from location
+
+    @param[in] latitude Latitude in degrees
+
+    @param[in] altitude Height above sea level in m
+
+    @ret Local gravity in m/s^2
+*/
+float strain_gauge_gravity(float latitude, float altitude) {
+    float phi = latitude * 0.017453293f; // degrees to radians
+    float s1 = sinf(phi);
+    float s2 = sinf(2 * phi);
+    return 9.780327f * (1 + 0.0053024f * s1 * s1 - 0.0000058f * s2 * s2) - 3.086e-6f * altitude;
+}
+
+/*
+    @brief Set the gravity correction for a relocated scale
+
+    @param[in] g_calibration Gravity where the scale was calibrated, m/s^2
+
+    @param[in] g_site Gravity where the scale is installed, m/s^2
+
+    @ret SG_OK, SG_ERR_INVALID for a g that isn't positive, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_set_gravity(float g_calibration, float g_site) {
+    if(!(g_calibration > 0) || !(g_site > 0) || !isfinite(g_calibration) || !isfinite(g_site))
+	return SG_ERR_INVALID;
+    if(!audit_room(1))
+	return SG_ERR_FULL;
+    float factor = g_calibration / g_site;
+    CalibrationSet * cal = calibration_begin();
+    cal->scale *= factor / cal->gravity; // swap the old correction for the new one, keep the rest
+    cal->gravity = factor;
+    calibration_commit(cal);
+    audit(AUDIT_GRAVITY, factor, 0);
+    return SG_OK;
+}
+
+/*
+    @brief Read and convert one sample without passing it on
+
+    @param[in] stage CONVERT_ stage, how much of the calibration to apply
+
+    @ret Kilogram measurement (float), NAN if a bridge fault is detected
+*/
+static float convert_sample(uint8_t stage) {
+    float sense_voltage = counts_to_mv(backend->read_raw(), 0); // measured voltage
+#ifdef DEBUG_OUTPUT
+    printf("measured voltage: %f\n", sense_voltage);
+#endif
+    float kilograms = NAN;
+    uint8_t faults = diagnose_sample(sense_voltage);
+    mode_sample(faults);
+    if(faults == SG_FAULT_NONE)
+	kilograms = convert_kgs(sense_voltage - warmup_drift_mv(), stage);
+    return kilograms;
+}
+
+/*
+    @brief Read and convert one sample
+
+    @note Taring and calibrating reads use this with their own stage instead of changing how
+	read_kgs() behaves for everyone else. Only fully converted weights go to the events.
+
+    @param[in] stage CONVERT_ stage, how much of the calibration to apply
+
+    @ret Kilogram measurement (float), NAN if a bridge fault is detected
+*/
+static float read_sample(uint8_t stage) {
+    float kilograms = convert_sample(stage);
+    if(stage == CONVERT_FULL) {
+#if SG_USE_MULTIRATE
+	if(multirate)
+	    multirate_push(multirate, kilograms); // one base rate conversion, oversampled reads aren't pushed
+#endif
+	process_events(kilograms);
+    }
+    return kilograms;
+}
+
+/*
+    @brief Work out how many samples the stability time is at the backend's sample rate
+*/
+static void update_stable_samples(void) {
+    float samples = ceilf(backend->sample_rate * params[SG_PARAM_STABLE_TIME_MS].u32 / 1000.0f);
+    stable_samples = samples < 2 ? 2 : samples > UINT16_MAX ? UINT16_MAX : (uint16_t)samples;
+    stable_cnt = 0;
+}
+
+/*
+    @brief Select the adc front end
+
+    @param[in] b Adc front end
+*/
+void strain_gauge_set_backend(const StrainGaugeBackend * b) {
+    if(b == NULL || b->sample_rate <= 0)
+	return;
+    backend = b;
+    update_stable_samples();
+}
+
+/*
+    @brief Function for reading the sample rate of the selected backend
+
+    @ret Conversions per second
+*/
+float strain_gauge_sample_rate(void) {
+    return backend->sample_rate;
+}
+
+/*
+    @brief Function for reading kilogram measurement from strain gauge
+
+    @note Calculates kilograms based on load cell specifications, line of best fit, and tare offset
+
+    @ret Current kilogram measurement (float), NAN if a bridge fault is detected or no conversion
+	arrived within SG_PARAM_SAMPLE_TIMEOUT_MS
+*/
+float read_kgs(void) {
+    float kgs = NAN;
+    read_kgs_timeout(params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32, &kgs);
+    return kgs;
+}
+
+/*
+    @brief Function for reading kilogram measurement with a deadline
+
+    @param[in] timeout_ms How long to wait for a conversion
+
+    @param[out] kgs Kilogram measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t read_kgs_timeout(uint32_t timeout_ms, float * kgs) {
+    uint32_t budget = budget_us(timeout_ms);
+    if(wait_sample(false, &budget) != SG_OK)
+	return SG_ERR_TIMEOUT;
+    float weight = read_sample(CONVERT_FULL);
+    if(isnan(weight))
+	return SG_ERR_FAULT;
+    *kgs = weight;
+    return SG_OK;
+}
+
+/*
+    @brief Set a hook called while waiting for a sample
+
+    @param[in] hook Function to call, NULL to disable
+*/
+void strain_gauge_set_wait_hook(void (*hook)(void)) {
+    wait_hook = hook;
+}
+
+/*
+    @brief Set the millisecond clock
+
+    @param[in] millis Function returning ms since power on, NULL for none
+*/
+void strain_gauge_set_clock(uint32_t (*millis)(void)) {
+    clock_ms = millis;
+}
+
+#if SG_USE_THRESHOLDS
+/*
+    @brief Register a weight threshold
+
+    @param[in] level Threshold weight in kg
+
+    @param[in] hysteresis Band below level the weight has to fall through to re-arm, in kg
+
+    @param[in] handler Called with SG_EVENT_RISING and SG_EVENT_FALLING
+
+    @param[in] context Passed to handler
+
+    @ret Threshold id, -1 if the table is full
+*/
+int8_t strain_gauge_add_threshold(float level, float hysteresis, sg_event_handler_t handler, void * context) {
+    if(threshold_cnt >= SG_MAX_THRESHOLDS || handler == NULL)
+	return -1;
+    if(hysteresis < 0)
+	hysteresis = -hysteresis;
+    // insert in level order
+    uint8_t pos = threshold_lower_bound(level);
+    for(uint8_t i = threshold_cnt; i > pos; i--)
+	thresholds[i] = thresholds[i-1];
+    thresholds[pos].level = level;
+    thresholds[pos].hysteresis = hysteresis;
+    thresholds[pos].handler = handler;
+    thresholds[pos].context = context;
+    thresholds[pos].id = next_threshold_id;
+    thresholds[pos].above = !isnan(last_weight) && last_weight >= level;
+    threshold_cnt++;
+    next_threshold_id = next_threshold_id == INT8_MAX ? 0 : next_threshold_id + 1;
+    if(hysteresis > max_hysteresis)
+	max_hysteresis = hysteresis;
+    return thresholds[pos].id;
+}
+
+/*
+    @brief Remove a weight threshold
+
+    @param[in] id Id returned by strain_gauge_add_threshold()
+
+    @ret true if the threshold was found and removed
+*/
+bool strain_gauge_remove_threshold(int8_t id) {
+    uint8_t i;
+    for(i = 0; i < threshold_cnt && thresholds[i].id != id; i++) {}
+    if(i == threshold_cnt)
+	return false;
+    threshold_cnt--;
+    for(; i < threshold_cnt; i++)
+	thresholds[i] = thresholds[i+1];
+    max_hysteresis = 0;
+    for(i = 0; i < threshold_cnt; i++) {
+	if(thresholds[i].hysteresis > max_hysteresis)
+	    max_hysteresis = thresholds[i].hysteresis;
+    }
+    return true;
+}
+
+#endif
+
+/*
+    @brief Subscribe to state change events
+
+    @param[in] event_mask SG_EVENT_MASK() bits of the events wanted
+
+    @param[in] handler Called for each event in the mask
+
+    @param[in] context Passed to handler
+
+    @ret true if subscribed, false if the table is full
+*/
+bool strain_gauge_subscribe(uint32_t event_mask, sg_event_handler_t handler, void * context) {
+    if(listener_cnt >= SG_MAX_LISTENERS || handler == NULL)
+	return false;
+    listeners[listener_cnt].mask = event_mask;
+    listeners[listener_cnt].handler = handler;
+    listeners[listener_cnt].context = context;
+    listener_cnt++;
+    return true;
+}
+
+#if SG_USE_MULTIRATE
+/*
+    @brief Attach a multirate fan out stage to the sample stream
+
+    @param[in] mr Stage to attach, NULL to detach
+*/
+void strain_gauge_attach_multirate(Multirate * mr) {
+    multirate = mr;
+}
+#endif
+
+#if SG_USE_MOTION_COMP
+/*
+    @brief Attach a motion compensation stage
+
+    @param[in] mc Initialized stage, NULL to detach
+*/
+void strain_gauge_attach_motion_comp(MotionComp * mc) {
+    motion = mc;
+}
+#endif
+
+#if SG_USE_AUDIT_LOG
+/*
+    @brief Attach an audit log
+
+    @param[in] log Initialized (or restored) log, NULL to stop logging
+*/
+void strain_gauge_attach_audit_log(AuditLog * log) {
+    audit_log = log;
+}
+#endif
+
+#if SG_USE_STATS
+/*
+    @brief Attach a statistics accumulator to the sample stream
+
+    @param[in] st Initialized accumulator, NULL to detach
+*/
+void strain_gauge_attach_stats(Stats * st) {
+    stats = st;
+}
+#endif
+
+/*
+    @brief Function for reading the current mode
+
+    @ret sg_mode_t the driver is in
+*/
+sg_mode_t strain_gauge_get_mode(void) {
+    return (sg_mode_t)sg.mode;
+}
+
+/*
+    @brief Function for reading the current fault codes
+
+    @ret SG_FAULT_ bits, SG_FAULT_NONE if the bridge looks healthy
+*/
+uint8_t strain_gauge_get_faults(void) {
+    return sg.faults;
+}
+
+/*
+    @brief Function for reading pound measurement from strain gauge
+
+    @note Calculates pounds based on kilogram measurement
+
+    @ret Current pound measurement (float), NAN like read_kgs()
+*/
+float read_lbs(void) {
+    float kgs = read_kgs();
+    return kgs/0.45359237; // kg to lb conversion
+}
+
+/*
+    @brief Function for reading an average measurement
+
+    @note Uses the external read_sg flag that's set on a timer interrupt to call read_kgs()
+	so that there are no timing issues. Each sample gets SG_PARAM_SAMPLE_TIMEOUT_MS to arrive.
+
+    @param[in] times How many times to sample the strain gauge for the average
+
+    @ret Average kg measurement, NAN if a sample timed out or a bridge fault is detected
+*/
+float read_average(uint8_t times) {
+    float average;
+    if(read_average_timeout(times, times * params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32, &average) != SG_OK)
+	return NAN;
+    return average;
+}
+
+/*
+    @brief Average samples at a conversion stage
+
+    @param[in] times How many times to sample the strain gauge for the average
+
+    @param[in] timeout_ms Deadline for the whole average
+
+    @param[in] stage CONVERT_ stage, how much of the calibration to apply
+
+    @param[out] average Average kg measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT, SG_ERR_FAULT or SG_ERR_INVALID if times is 0
+*/
+static sg_status_t average_samples(uint8_t times, uint32_t timeout_ms, uint8_t stage, float * average) {
+    uint32_t budget = budget_us(timeout_ms);
+    float sum = 0;
+    float weight;
+    if(times == 0)
+	return SG_ERR_INVALID;
+    for(uint8_t i = 0; i < times; i++) {
+	if(wait_sample(true, &budget) != SG_OK) // wait for timer interrupt
+	    return SG_ERR_TIMEOUT;
+	weight = read_sample(stage);
+	read_sg = false; // reset flag
+	if(isnan(weight))
+	    return SG_ERR_FAULT;
+	sum += weight;
+#ifdef DEBUG_OUTPUT
+	printf("weight: %f, sum: %f\n", weight, sum);
+#endif	
+    }
+#ifdef DEBUG_OUTPUT
+	printf("average: %f\n", sum/times);
+#endif	
+    *average = sum/times;
+    return SG_OK;
+}
+
+/*
+    @brief Function for reading an average measurement with a deadline
+
+    @param[in] times How many times to sample the strain gauge for the average
+
+    @param[in] timeout_ms Deadline for the whole average
+
+    @param[out] average Average kg measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT, SG_ERR_FAULT or SG_ERR_INVALID
+*/
+sg_status_t read_average_timeout(uint8_t times, uint32_t timeout_ms, float * average) {
+    return average_samples(times, timeout_ms, CONVERT_FULL, average);
+}
+
+/*
+    @brief Initialize an oversampler
+
+    @param[in] os Oversampler to initialize
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS)
+*/
+void oversampler_init(Oversampler * os, uint8_t extra_bits) {
+    extra_bits = oversample_limit(extra_bits);
+    os->acc = 0;
+    os->count = 0;
+    os->extra_bits = extra_bits;
+}
+
+/*
+    @brief Push a raw count into an oversampler
+
+    @note The sum of 4^k samples is shifted right by k, keeping k of the 2k bits of growth
+
+    @param[in] os Oversampler
+
+    @param[in] raw Raw adc count
+
+    @param[out] out Decimated count, only written when a window completes
+
+    @ret true if a new output was written to out
+*/
+bool oversampler_push(Oversampler * os, int32_t raw, int32_t * out) {
+    os->acc += raw;
+    if(++os->count < (UINT32_C(1) << (2 * os->extra_bits)))
+	return false;
+    *out = (int32_t)(os->acc >> os->extra_bits); // arithmetic shift, floors negative sums
+    os->acc = 0;
+    os->count = 0;
+    return true;
+}
+
+/*
+    @brief Function for reading an oversampled raw measurement
+
+    @note Uses the read_sg flag like read_average(), blocks for 4^extra_bits samples
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS, less for adcs over 24 bits)
+
+    @param[in] timeout_ms Deadline for the whole window
+
+    @param[out] out Decimated count with resolution_bits + extra_bits bits of resolution, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t read_raw_oversampled(uint8_t extra_bits, uint32_t timeout_ms, int32_t * out) {
+    Oversampler os;
+    uint32_t budget = budget_us(timeout_ms);
+    int32_t decimated = 0;
+    int32_t raw;
+    uint8_t faults = SG_FAULT_NONE;
+    oversampler_init(&os, oversample_limit(extra_bits));
+    do {
+	if(wait_sample(true, &budget) != SG_OK) // wait for timer interrupt
+	    return SG_ERR_TIMEOUT;
+	raw = backend->read_raw();
+	read_sg = false; // reset flag
+	faults |= diagnose_sample(counts_to_mv(raw, 0));
+    } while(!oversampler_push(&os, raw, &decimated));
+    sg.faults = faults; // report anything seen during the window
+    mode_sample(faults);
+    if(faults != SG_FAULT_NONE)
+	return SG_ERR_FAULT;
+#ifdef DEBUG_OUTPUT
+    printf("oversampled: %" PRId32 " (+%d bits)\n", decimated, os.extra_bits);
+#endif
+    *out = decimated;
+    return SG_OK;
+}
+
+/*
+    @brief Function for reading an oversampled kilogram measurement
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS)
+
+    @ret Oversampled kg measurement, NAN if a sample timed out or a bridge fault is detected
+*/
+float read_kgs_oversampled(uint8_t extra_bits) {
+    int32_t counts;
+    extra_bits = oversample_limit(extra_bits);
+    uint32_t window = UINT32_C(1) << (2 * extra_bits);
+    float kilograms = NAN;
+    if(read_raw_oversampled(extra_bits, window * params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32, &counts) == SG_OK)
+	kilograms = convert_kgs(counts_to_mv(counts, extra_bits) - warmup_drift_mv(), CONVERT_FULL);
+    process_events(kilograms);
+    return kilograms;
+}
+
+/*
+    @brief Capture a stream of raw measurements
+
+    @param[out] samples Buffer to fill with raw adc counts
+
+    @param[in] n Number of samples to capture
+
+    @param[in] timeout_ms Deadline for the whole capture
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT if a read failed
+*/
+sg_status_t strain_gauge_capture_raw(int32_t * samples, uint32_t n, uint32_t timeout_ms) {
+    uint32_t budget = budget_us(timeout_ms);
+    for(uint32_t i = 0; i < n; i++) {
+	if(wait_sample(true, &budget) != SG_OK) // wait for timer interrupt
+	    return SG_ERR_TIMEOUT;
+	samples[i] = backend->read_raw();
+	read_sg = false; // reset flag
+	if(samples[i] == SG_RAW_INVALID) {
+	    sg.faults |= SG_FAULT_READ;
+	    return SG_ERR_FAULT;
+	}
+    }
+    return SG_OK;
+}
+
+#if SG_USE_RAW_RING
+/*
+    @brief Read a raw sample into the ring
+*/
+void strain_gauge_raw_isr(void) {
+    strain_gauge_push_raw(backend->read_raw());
+}
+
+/*
+    @brief Put a raw sample into the ring
+
+    @param[in] raw Raw adc count
+*/
+void strain_gauge_push_raw(int32_t raw) {
+    if(raw == SG_RAW_INVALID) {
+	sg.faults |= SG_FAULT_READ;
+	return;
+    }
+    uint32_t head = raw_head;
+    if(head - raw_tail >= SG_RAW_RING_SIZE) {
+	raw_overruns++;
+	return;
+    }
+    raw_ring[head & (SG_RAW_RING_SIZE - 1)] = raw;
+    memory_barrier(); // sample is in the ring before the reader can see it
+    raw_head = head + 1;
+}
+
+/*
+    @brief Acquire raw samples in bulk
+
+    @param[out] buf Buffer for the raw adc counts
+
+    @param[in] n Number of samples wanted
+
+    @param[in] timeout_ms Deadline for all n samples
+
+    @param[out] acquired Number of samples written to buf, can be less than n on a timeout
+
+    @ret SG_OK or SG_ERR_TIMEOUT
+*/
+sg_status_t strain_gauge_acquire(int32_t * buf, size_t n, uint32_t timeout_ms, size_t * acquired) {
+    uint32_t budget = budget_us(timeout_ms);
+    size_t got = 0;
+    while(got < n) {
+	uint32_t tail = raw_tail;
+	uint32_t avail = raw_head - tail;
+	if(avail == 0) {
+	    if(budget < SG_WAIT_POLL_US) {
+		*acquired = got;
+		return SG_ERR_TIMEOUT;
+	    }
+	    delay_us(SG_WAIT_POLL_US);
+	    budget -= SG_WAIT_POLL_US;
+	    if(wait_hook)
+		wait_hook();
+	    continue;
+	}
+	memory_barrier(); // read the samples after seeing the head that covers them
+	size_t count = n - got < avail ? n - got : avail;
+	// at most two copies, up to the end of the ring then from the start
+	size_t start = tail & (SG_RAW_RING_SIZE - 1);
+	size_t first = SG_RAW_RING_SIZE - start < count ? SG_RAW_RING_SIZE - start : count;
+	memcpy(&buf[got], &raw_ring[start], first * sizeof(int32_t));
+	memcpy(&buf[got + first], raw_ring, (count - first) * sizeof(int32_t));
+	memory_barrier(); // done reading before the slots are handed back
+	raw_tail = tail + count;
+	got += count;
+    }
+    *acquired = got;
+    return SG_OK;
+}
+
+/*
+    @brief Function for reading how many raw samples were dropped because the ring was full
+
+    @ret Dropped sample count since init
+*/
+uint32_t strain_gauge_raw_overruns(void) {
+    return raw_overruns;
+}
+#endif
+
+/*
+    @brief Set the tare offset
+
+    @param[in] offset New offset
+*/
+static void set_offset(float offset) {
+    CalibrationSet * cal = calibration_begin();
+    cal->offset = offset;
+    calibration_commit(cal);
+}
 
-volatile bool taring = false; // taring flag used to indicate that the strain gauge is being tared
-volatile bool calibrating = false; // calibrating flag used to indicate that the strain gauge is being calibrated 
-extern bool read_sg; // read strain gauge flag, set on interrupt in main.c, used in read_average() to prevent timing issues
+/*
+    @brief Tare the strain gauge
 
-// line of best fit calibration factors
-static float slope = 0;
-static float intercept = 0;
+    @note Calculates the average measurement and sets that as the offset to get the reading to 0.
+	The offset is left alone if the average fails.
+*/
+void strain_gauge_tare(void) {
+    strain_gauge_tare_timeout(params[SG_PARAM_TARE_SAMPLES].u32 * params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32);
+}
 
 /*
-    @brief Strain Gauge Initialization
+    @brief Tare the strain gauge with a deadline
 
-    @note Sets specifications used for calculating kgs
+    @param[in] timeout_ms Deadline for the tare average
 
-    @param[in] ve Excitation / Power Supply Voltage (usually 5V)
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t strain_gauge_tare_timeout(uint32_t timeout_ms) {
+    float tare_weight;
+#ifdef DEBUG_OUTPUT
+    printf("taring...\n");
+#endif
+    if(!audit_room(1))
+	return SG_ERR_FULL;
+    if(!mode_enter(SG_MODE_TARING))
+	return SG_ERR_BUSY;
+    sg_status_t status = average_samples(params[SG_PARAM_TARE_SAMPLES].u32, timeout_ms, CONVERT_UNTARED, &tare_weight); // calculate tare weight
+    if(status == SG_OK)
+	set_offset(tare_weight); // set offset
+    mode_exit(SG_MODE_TARING);
+    if(status == SG_OK) {
+	audit(AUDIT_TARE, tare_weight, 0);
+	dispatch_event(SG_EVENT_TARE_COMPLETE, tare_weight);
+    }
+    return status;
+}
 
-    @param[in] capacity Load Cell capacity (3kg, 10kg, 50kg, etc.)
+/*
+    @brief Take a sample if one is ready, without waiting
 
-    @param[in] ro Rated Output in mV/V
+    @param[out] kgs Kilogram measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_FAULT, or SG_BUSY if no sample was ready
 */
-void strain_gauge_init(float ve, uint16_t capacity, float ro) {
-    sg.capacity = capacity;
-    sg.VE = ve;
-    sg.RO = ro;
-    sg.offset = 0;
+sg_status_t strain_gauge_poll(float * kgs) {
+    if(!read_sg || !backend->is_ready())
+	return SG_BUSY;
+    float weight = read_sample(CONVERT_FULL);
+    read_sg = false; // reset flag
+    if(isnan(weight))
+	return SG_ERR_FAULT;
+    *kgs = weight;
+    return SG_OK;
 }
 
 /*
-    @brief Function for reading kilogram measurement from strain gauge
+    @brief Function for checking if the readings are stable
 
-    @note Calculates kilograms based on load cell specifications, line of best fit, and tare offset
+    @ret true if the readings have been within SG_PARAM_STABLE_BAND for SG_PARAM_STABLE_TIME_MS
+*/
+bool strain_gauge_is_stable(void) {
+    return stable;
+}
 
-    @ret Current kilogram measurement (float)
+/*
+    @brief Start a non-blocking average
+
+    @param[out] job Job to start
+
+    @param[in] times How many times to sample the strain gauge for the average
 */
-float read_kgs(void) {
-    float sense_voltage = adc_read_voltage(); // measured voltage
+void strain_gauge_average_start(SgAverageJob * job, uint8_t times) {
+    job->sum = 0;
+    job->result = 0;
+    job->times = times > 0 ? times : 1;
+    job->count = 0;
+    job->kind = SG_JOB_AVERAGE;
+    job->status = SG_BUSY;
+}
+
+/*
+    @brief Start a non-blocking tare
+
+    @param[out] job Job to start
+*/
+void strain_gauge_tare_start(SgAverageJob * job) {
+    strain_gauge_average_start(job, params[SG_PARAM_TARE_SAMPLES].u32);
+    job->kind = SG_JOB_TARE;
+    if(!mode_enter(SG_MODE_TARING))
+	job->status = SG_ERR_BUSY;
 #ifdef DEBUG_OUTPUT
-    printf("measured voltage: %f\n", sense_voltage);
+    printf("taring...\n");
 #endif
-    float kilograms = sense_voltage*(sg.capacity/(sg.VE*sg.RO));
-#ifdef DEBUG_OUTPUT
-    printf("kilograms: %f\n", kilograms);
-#endif	
-    
-    // if calibrating, we don't have a slope or intercept yet
-    if(calibrating)
-	return kilograms;
-
-    // manipulate kilograms based on best fit equation
-    if(kilograms > 0)
-	kilograms = slope * kilograms + intercept;
-    else
-	kilograms = slope * kilograms - intercept;
-    
-    // if we're taring, don't consider previous offset
-    if(taring)
-	return kilograms;
-    
-    if(sg.offset > 0)
-	return kilograms - sg.offset;
-    else
-	return kilograms + sg.offset;
-	
 }
 
 /*
-    @brief Function for reading pound measurement from strain gauge
-
-    @note Calculates pounds based on kilogram measurement
+    @brief Start a non-blocking zero
 
-    @ret Current pound measurement (float)
+    @param[out] job Job to start
 */
-float read_lbs(void) {
-    float kgs = read_kgs();
-    return kgs/0.45359237; // kg to lb conversion
+void strain_gauge_zero_start(SgAverageJob * job) {
+    strain_gauge_tare_start(job);
+    job->kind = SG_JOB_ZERO;
 }
 
 /*
-    @brief Function for reading an average measurement
+    @brief Finish a job with its average
 
-    @note Uses the external read_sg flag that's set on a timer interrupt to call read_kgs()
-	so that there are no timing issues, and no delays are used
+    @param[in] job Job that has all its samples
 
-    @param[in] times How many times to sample the strain gauge for the average
+    @param[in] average Average of the samples
 
-    @ret Average kg measurement
+    @ret SG_OK, SG_ERR_INVALID for a zero out of range, or SG_ERR_FULL
 */
-float read_average(uint8_t times) {
-    float sum = 0;
-    float weight;
-    for(uint8_t i = 0; i < times; i++) {
-	while(!read_sg) {} // wait for timer interrupt
-	weight = read_kgs();
-	read_sg = false; // reset flag
-	sum += weight;
-#ifdef DEBUG_OUTPUT
-	printf("weight: %f, sum: %f\n", weight, sum);
-#endif	
+static sg_status_t job_finish(SgAverageJob * job, float average) {
+    switch(job->kind) {
+	case SG_JOB_ZERO:
+	    if(fabsf(average) > SG_ZERO_RANGE * sg.capacity) {
+		mode_exit(SG_MODE_TARING);
+		return SG_ERR_INVALID;
+	    }
+	    // fall through
+	case SG_JOB_TARE:
+	    if(!audit_room(1)) {
+		mode_exit(SG_MODE_TARING);
+		return SG_ERR_FULL;
+	    }
+	    set_offset(average);
+	    mode_exit(SG_MODE_TARING);
+	    audit(AUDIT_TARE, average, 0);
+	    dispatch_event(SG_EVENT_TARE_COMPLETE, average);
+	    break;
+	case SG_JOB_CAL_POINT:
+	    if(!cal_session || cal_points > SG_MAX_CAL_POINTS)
+		return SG_ERR_INVALID; // aborted while sampling
+	    cal_x[cal_points] = average;
+	    cal_y[cal_points] = job->known_weight;
+	    cal_points++;
+	    break;
     }
-#ifdef DEBUG_OUTPUT
-	printf("average: %f\n", sum/times);
-#endif	
-    return sum/times;
+    return SG_OK;
 }
 
+/*
+    @brief Advance a non-blocking average or tare
+
+    @param[in] job Job to advance
+
+    @ret SG_BUSY while sampling, then SG_OK or SG_ERR_FAULT
+*/
+sg_status_t strain_gauge_job_poll(SgAverageJob * job) {
+    if(job->status != SG_BUSY || !read_sg || !backend->is_ready())
+	return job->status;
+    static const uint8_t stage[] = {
+	[SG_JOB_AVERAGE] = CONVERT_FULL,
+	[SG_JOB_TARE] = CONVERT_UNTARED,
+	[SG_JOB_ZERO] = CONVERT_UNTARED,
+	[SG_JOB_CAL_POINT] = CONVERT_RAW,
+    };
+    float weight = read_sample(stage[job->kind]);
+    read_sg = false; // reset flag
+    if(isnan(weight)) {
+	strain_gauge_job_cancel(job);
+	job->status = SG_ERR_FAULT;
+	return job->status;
+    }
+    job->sum += weight;
+    if(++job->count < job->times)
+	return SG_BUSY;
+    float average = job->sum / job->times;
+    job->result = average;
+    job->status = job_finish(job, average);
+    return job->status;
+}
 
 /*
-    @brief Tare the strain gauge
+    @brief Abandon a non-blocking average or tare
 
-    @note Calculates the average measurement and sets that as the offset to get the reading to 0.
+    @param[in] job Job to cancel
 */
-void strain_gauge_tare(void) {
-#ifdef DEBUG_OUTPUT
-    printf("taring...\n");
-#endif
-    taring = true;
-    float tare_weight = read_average(15); // calculate tare weight
-    sg.offset = tare_weight; // set offset
-    taring = false;
+void strain_gauge_job_cancel(SgAverageJob * job) {
+    if(job->status == SG_BUSY && (job->kind == SG_JOB_TARE || job->kind == SG_JOB_ZERO))
+	mode_exit(SG_MODE_TARING);
+    job->status = SG_ERR_TIMEOUT;
 }
 
 /*
@@ -148,47 +1439,121 @@ void strain_gauge_tare(void) {
     @note Takes an array of known weight values, and calculates a line of best fit equation using
 	the known weights as y data and the measured averages per weight as x data. 
 
-    @param[in] weight_cnt Number of known weights
+    @param[in] weight_cnt Number of known weights (1 to SG_MAX_CAL_POINTS)
 
     @param[in] known_weights Float array of known weight values
 
     @param[in] equation Float array to populate with slope and intercept of line of best fit equation
+
+    @ret SG_OK, SG_ERR_BUSY, SG_ERR_TIMEOUT, SG_ERR_FAULT or SG_ERR_INVALID
 */
-void strain_gauge_calibrate(uint8_t weight_cnt, float * known_weights, float * equation) {
-    calibrating = true;
+sg_status_t strain_gauge_calibrate(uint8_t weight_cnt, float * known_weights, float * equation) {
+    if(weight_cnt == 0 || weight_cnt > SG_MAX_CAL_POINTS)
+	return SG_ERR_INVALID;
+    if(!mode_enter(SG_MODE_CALIBRATING))
+	return SG_ERR_BUSY;
+    sg_status_t status;
     uint8_t i;
-    float m = 0, b = 0; // slope and intercept
-    float sumX = 0, sumX2 = 0, sumY = 0, sumXY = 0;
-    float x[weight_cnt+1]; // x data
-    float y[weight_cnt+1]; // y data
+    uint8_t samples = params[SG_PARAM_CAL_SAMPLES].u32;
+    uint32_t timeout_ms = samples * params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32;
+    float * x = cal_x; // x data
+    float * y = cal_y; // y data
     y[0] = 0;
-    // copy known_weights into y
-    uint8_t n = weight_cnt + 1;
-    for(i = 0; i <= weight_cnt; i++) {
+    // copy known_weights into y after the zero point
+    for(i = 0; i < weight_cnt; i++) {
 	y[i+1] = known_weights[i];
     }
     float kilograms = 0;
 #ifdef DEBUG_OUTPUT
     printf("Averaging 0 weight, please wait.\n");
 #endif
-    kilograms = read_average(20);
+    status = average_samples(samples, timeout_ms, CONVERT_RAW, &kilograms);
+    if(status != SG_OK) {
+	mode_exit(SG_MODE_CALIBRATING);
+	return status;
+    }
     x[0] = kilograms;
 #ifdef DEBUG_OUTPUT
 	printf("%fkg: %f\n", y[0], x[0]);
 #endif
     for(i = 1; i <= weight_cnt; i++) {
 #ifdef DEBUG_OUTPUT
-	printf("You have 15 seconds to put weight %d on (or take it off).\n", i);
+	printf("You have %" PRIu32 "ms to put weight %d on (or take it off).\n", params[SG_PARAM_CAL_SETTLE_MS].u32, i);
 #endif
-	delay_ms(15000); // wait 15s
-	kilograms = read_average(20);
+	delay_ms(params[SG_PARAM_CAL_SETTLE_MS].u32); // wait for the weight to be put on
+	status = average_samples(samples, timeout_ms, CONVERT_RAW, &kilograms);
+	if(status != SG_OK) {
+	    mode_exit(SG_MODE_CALIBRATING);
+	    return status;
+	}
 	x[i] = kilograms;
 #ifdef DEBUG_OUTPUT
 	printf("%fkg: %f\n", y[i], x[i]);
 #endif
     }
     
-    strain_gauge_calculate_equation(weight_cnt+1, x, y, equation);
+    status = strain_gauge_calculate_equation(weight_cnt, x, y, equation);
+    mode_exit(SG_MODE_CALIBRATING);
+    return status;
+}
+
+/*
+    @brief Start a step by step calibration
+
+    @ret SG_OK, or SG_ERR_BUSY if a tare or calibration is already running
+*/
+sg_status_t strain_gauge_cal_begin(void) {
+    if(!mode_enter(SG_MODE_CALIBRATING))
+	return SG_ERR_BUSY;
+    cal_session = true;
+    cal_points = 0;
+    return SG_OK;
+}
+
+/*
+    @brief Start capturing a calibration point
+
+    @param[out] job Job to start
+
+    @param[in] known_weight Weight on the load cell in kg
+*/
+void strain_gauge_cal_point_start(SgAverageJob * job, float known_weight) {
+    strain_gauge_average_start(job, params[SG_PARAM_CAL_SAMPLES].u32);
+    job->kind = SG_JOB_CAL_POINT;
+    job->known_weight = known_weight;
+    if(!cal_session || cal_points > SG_MAX_CAL_POINTS || !isfinite(known_weight))
+	job->status = SG_ERR_INVALID;
+}
+
+/*
+    @brief Fit and apply the captured calibration points
+
+    @param[out] equation Slope and intercept, only written on SG_OK
+
+    @ret SG_OK or SG_ERR_INVALID
+*/
+sg_status_t strain_gauge_cal_commit(float * equation) {
+    if(!cal_session || cal_points < 2)
+	return SG_ERR_INVALID;
+    sg_status_t status = strain_gauge_calculate_equation(cal_points - 1, cal_x, cal_y, equation);
+    if(status != SG_OK)
+	return status;
+    status = strain_gauge_set_equation(equation[0], equation[1]);
+    if(status != SG_OK)
+	return status;
+    cal_session = false;
+    mode_exit(SG_MODE_CALIBRATING);
+    return SG_OK;
+}
+
+/*
+    @brief Abandon a step by step calibration
+*/
+void strain_gauge_cal_abort(void) {
+    if(!cal_session)
+	return;
+    cal_session = false;
+    mode_exit(SG_MODE_CALIBRATING);
 }
 
 /*
@@ -201,26 +1566,42 @@ void strain_gauge_calibrate(uint8_t weight_cnt, float * known_weights, float * e
     @param[in] y Y data points, should be known weights
 
     @param[in] equation Pointer to a float array to populate with calibration factors
+
+    @ret SG_OK or SG_ERR_INVALID
 */
-void strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, float * equation) {
+sg_status_t strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, float * equation) {
     float m = 0, b = 0; // slope and intercept
-    float sumX = 0, sumX2 = 0, sumY = 0, sumXY = 0;
-    uint8_t n = weight_cnt + 1;
-    // calculate required sums
-    for(uint8_t i = 0; i < n; i++) {
-	sumX += x[i];
+    float meanX = 0, meanY = 0;
+    float sumX2 = 0, Sxx = 0, Sxy = 0;
+    uint16_t n = weight_cnt + 1; // the zero point and the known weights
+    // means first, the sums below are taken about them so nearly equal x don't cancel
+    for(uint16_t i = 0; i < n; i++) {
+	if(!isfinite(x[i]) || !isfinite(y[i]))
+	    return SG_ERR_INVALID;
+	meanX += x[i];
+	meanY += y[i];
+    }
+    meanX /= n;
+    meanY /= n;
+    for(uint16_t i = 0; i < n; i++) {
+	float dx = x[i] - meanX;
 	sumX2 += x[i] * x[i];
-	sumY += y[i];
-	sumXY += x[i] * y[i];
+	Sxx += dx * dx;
+	Sxy += dx * (y[i] - meanY);
     }
-    // calculate slope and intercept
-    m = (n * sumXY - sumX * sumY) / (n * sumX2 - sumX * sumX);
-    b = (sumY - m * sumX) / n;
+    // x that barely differ can't be told apart from rounding, the slope would be noise
+    if(!(Sxx > SG_CAL_MIN_SPREAD * sumX2))
+	return SG_ERR_INVALID;
+    m = Sxy / Sxx;
+    b = meanY - m * meanX;
 #ifdef DEBUG_OUTPUT
     printf("slope: %f, intercept: %f\n", m, b);
 #endif
+    if(!isfinite(m) || !isfinite(b))
+	return SG_ERR_INVALID;
     equation[0] = m;
     equation[1] = b;
+    return SG_OK;
 }
 
 /*
@@ -231,8 +1612,405 @@ void strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, f
     @param[in] m Slope for line of best fit equation
 
     @param[in] b Intercept for line of best fit equation
+
+    @ret SG_OK, SG_ERR_INVALID if m or b isn't finite, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_set_equation(float m, float b) {
+    if(!isfinite(m) || !isfinite(b))
+	return SG_ERR_INVALID;
+    if(!audit_room(1))
+	return SG_ERR_FULL;
+    CalibrationSet * cal = calibration_begin();
+    cal->slope = m;
+    cal->intercept = b;
+    calibration_commit(cal);
+    audit(AUDIT_EQUATION, m, b);
+    return SG_OK;
+}
+
+/*
+    @brief Swap in a whole calibration set
+
+    @param[in] cal Calibration set, the version is ignored
+*/
+static void calibration_restore(const CalibrationSet * cal) {
+    CalibrationSet * next = calibration_begin();
+    next->slope = cal->slope;
+    next->intercept = cal->intercept;
+    next->offset = cal->offset;
+    next->scale = cal->scale;
+    next->gravity = cal->gravity;
+    calibration_commit(next);
+}
+
+/*
+    @brief Calculate the crc of a calibration set
+
+    @note Field by field, little endian, so a set saved on one part checks on another
+
+    @param[in] cal Calibration set, everything before the crc field is covered
+
+    @ret Crc for the set
+*/
+static uint32_t calibration_crc(const CalibrationSet * cal) {
+    uint32_t crc = crc32_update_float(CRC32_SEED, cal->slope);
+    crc = crc32_update_float(crc, cal->intercept);
+    crc = crc32_update_float(crc, cal->offset);
+    crc = crc32_update_float(crc, cal->scale);
+    crc = crc32_update_float(crc, cal->gravity);
+    return crc32_update_u32(crc, cal->version, 4);
+}
+
+/*
+    @brief Check a calibration set before it's used
+
+    @note Catches a corrupted record from flash as well as values that would turn every
+	reading into NAN or inf
+
+    @param[in] cal Calibration set
+
+    @ret true if the set can be swapped in
+*/
+static bool calibration_valid(const CalibrationSet * cal) {
+    return cal->crc == calibration_crc(cal) && isfinite(cal->slope) && isfinite(cal->intercept) &&
+	isfinite(cal->offset) && isfinite(cal->scale) && cal->scale > 0 && isfinite(cal->gravity) &&
+	cal->gravity > 0;
+}
+
+/*
+    @brief Get a consistent copy of the calibration in use
+
+    @param[out] cal Calibration set
+*/
+void strain_gauge_get_calibration(CalibrationSet * cal) {
+    calibration_snapshot(cal);
+    strain_gauge_seal_calibration(cal);
+}
+
+/*
+    @brief Seal a calibration set built by hand
+
+    @param[in,out] cal Calibration set
+*/
+void strain_gauge_seal_calibration(CalibrationSet * cal) {
+    cal->crc = calibration_crc(cal);
+}
+
+/*
+    @brief Replace the whole calibration in one swap
+
+    @param[in] cal Calibration set
+
+    @ret true if the set was valid and swapped in
+*/
+bool strain_gauge_set_calibration(const CalibrationSet * cal) {
+    CalibrationSet old;
+    if(!calibration_valid(cal))
+	return false;
+    // the equation record marks the restore, every other field that changes gets its own
+    calibration_snapshot(&old);
+    bool tare = cal->offset != old.offset;
+    bool scale = cal->scale != old.scale;
+    bool gravity = cal->gravity != old.gravity;
+    if(!audit_room(1 + tare + scale + gravity))
+	return false;
+    calibration_restore(cal);
+    audit(AUDIT_EQUATION, cal->slope, cal->intercept);
+    if(tare)
+	audit(AUDIT_TARE, cal->offset, 0);
+    if(gravity)
+	audit(AUDIT_GRAVITY, cal->gravity, 0);
+    if(scale)
+	audit(AUDIT_SCALE, cal->scale, 0);
+    return true;
+}
+
+/*
+    @brief Bring the strain gauge up to its first valid reading
+
+    @param[in] persisted Calibration saved with strain_gauge_get_calibration(), NULL to keep
+	the current one
+
+    @param[in] timeout_ms Deadline for the whole startup
+
+    @ret SG_OK once valid, SG_ERR_TIMEOUT if the readings didn't settle in time, or
+	SG_ERR_INVALID if the persisted calibration is corrupted
+*/
+sg_status_t strain_gauge_startup(const CalibrationSet * persisted, uint32_t timeout_ms) {
+    uint32_t budget = budget_us(timeout_ms);
+    uint32_t samples = 0;
+    valid = false;
+    boot_latency_ms = 0;
+    if(persisted) {
+	if(!calibration_valid(persisted))
+	    return SG_ERR_INVALID;
+	calibration_restore(persisted);
+    }
+
+    // startup reads at the adc's own pace, the read_sg timer only paces the application.
+    // the first conversions after power up aren't settled, only the diagnostics see them
+    for(uint8_t i = 0; i < SG_STARTUP_DISCARD; i++) {
+	if(wait_sample(false, &budget) != SG_OK)
+	    return SG_ERR_TIMEOUT;
+	diagnose_sample(counts_to_mv(backend->read_raw(), 0));
+	samples++;
+    }
+
+    // prefill the stability window from a burst of one window of conversions, a steady load
+    // is valid as soon as the burst is in and the reference is its mean, not the first reading
+    float weight = NAN, sum = 0, lo = INFINITY, hi = -INFINITY;
+    for(uint16_t i = 0; i < stable_samples; i++) {
+	if(wait_sample(false, &budget) != SG_OK)
+	    return SG_ERR_TIMEOUT;
+	weight = convert_sample(CONVERT_FULL);
+	samples++;
+	sum += weight; // a faulted sample makes the mean NAN
+	lo = weight < lo ? weight : lo;
+	hi = weight > hi ? weight : hi;
+    }
+    float mean = sum / stable_samples;
+    float band = params[SG_PARAM_STABLE_BAND].f;
+    stable = false;
+    stable_avg = mean;
+    stable_cnt = hi - mean < band && mean - lo < band ? stable_samples : 0;
+    last_weight = NAN; // first sample for the events, the thresholds start from the mean
+    process_events(mean);
+
+    // otherwise wait for the readings to settle
+    while(!stable) {
+	if(wait_sample(false, &budget) != SG_OK)
+	    return SG_ERR_TIMEOUT;
+	read_sample(CONVERT_FULL);
+	samples++;
+    }
+
+    valid = true;
+    // from power on when there's a clock, otherwise the conversions read since the call
+    boot_latency_ms = clock_ms ? clock_ms() : (uint32_t)(samples * 1000.0f / backend->sample_rate);
+#ifdef DEBUG_OUTPUT
+    printf("valid after %" PRIu32 " samples, %" PRIu32 "ms\n", samples, boot_latency_ms);
+#endif
+    dispatch_event(SG_EVENT_VALID, last_weight);
+    return SG_OK;
+}
+
+/*
+    @brief Function for checking if startup has finished
+
+    @ret true once strain_gauge_startup() has seen stable readings
+*/
+bool strain_gauge_is_valid(void) {
+    return valid;
+}
+
+/*
+    @brief Function for reading how long startup took
+
+    @ret Time from power on to the first valid reading in ms, 0 if not valid yet
+*/
+uint32_t strain_gauge_boot_latency_ms(void) {
+    return boot_latency_ms;
+}
+
+#if SG_USE_WARMUP
+/*
+    @brief Set the warm-up drift compensation
+
+    @param[in] model Fitted model, NULL to turn compensation off
+*/
+void strain_gauge_set_warmup(const WarmupModel * model) {
+    warmup_enabled = false;
+    if(model == NULL || model->tau <= 0)
+	return;
+    warmup = *model;
+    warmup_enabled = true;
+}
+#endif
+
+/*
+    @brief Function for reading the description of a parameter
+
+    @param[in] id sg_param_id_t
+
+    @ret Description, NULL if the id is unknown
 */
-void strain_gauge_set_equation(float m, float b) {
-    slope = m;
-    intercept = b;
+const SgParamInfo * strain_gauge_param_info(uint16_t id) {
+    return id < SG_PARAM_COUNT ? &param_info[id] : NULL;
+}
+
+/*
+    @brief Function for reading a parameter
+
+    @param[in] id sg_param_id_t
+
+    @param[out] value Current value
+
+    @ret SG_OK or SG_ERR_INVALID if the id is unknown
+*/
+sg_status_t strain_gauge_param_get(uint16_t id, sg_param_value_t * value) {
+    if(id >= SG_PARAM_COUNT)
+	return SG_ERR_INVALID;
+    *value = params[id];
+    return SG_OK;
+}
+
+/*
+    @brief Check a value against a parameter's range
+
+    @param[in] id sg_param_id_t
+
+    @param[in] value Value to check
+
+    @ret true if the id is known and the value is in range, NAN is never in range
+*/
+static bool param_valid(uint16_t id, sg_param_value_t value) {
+    if(id >= SG_PARAM_COUNT)
+	return false;
+    const SgParamInfo * info = &param_info[id];
+    if(info->type == SG_PARAM_TYPE_FLOAT)
+	return value.f >= info->min.f && value.f <= info->max.f;
+    return value.u32 >= info->min.u32 && value.u32 <= info->max.u32;
+}
+
+/*
+    @brief Store a checked parameter and update whatever is derived from it
+
+    @param[in] id sg_param_id_t
+
+    @param[in] value Value, already checked with param_valid()
+*/
+static void param_apply(uint16_t id, sg_param_value_t value) {
+    params[id] = value;
+    if(id == SG_PARAM_STABLE_TIME_MS)
+	update_stable_samples();
+}
+
+/*
+    @brief Set a parameter
+
+    @param[in] id sg_param_id_t
+
+    @param[in] value New value, of the parameter's type
+
+    @ret SG_OK, or SG_ERR_INVALID if the id is unknown or the value is out of range
+*/
+sg_status_t strain_gauge_param_set(uint16_t id, sg_param_value_t value) {
+    if(!param_valid(id, value))
+	return SG_ERR_INVALID;
+    if(!audit_room(1))
+	return SG_ERR_FULL;
+    param_apply(id, value);
+    audit(AUDIT_CONFIG, id, param_info[id].type == SG_PARAM_TYPE_FLOAT ? value.f : value.u32);
+    return SG_OK;
+}
+
+/*
+    @brief Reset every parameter to its default
+*/
+void strain_gauge_param_defaults(void) {
+    for(uint16_t i = 0; i < SG_PARAM_COUNT; i++)
+	param_apply(i, param_info[i].def);
+}
+
+/*
+    @brief Export every parameter
+
+    @param[out] buf Buffer for the records
+
+    @param[in] len Size of buf
+
+    @ret Bytes written, 0 if buf is too small
+*/
+size_t strain_gauge_param_export(uint8_t * buf, size_t len) {
+    if(len < SG_PARAM_COUNT * SG_PARAM_RECORD_SIZE)
+	return 0;
+    for(uint16_t i = 0; i < SG_PARAM_COUNT; i++) {
+	uint32_t v = params[i].u32;
+	buf[0] = i & 0xFF;
+	buf[1] = i >> 8;
+	buf[2] = v & 0xFF;
+	buf[3] = (v >> 8) & 0xFF;
+	buf[4] = (v >> 16) & 0xFF;
+	buf[5] = v >> 24;
+	buf += SG_PARAM_RECORD_SIZE;
+    }
+    return SG_PARAM_COUNT * SG_PARAM_RECORD_SIZE;
+}
+
+/*
+    @brief Decode an exported parameter record
+
+    @param[in] rec SG_PARAM_RECORD_SIZE bytes
+
+    @param[out] value Value
+
+    @ret Parameter id
+*/
+static uint16_t param_decode(const uint8_t * rec, sg_param_value_t * value) {
+    value->u32 = rec[2] | (uint32_t)rec[3] << 8 | (uint32_t)rec[4] << 16 | (uint32_t)rec[5] << 24;
+    return rec[0] | rec[1] << 8;
+}
+
+/*
+    @brief Import parameters
+
+    @param[in] buf Records from strain_gauge_param_export() or built to the same format
+
+    @param[in] len Size of buf, a multiple of SG_PARAM_RECORD_SIZE
+
+    @ret SG_OK, or SG_ERR_INVALID if a record is malformed, unknown or out of range
+*/
+sg_status_t strain_gauge_param_import(const uint8_t * buf, size_t len) {
+    sg_param_value_t value;
+    if(len % SG_PARAM_RECORD_SIZE != 0)
+	return SG_ERR_INVALID;
+    for(size_t i = 0; i < len; i += SG_PARAM_RECORD_SIZE) {
+	if(!param_valid(param_decode(&buf[i], &value), value))
+	    return SG_ERR_INVALID;
+    }
+    if(!audit_room(len / SG_PARAM_RECORD_SIZE))
+	return SG_ERR_FULL;
+    for(size_t i = 0; i < len; i += SG_PARAM_RECORD_SIZE) {
+	uint16_t id = param_decode(&buf[i], &value);
+	strain_gauge_param_set(id, value);
+    }
+    return SG_OK;
+}
+
+/*
+    @brief Read the weight the way the parameters say
+
+    @param[out] value Weight, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t strain_gauge_read(float * value) {
+    uint32_t timeout_ms = params[SG_PARAM_SAMPLE_TIMEOUT_MS].u32;
+    uint8_t length = params[SG_PARAM_FILTER_LENGTH].u32;
+    sg_status_t status;
+    float weight;
+    switch(params[SG_PARAM_FILTER].u32) {
+	case SG_FILTER_AVERAGE:
+	    status = read_average_timeout(length, length * timeout_ms, &weight);
+	    break;
+	case SG_FILTER_OVERSAMPLE:
+	    weight = read_kgs_oversampled(params[SG_PARAM_OVERSAMPLE_BITS].u32);
+	    status = !isnan(weight) ? SG_OK : sg.faults & SG_FAULT_TIMEOUT ? SG_ERR_TIMEOUT : SG_ERR_FAULT;
+	    break;
+	default:
+	    status = read_kgs_timeout(timeout_ms, &weight);
+	    break;
+    }
+    if(status != SG_OK)
+	return status;
+
+    if(params[SG_PARAM_UNITS].u32 == SG_UNITS_LB)
+	weight /= 0.45359237f; // kg to lb conversion
+    else if(params[SG_PARAM_UNITS].u32 == SG_UNITS_G)
+	weight *= 1000;
+    float division = params[SG_PARAM_DIVISION].f;
+    if(division > 0)
+	weight = roundf(weight / division) * division;
+    *value = weight;
+    return SG_OK;
 }
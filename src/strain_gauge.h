@@ -15,15 +15,230 @@
 #define STRAIN_GUAGE_H
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <float.h>
+#include "strain_gauge_config.h"
+#include "audit_log.h"
+#if SG_USE_MULTIRATE
+#include "multirate.h"
+#endif
+#if SG_USE_STATS
+#include "stats.h"
+#endif
+#if SG_USE_WARMUP
+#include "warmup_model.h"
+#endif
+#if SG_USE_MOTION_COMP
+#include "motion_comp.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// oversampling
+#define SG_MAX_OVERSAMPLE_BITS 8 // 4^8 samples per output, keeps the accumulator well inside 64 bits
+#define SG_READ_MAX_OVERSAMPLE_BITS 4 // limit of SG_PARAM_OVERSAMPLE_BITS, 256 samples or 26 s at 10 SPS
+
+// calibration
+#define SG_CAL_MIN_SPREAD FLT_EPSILON // sum((x - mean)^2) has to be above this fraction of sum(x^2)
+
+// timeout bounded reads
+#define SG_DEFAULT_TIMEOUT_MS 1000 // per sample deadline used by the calls that don't take one
+#define SG_WAIT_POLL_US 100 // polling interval while waiting for a sample
+
+// startup
+#define SG_STARTUP_DISCARD 4 // conversions thrown away after power up, the hx711 needs 4 to settle
+
+// bridge diagnostics
+#define SG_DIAG_RAIL_LEVEL 0.999f // fraction of adc full scale treated as a rail
+#define SG_DIAG_RAIL_COUNT 3 // consecutive rail readings before reporting saturation
+#define SG_DIAG_STUCK_COUNT 20 // consecutive identical readings before reporting a stuck adc
+#define SG_DIAG_NOISE_LEVEL 0.01f // sample to sample reversal limit as a fraction of adc full scale
+#define SG_DIAG_NOISY_COUNT 4 // consecutive reversals over the limit before reporting noise
+
+// fault codes, more than one can be set at a time
+#define SG_FAULT_NONE 0x00
+#define SG_FAULT_RAIL_HIGH 0x01 // pinned to the positive rail (open signal wire, or load far beyond capacity)
+#define SG_FAULT_RAIL_LOW 0x02 // pinned to the negative rail (open signal wire or reversed bridge)
+#define SG_FAULT_STUCK 0x04 // the same reading over and over (adc not converting, excitation lost)
+#define SG_FAULT_TIMEOUT 0x08 // DOUT never went low, the amplifier isn't responding
+#define SG_FAULT_NOISY 0x10 // implausible noise (intermittent connection or broken shield)
+#define SG_FAULT_READ 0x20 // the backend couldn't read the conversion (bus error), see SG_RAW_INVALID
+
+// gravity
+#define SG_STANDARD_GRAVITY 9.80665f // m/s^2
+
+// zero setting
+#define SG_ZERO_RANGE 0.02f // fraction of capacity a zero can remove, bigger offsets need a tare
+
+// events, defaults for SG_PARAM_STABLE_BAND and SG_PARAM_STABLE_TIME_MS
+#define SG_STABLE_BAND 0.005f // kg, readings within this band of the running average count as stable
+#define SG_STABLE_TIME_MS 800 // how long readings have to stay inside the band before reporting stable
+
+// parameters
+#define SG_PARAM_RECORD_SIZE 6 // exported bytes per parameter, 16 bit id then 32 bit value, little endian
+
+// status codes returned by the timeout bounded calls
+typedef enum {
+    SG_OK = 0,
+    SG_ERR_TIMEOUT, // no sample before the deadline, SG_FAULT_TIMEOUT is set
+    SG_ERR_FAULT, // a sample arrived but a bridge fault is set, see strain_gauge_get_faults()
+    SG_BUSY, // non-blocking call, nothing to report yet
+    SG_ERR_BUSY, // a tare or calibration is already running
+    SG_ERR_INVALID, // bad argument, degenerate calibration data or a corrupted calibration set
+    SG_ERR_FULL, // the attached audit log is full, the change wasn't made
+}sg_status_t;
+
+// driver modes, what every reader gets in each mode is documented on the value
+typedef enum {
+    SG_MODE_IDLE = 0, // initialized, nothing read yet. Reads work and move to measuring.
+    SG_MODE_MEASURING, // reads return calibrated weights
+    SG_MODE_TARING, // a tare is averaging. Other reads return weights with the old offset.
+    SG_MODE_CALIBRATING, // a calibration is running. Other reads return weights with the old equation.
+    SG_MODE_FAULT, // the last sample had a bridge fault. Reads return NAN until a healthy sample.
+}sg_mode_t;
+
+// events dispatched from the acquisition path
+typedef enum {
+    SG_EVENT_RISING = 0, // weight rose through a threshold
+    SG_EVENT_FALLING, // weight fell below a threshold minus its hysteresis
+    SG_EVENT_STABLE, // readings settled
+    SG_EVENT_UNSTABLE, // readings started moving
+    SG_EVENT_OVERLOAD, // weight went above capacity
+    SG_EVENT_TARE_COMPLETE, // tare finished, weight is the new offset
+    SG_EVENT_FAULT, // fault codes changed, see strain_gauge_get_faults()
+    SG_EVENT_VALID, // startup finished, readings can be trusted
+}sg_event_t;
+
+#define SG_EVENT_MASK(event) (1u << (event)) // mask bit for strain_gauge_subscribe()
+
+/*
+    @brief Event handler
+
+    @note Runs in the context of whatever read triggered it, keep it short and don't read the
+	strain gauge from it
+
+    @param[in] event Event that happened
+
+    @param[in] weight Weight that caused the event, NAN for SG_EVENT_FAULT
+
+    @param[in] context Pointer passed in when registering
+*/
+typedef void (*sg_event_handler_t)(sg_event_t event, float weight, void * context);
+
+// what a job does with its average
+#define SG_JOB_AVERAGE 0 // nothing, result is the average weight
+#define SG_JOB_TARE 1 // set it as the tare offset
+#define SG_JOB_ZERO 2 // set it as the tare offset if it's within SG_ZERO_RANGE
+#define SG_JOB_CAL_POINT 3 // add it as a calibration point
+
+// non-blocking average or tare, advanced by strain_gauge_job_poll()
+typedef struct {
+    float sum; // sum of the samples so far
+    float result; // average, valid once status is SG_OK
+    float known_weight; // SG_JOB_CAL_POINT only, the weight on the load cell
+    uint8_t times; // samples to average
+    uint8_t count; // samples taken so far
+    uint8_t kind; // SG_JOB_ kind
+    sg_status_t status; // SG_BUSY until the job finishes
+}SgAverageJob;
+
+// parameter ids, the numbers are part of the export format so new ones go at the end
+typedef enum {
+    SG_PARAM_TARE_SAMPLES = 0, // samples averaged for a tare
+    SG_PARAM_CAL_SAMPLES, // samples averaged per calibration point
+    SG_PARAM_CAL_SETTLE_MS, // time given to put each calibration weight on
+    SG_PARAM_SAMPLE_TIMEOUT_MS, // per sample deadline for the calls that don't take one
+    SG_PARAM_STABLE_BAND, // kg, see SG_STABLE_BAND
+    SG_PARAM_STABLE_TIME_MS, // see SG_STABLE_TIME_MS
+    SG_PARAM_OVERLOAD, // kg, SG_EVENT_OVERLOAD level, 0 for the load cell capacity
+    SG_PARAM_FILTER, // sg_filter_t used by strain_gauge_read()
+    SG_PARAM_FILTER_LENGTH, // samples for SG_FILTER_AVERAGE
+    SG_PARAM_UNITS, // sg_units_t returned by strain_gauge_read()
+    SG_PARAM_DIVISION, // display division in units, strain_gauge_read() rounds to it, 0 for none
+    SG_PARAM_OVERSAMPLE_BITS, // extra bits for SG_FILTER_OVERSAMPLE, up to SG_READ_MAX_OVERSAMPLE_BITS
+    SG_PARAM_COUNT
+}sg_param_id_t;
+
+// parameter value types
+typedef enum {
+    SG_PARAM_TYPE_U32 = 0,
+    SG_PARAM_TYPE_FLOAT,
+}sg_param_type_t;
+
+// parameter value, the member is set by the parameter's type
+typedef union {
+    uint32_t u32;
+    float f;
+}sg_param_value_t;
+
+// parameter description, min and max are inclusive
+typedef struct {
+    const char * name;
+    sg_param_type_t type;
+    sg_param_value_t min;
+    sg_param_value_t max;
+    sg_param_value_t def;
+}SgParamInfo;
+
+// filters for strain_gauge_read()
+typedef enum {
+    SG_FILTER_NONE = 0, // one sample, read_kgs()
+    SG_FILTER_AVERAGE, // average of SG_PARAM_FILTER_LENGTH samples, read_average()
+    SG_FILTER_OVERSAMPLE, // SG_PARAM_OVERSAMPLE_BITS extra bits, read_kgs_oversampled()
+}sg_filter_t;
+
+// units for strain_gauge_read()
+typedef enum {
+    SG_UNITS_KG = 0,
+    SG_UNITS_LB,
+    SG_UNITS_G,
+}sg_units_t;
+
+// adc front end, anything that gives signed raw counts of the bridge voltage can plug in here
+#define SG_RAW_INVALID INT32_MIN // read_raw() result for a failed read, no adc count is this far out
+
+typedef struct {
+    const char * name;
+    bool (*is_ready)(void); // a conversion is ready to read
+    int32_t (*read_raw)(void); // read a conversion, sign extended raw count, SG_RAW_INVALID if the read failed
+    float sample_rate; // conversions per second
+    uint8_t resolution_bits; // bits per conversion including sign
+    float full_scale; // input range at gain 1 as a fraction of VE, +-0.5 for the hx711 with AVDD = VE
+    uint16_t gain; // pga gain
+}StrainGaugeBackend;
+
+extern const StrainGaugeBackend hx711_backend; // default, hx711 channel A, gain 128, 10 SPS
 
 // load cell specification
 typedef struct {
     uint16_t capacity; // capacity in kg
     float VE; // excitation voltage V
     float RO; // rated output mV/V
-    float offset; // offset used for taring
+    volatile uint8_t faults; // SG_FAULT_ bits from the last diagnosed sample
+    volatile uint8_t mode; // sg_mode_t, only changed with atomic transitions
 }StrainGauge;
 
+// everything the conversion uses, swapped as a whole so a reader never sees half an update
+typedef struct {
+    float slope; // line of best fit slope
+    float intercept; // line of best fit intercept
+    float offset; // offset used for taring
+    float scale; // kg per mV, capacity/(VE*RO) with the gravity correction folded in
+    float gravity; // calibration site g / installation site g folded into scale, 1 for none
+    uint32_t version; // bumped on every change
+    uint32_t crc; // crc32 of everything above, set by strain_gauge_get_calibration()
+}CalibrationSet;
+
+// oversampling / decimation accumulator
+typedef struct {
+    int64_t acc; // sum of raw counts in the current window
+    uint32_t count; // samples accumulated in the current window
+    uint8_t extra_bits; // bits of resolution gained, window is 4^extra_bits samples
+}Oversampler;
+
 /*
     @brief Strain Gauge Initialization
 
@@ -37,21 +252,222 @@ typedef struct {
 */
 void strain_gauge_init(float ve, uint16_t capacity, float ro);
 
+/*
+    @brief Calculate local gravity from location
+
+    @note International gravity formula (GRS80) with the free air correction for altitude,
+	good to a few parts in 10^5 which is well inside a scale's tolerance
+
+    @param[in] latitude Latitude in degrees
+
+    @param[in] altitude Height above sea level in m
+
+    @ret Local gravity in m/s^2
+*/
+float strain_gauge_gravity(float latitude, float altitude);
+
+/*
+    @brief Set the gravity correction for a relocated scale
+
+    @note A load cell measures force, so the same mass reads g_site/g_calibration heavier at the
+	installation site. The correction is folded into the conversion coefficient, so it costs
+	nothing per sample. It replaces the previous correction rather than adding to it, and
+	is kept in the CalibrationSet, so it survives a restart. Pass the same value twice for
+	no correction.
+
+    @param[in] g_calibration Gravity where the scale was calibrated, m/s^2
+
+    @param[in] g_site Gravity where the scale is installed, m/s^2
+
+    @ret SG_OK, SG_ERR_INVALID for a g that isn't positive, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_set_gravity(float g_calibration, float g_site);
+
+/*
+    @brief Select the adc front end
+
+    @note The stability detection, oversampling limits and diagnostics adapt to the backend's
+	sample rate and resolution. The backend has to stay valid while it's in use, copy
+	hx711_backend and change sample_rate if the hx711 RATE pin is set for 80 SPS.
+
+    @param[in] backend Adc front end
+*/
+void strain_gauge_set_backend(const StrainGaugeBackend * backend);
+
+/*
+    @brief Function for reading the sample rate of the selected backend
+
+    @ret Conversions per second
+*/
+float strain_gauge_sample_rate(void);
+
 /*
     @brief Function for reading kilogram measurement from strain gauge
 
-    @note Calculates kilograms based on load cell specifications, line of best fit, and tare offset
+    @note Calculates kilograms based on load cell specifications, line of best fit, and tare offset.
+	Waits up to SG_PARAM_SAMPLE_TIMEOUT_MS for the amplifier, see read_kgs_timeout().
 
-    @ret Current kilogram measurement (float)
+    @ret Current kilogram measurement (float), NAN if a bridge fault is detected or no conversion
+	arrived in time (SG_FAULT_TIMEOUT is set)
 */
 float read_kgs(void);
 
+/*
+    @brief Function for reading kilogram measurement with a deadline
+
+    @note Waits for the amplifier to have a conversion ready before reading it, so a dead amplifier
+	fails this call instead of hanging in the adc driver
+
+    @param[in] timeout_ms How long to wait for a conversion
+
+    @param[out] kgs Kilogram measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t read_kgs_timeout(uint32_t timeout_ms, float * kgs);
+
+/*
+    @brief Set a hook called while waiting for a sample
+
+    @note Called every SG_WAIT_POLL_US while a read is waiting, use it to feed a watchdog or yield
+
+    @param[in] hook Function to call, NULL to disable
+*/
+void strain_gauge_set_wait_hook(void (*hook)(void));
+
+/*
+    @brief Set the millisecond clock
+
+    @note Timestamps conversions for motion compensation. Use the same clock as the imu
+	timestamps, e.g. an rtc or systick counter. It can wrap.
+
+    @param[in] millis Function returning ms since power on, NULL for none
+*/
+void strain_gauge_set_clock(uint32_t (*millis)(void));
+
+/*
+    @brief Function for reading the current mode
+
+    @ret sg_mode_t the driver is in
+*/
+sg_mode_t strain_gauge_get_mode(void);
+
+/*
+    @brief Function for reading the current fault codes
+
+    @note Every sample is checked for rail, stuck and noise signatures as it's read. While any
+	fault is set, read_kgs() and the functions built on it return NAN instead of a weight.
+
+    @ret SG_FAULT_ bits, SG_FAULT_NONE if the bridge looks healthy
+*/
+uint8_t strain_gauge_get_faults(void);
+
+#if SG_USE_THRESHOLDS
+/*
+    @brief Register a weight threshold
+
+    @note Thresholds are kept sorted by level so each sample only visits the thresholds between
+	the previous and current weight, the cost doesn't grow with the number registered.
+	SG_EVENT_RISING fires when the weight reaches level, SG_EVENT_FALLING when it drops
+	below level - hysteresis.
+
+    @param[in] level Threshold weight in kg
+
+    @param[in] hysteresis Band below level the weight has to fall through to re-arm, in kg
+
+    @param[in] handler Called with SG_EVENT_RISING and SG_EVENT_FALLING
+
+    @param[in] context Passed to handler
+
+    @ret Threshold id, -1 if the table is full
+*/
+int8_t strain_gauge_add_threshold(float level, float hysteresis, sg_event_handler_t handler, void * context);
+
+/*
+    @brief Remove a weight threshold
+
+    @param[in] id Id returned by strain_gauge_add_threshold()
+
+    @ret true if the threshold was found and removed
+*/
+bool strain_gauge_remove_threshold(int8_t id);
+#endif
+
+/*
+    @brief Subscribe to state change events
+
+    @param[in] event_mask SG_EVENT_MASK() bits of the events wanted
+
+    @param[in] handler Called for each event in the mask
+
+    @param[in] context Passed to handler
+
+    @ret true if subscribed, false if the table is full
+*/
+bool strain_gauge_subscribe(uint32_t event_mask, sg_event_handler_t handler, void * context);
+
+#if SG_USE_MULTIRATE
+/*
+    @brief Attach a multirate fan out stage to the sample stream
+
+    @note Every conversion read through read_kgs(), strain_gauge_poll() or strain_gauge_read()
+	is pushed into the stage. A faulted sample is pushed as NAN, which the stage replaces
+	with the last good sample, so the output rates stay locked to the sample rate.
+	Oversampled, raw, taring and calibrating reads aren't pushed.
+
+    @param[in] mr Stage to attach, NULL to detach
+*/
+void strain_gauge_attach_multirate(Multirate * mr);
+#endif
+
+#if SG_USE_MOTION_COMP
+/*
+    @brief Attach a motion compensation stage
+
+    @note Every conversion is corrected with the acceleration at the time it was read. The
+	gross weight from the calibration line is corrected, after the intercept has taken
+	off the bridge's electrical zero and before the tare is taken off, so the inertial
+	force on the container and any other dead load is removed too and tares taken on the
+	move are corrected the same way. Calibration points are captured uncorrected, there's
+	no line to take the zero off yet. Needs strain_gauge_set_clock(). A conversion
+	without imu data for it reads as NAN.
+
+    @param[in] mc Initialized stage, fed with motion_comp_push_imu(), NULL to detach
+*/
+void strain_gauge_attach_motion_comp(MotionComp * mc);
+#endif
+
+#if SG_USE_AUDIT_LOG
+/*
+    @brief Attach an audit log
+
+    @note Equation, gravity, tare and parameter changes are appended to the log as they're
+	made. While the log is full they are refused with SG_ERR_FULL, so every change is
+	in the log, until the records are exported and released with audit_log_release().
+
+    @param[in] log Initialized (or restored) log, NULL to stop logging
+*/
+void strain_gauge_attach_audit_log(AuditLog * log);
+#endif
+
+#if SG_USE_STATS
+/*
+    @brief Attach a statistics accumulator to the sample stream
+
+    @note Every weight read through read_kgs() is pushed, faulted samples are skipped. Call
+	stats_reset() on it at the start of each batch.
+
+    @param[in] st Initialized accumulator, NULL to detach
+*/
+void strain_gauge_attach_stats(Stats * st);
+#endif
+
 /*
     @brief Function for reading pound measurement from strain gauge
 
-    @note Calculates pounds based on kilogram measurement
+    @note Calculates pounds based on kilogram measurement, with the same deadline as read_kgs()
 
-    @ret Current pound measurement (float)
+    @ret Current pound measurement (float), NAN like read_kgs()
 */
 float read_lbs(void);
 
@@ -59,47 +475,354 @@ float read_lbs(void);
     @brief Function for reading an average measurement
 
     @note Uses the external read_sg flag that's set on a timer interrupt to call read_kgs()
-	so that there are no timing issues, and no delays are used
+	so that there are no timing issues. Each sample gets SG_PARAM_SAMPLE_TIMEOUT_MS to arrive.
 
     @param[in] times How many times to sample the strain gauge for the average
 
-    @ret Average kg measurement
+    @ret Average kg measurement, NAN if a sample timed out or a bridge fault is detected
 */
 float read_average(uint8_t times);
 
+/*
+    @brief Function for reading an average measurement with a deadline
+
+    @note Same as read_average(), but the whole average has to complete within timeout_ms
+
+    @param[in] times How many times to sample the strain gauge for the average
+
+    @param[in] timeout_ms Deadline for the whole average
+
+    @param[out] average Average kg measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT, SG_ERR_FAULT or SG_ERR_INVALID if times is 0
+*/
+sg_status_t read_average_timeout(uint8_t times, uint32_t timeout_ms, float * average);
+
+/*
+    @brief Initialize an oversampler
+
+    @note Averaging 4^k samples of white noise gains k bits of resolution, so the window length
+	is derived from the number of extra bits wanted
+
+    @param[in] os Oversampler to initialize
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS, less for adcs over 24 bits)
+*/
+void oversampler_init(Oversampler * os, uint8_t extra_bits);
+
+/*
+    @brief Push a raw count into an oversampler
+
+    @note Integer accumulate and dump (first order CIC), the arithmetic is exact. The output has
+	the backend's resolution_bits + extra_bits bits of resolution and is produced once every 4^extra_bits samples.
+
+    @param[in] os Oversampler
+
+    @param[in] raw Raw adc count
+
+    @param[out] out Decimated count, only written when a window completes
+
+    @ret true if a new output was written to out
+*/
+bool oversampler_push(Oversampler * os, int32_t raw, int32_t * out);
+
+/*
+    @brief Function for reading an oversampled raw measurement
+
+    @note Uses the read_sg flag like read_average(), blocks for 4^extra_bits samples
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS, less for adcs over 24 bits)
+
+    @param[in] timeout_ms Deadline for the whole window
+
+    @param[out] out Decimated count with resolution_bits + extra_bits bits of resolution, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
+*/
+sg_status_t read_raw_oversampled(uint8_t extra_bits, uint32_t timeout_ms, int32_t * out);
+
+/*
+    @brief Function for reading an oversampled kilogram measurement
+
+    @note Same calibration path as read_kgs(), but fed from read_raw_oversampled()
+
+    @param[in] extra_bits Bits of resolution to gain (0 to SG_MAX_OVERSAMPLE_BITS, less for adcs over 24 bits)
+
+    @ret Oversampled kg measurement, NAN if a sample timed out or a bridge fault is detected
+*/
+float read_kgs_oversampled(uint8_t extra_bits);
+
+/*
+    @brief Capture a stream of raw measurements
+
+    @note Uses the read_sg flag like read_average(), no conversion is done so the buffer can be
+	passed straight to the noise_analysis functions or logged for analysis on a host
+
+    @param[out] samples Buffer to fill with raw adc counts
+
+    @param[in] n Number of samples to capture
+
+    @param[in] timeout_ms Deadline for the whole capture
+
+    @ret SG_OK, SG_ERR_TIMEOUT, or SG_ERR_FAULT if the backend failed to read a conversion.
+	Raw captures aren't diagnosed otherwise so bridge faults can be analysed.
+*/
+sg_status_t strain_gauge_capture_raw(int32_t * samples, uint32_t n, uint32_t timeout_ms);
+
+#if SG_USE_RAW_RING
+/*
+    @brief Read a raw sample into the ring
+
+    @note Call from the data ready or timer isr instead of setting read_sg when using
+	strain_gauge_acquire(). If the ring is full the sample is dropped and counted.
+*/
+void strain_gauge_raw_isr(void);
+
+/*
+    @brief Put a raw sample into the ring
+
+    @note For backends that already have the count, e.g. from a dma transfer. Isr safe, one
+	producer only. SG_RAW_INVALID isn't stored, it sets SG_FAULT_READ.
+
+    @param[in] raw Raw adc count
+*/
+void strain_gauge_push_raw(int32_t raw);
+
+/*
+    @brief Acquire raw samples in bulk
+
+    @note Copies straight out of the ring into buf with no per-sample calls or conversions,
+	waiting for more samples until the deadline if the ring runs dry
+
+    @param[out] buf Buffer for the raw adc counts
+
+    @param[in] n Number of samples wanted
+
+    @param[in] timeout_ms Deadline for all n samples
+
+    @param[out] acquired Number of samples written to buf, can be less than n on a timeout
+
+    @ret SG_OK or SG_ERR_TIMEOUT
+*/
+sg_status_t strain_gauge_acquire(int32_t * buf, size_t n, uint32_t timeout_ms, size_t * acquired);
+
+/*
+    @brief Function for reading how many raw samples were dropped because the ring was full
+
+    @ret Dropped sample count since init
+*/
+uint32_t strain_gauge_raw_overruns(void);
+#endif
+
 /*
     @brief Tare the strain gauge
 
     @note Calculates the average measurement and sets that as the offset to get the reading to 0.
+	The offset is left alone if the average fails.
 */
 void strain_gauge_tare(void);
 
+/*
+    @brief Tare the strain gauge with a deadline
+
+    @note Same as strain_gauge_tare(), the offset is only changed on SG_OK
+
+    @param[in] timeout_ms Deadline for the tare average
+
+    @ret SG_OK, SG_ERR_TIMEOUT, SG_ERR_FAULT, SG_ERR_BUSY if a tare or calibration is running, or
+	SG_ERR_FULL
+*/
+sg_status_t strain_gauge_tare_timeout(uint32_t timeout_ms);
+
+/*
+    @brief Take a sample if one is ready, without waiting
+
+    @note Returns straight away if the read_sg flag isn't set or the amplifier isn't ready, so it
+	can be called from a main loop or an event loop instead of blocking in read_average()
+
+    @param[out] kgs Kilogram measurement, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_FAULT, or SG_BUSY if no sample was ready
+*/
+sg_status_t strain_gauge_poll(float * kgs);
+
+/*
+    @brief Function for checking if the readings are stable
+
+    @note Uses the same detection as SG_EVENT_STABLE
+
+    @ret true if the readings have been within SG_PARAM_STABLE_BAND for SG_PARAM_STABLE_TIME_MS
+*/
+bool strain_gauge_is_stable(void);
+
+/*
+    @brief Start a non-blocking average
+
+    @param[out] job Job to start
+
+    @param[in] times How many times to sample the strain gauge for the average
+*/
+void strain_gauge_average_start(SgAverageJob * job, uint8_t times);
+
+/*
+    @brief Start a non-blocking tare
+
+    @note Same as strain_gauge_tare(), but advanced by strain_gauge_job_poll(). The job's status
+	is SG_ERR_BUSY if a tare or calibration is already running.
+
+    @param[out] job Job to start
+*/
+void strain_gauge_tare_start(SgAverageJob * job);
+
+/*
+    @brief Start a non-blocking zero
+
+    @note Like a tare, but only for removing drift from an empty scale: the job finishes with
+	SG_ERR_INVALID and the offset unchanged if the untared reading is more than
+	SG_ZERO_RANGE of the capacity away from the calibrated zero
+
+    @param[out] job Job to start
+*/
+void strain_gauge_zero_start(SgAverageJob * job);
+
+/*
+    @brief Advance a non-blocking average or tare
+
+    @note Takes at most one sample per call and never waits. Only run one job at a time, they
+	share the one sample stream.
+
+    @param[in] job Job to advance
+
+    @ret SG_BUSY while sampling, then SG_OK, SG_ERR_FAULT, SG_ERR_INVALID for a zero out of
+	range, or SG_ERR_FULL for a tare or zero the audit log has no room for
+*/
+sg_status_t strain_gauge_job_poll(SgAverageJob * job);
+
+/*
+    @brief Abandon a non-blocking average or tare
+
+    @note Needed for a tare or zero that won't be polled to the end, so the driver leaves taring
+	mode
+
+    @param[in] job Job to cancel
+*/
+void strain_gauge_job_cancel(SgAverageJob * job);
+
 /*
     @brief Calibrate the strain gauge with known weights
 
     @note Takes an array of known weight values, and calculates a line of best fit equation using
 	the known weights as y data and the measured averages per weight as x data. 
+	Does nothing if a tare or calibration is already running. The points are kept in a
+	static workspace of SG_MAX_CAL_POINTS + 1 entries, so the stack use is a fixed few
+	dozen bytes whatever weight_cnt is.
 
-    @param[in] weight_cnt Number of known weights
+    @param[in] weight_cnt Number of known weights (1 to SG_MAX_CAL_POINTS)
 
     @param[in] known_weights Float array of known weight values
 
-    @param[in] equation Pointer to a float array to populate with calibration factors
+    @param[in] equation Pointer to a float array to populate with calibration factors, only
+	written on SG_OK
+
+    @ret SG_OK, SG_ERR_BUSY, SG_ERR_TIMEOUT or SG_ERR_FAULT if an average failed, or
+	SG_ERR_INVALID if weight_cnt is out of range or the points don't define a line
 */
-void strain_gauge_calibrate(uint8_t weight_cnt, float * known_weights, float * equation);
+sg_status_t strain_gauge_calibrate(uint8_t weight_cnt, float * known_weights, float * equation);
+
+/*
+    @brief Start a step by step calibration
+
+    @note For calibrating remotely or from a ui, one point at a time. Enters calibrating mode
+	until strain_gauge_cal_commit() succeeds or strain_gauge_cal_abort() is called.
+
+    @ret SG_OK, or SG_ERR_BUSY if a tare or calibration is already running
+*/
+sg_status_t strain_gauge_cal_begin(void);
+
+/*
+    @brief Start capturing a calibration point
+
+    @note Averages SG_PARAM_CAL_SAMPLES samples, advanced by strain_gauge_job_poll(). Capture
+	the empty load cell as a point with known weight 0 too.
+
+    @param[out] job Job to start, its status is SG_ERR_INVALID if no calibration was begun or
+	SG_MAX_CAL_POINTS + 1 points are already captured
+
+    @param[in] known_weight Weight on the load cell in kg
+*/
+void strain_gauge_cal_point_start(SgAverageJob * job, float known_weight);
+
+/*
+    @brief Fit and apply the captured calibration points
+
+    @note Ends the calibration on success. On failure the points are kept so more can be
+	captured or the calibration aborted.
+
+    @param[out] equation Slope and intercept, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_INVALID if no calibration was begun, there are fewer than 2 points or
+	they don't define a line, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_cal_commit(float * equation);
+
+/*
+    @brief Abandon a step by step calibration, the calibration in use is kept
+*/
+void strain_gauge_cal_abort(void);
 
 /*
     @brief Calculate the line of best fit equation given x and y data points
 
+    @note The zero point plus the known weights, so x and y hold weight_cnt + 1 points. The
+	sums are taken about the means, and points whose x spread is within SG_CAL_MIN_SPREAD
+	of rounding are rejected instead of giving a meaningless slope.
+
     @param[in] weight_cnt Number of known weights
 
     @param[in] x X data points, should be measured averages
 
     @param[in] y Y data points, should be known weights
 
-    @param[in] equation Pointer to a float array to populate with calibration factors
+    @param[in] equation Pointer to a float array to populate with calibration factors, only
+	written on SG_OK
+
+    @ret SG_OK, or SG_ERR_INVALID if a point isn't finite or the x are (nearly) all the same
 */
-void strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, float * equation);
+sg_status_t strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, float * equation);
+
+/*
+    @brief Get a consistent copy of the calibration in use
+
+    @note The copy is sealed with a crc, so it can be persisted and restored as is
+
+    @param[out] cal Calibration set
+*/
+void strain_gauge_get_calibration(CalibrationSet * cal);
+
+/*
+    @brief Seal a calibration set built by hand
+
+    @note Sets the crc, strain_gauge_get_calibration() already does this
+
+    @param[in,out] cal Calibration set
+*/
+void strain_gauge_seal_calibration(CalibrationSet * cal);
+
+/*
+    @brief Replace the whole calibration in one swap
+
+    @note Use this to restore a saved calibration. The version is set by the driver, the one in
+	cal is ignored. A set with a bad crc, a value that isn't finite or a scale that isn't
+	positive is rejected and the calibration in use is kept. The restore is logged as
+	an AUDIT_EQUATION record, followed by an AUDIT_TARE, AUDIT_GRAVITY and AUDIT_SCALE
+	record for each of those that changed, and it's refused if the audit log hasn't room
+	for all of them.
+
+    @param[in] cal Calibration set
+
+    @ret true if the set was valid and swapped in
+*/
+bool strain_gauge_set_calibration(const CalibrationSet * cal);
 
 /*
     @brief Set line of best fit equation
@@ -109,8 +832,149 @@ void strain_gauge_calculate_equation(uint8_t weight_cnt, float * x, float * y, f
     @param[in] m Slope for line of best fit equation
 
     @param[in] b Intercept for line of best fit equation
+
+    @ret SG_OK, SG_ERR_INVALID if m or b isn't finite, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_set_equation(float m, float b);
+
+
+/*
+    @brief Bring the strain gauge up to its first valid reading
+
+    @note Call after strain_gauge_init(). Loads the persisted calibration and tare, throws away
+	the first SG_STARTUP_DISCARD conversions from the cold amplifier, then prefills the
+	stability window from a burst of SG_PARAM_STABLE_TIME_MS of conversions and reads on
+	until the readings are stable. Startup reads as fast as the adc converts, without
+	waiting for read_sg, and returns as soon as the readings are stable instead of the
+	application waiting a fixed time.
+
+    @param[in] persisted Calibration saved with strain_gauge_get_calibration(), NULL to keep
+	the current one. Restoring it isn't an audit log event.
+
+    @param[in] timeout_ms Deadline for the whole startup
+
+    @ret SG_OK once valid, SG_ERR_TIMEOUT if the readings didn't settle in time, or
+	SG_ERR_INVALID if the persisted calibration is corrupted (the current one is kept)
+*/
+sg_status_t strain_gauge_startup(const CalibrationSet * persisted, uint32_t timeout_ms);
+
+/*
+    @brief Function for checking if startup has finished
+
+    @ret true once strain_gauge_startup() has seen stable readings
+*/
+bool strain_gauge_is_valid(void);
+
+/*
+    @brief Function for reading how long startup took
+
+    @note Read from the strain_gauge_set_clock() clock, so it's measured from power on and
+	includes everything before strain_gauge_startup(). Without a clock it's estimated
+	from the conversions startup read.
+
+    @ret Time from power on to the first valid reading in ms, 0 if not valid yet
+*/
+uint32_t strain_gauge_boot_latency_ms(void);
+
+#if SG_USE_WARMUP
+/*
+    @brief Set the warm-up drift compensation
+
+    @note The drift the model predicts is taken off every converted reading, so readings are
+	usable straight after power on. Needs strain_gauge_set_clock(), time since power on is
+	read from it, so it doesn't matter how often readings are taken. Raw captures and the raw ring aren't compensated, so power up logs can be recorded
+	with strain_gauge_capture_raw() and fitted with warmup_model_fit().
+
+    @param[in] model Fitted model, NULL to turn compensation off
+*/
+void strain_gauge_set_warmup(const WarmupModel * model);
+#endif
+
+/*
+    @brief Function for reading the description of a parameter
+
+    @param[in] id sg_param_id_t
+
+    @ret Description, NULL if the id is unknown
+*/
+const SgParamInfo * strain_gauge_param_info(uint16_t id);
+
+/*
+    @brief Function for reading a parameter
+
+    @param[in] id sg_param_id_t
+
+    @param[out] value Current value
+
+    @ret SG_OK or SG_ERR_INVALID if the id is unknown
+*/
+sg_status_t strain_gauge_param_get(uint16_t id, sg_param_value_t * value);
+
+/*
+    @brief Set a parameter
+
+    @note Takes effect from the next sample. Changes are appended to the audit log as
+	AUDIT_CONFIG records with the id and the value as floats.
+
+    @param[in] id sg_param_id_t
+
+    @param[in] value New value, of the parameter's type
+
+    @ret SG_OK, SG_ERR_INVALID if the id is unknown or the value is out of range, or SG_ERR_FULL
+*/
+sg_status_t strain_gauge_param_set(uint16_t id, sg_param_value_t value);
+
+/*
+    @brief Reset every parameter to its default
+
+    @note strain_gauge_init() does this, import saved parameters after init
+*/
+void strain_gauge_param_defaults(void);
+
+/*
+    @brief Export every parameter
+
+    @note SG_PARAM_COUNT records of SG_PARAM_RECORD_SIZE bytes, so the buffer doesn't depend on
+	the struct layout of either end of a serial link
+
+    @param[out] buf Buffer for the records
+
+    @param[in] len Size of buf, at least SG_PARAM_COUNT * SG_PARAM_RECORD_SIZE
+
+    @ret Bytes written, 0 if buf is too small
+*/
+size_t strain_gauge_param_export(uint8_t * buf, size_t len);
+
+/*
+    @brief Import parameters
+
+    @note All or nothing: every record is checked before any is applied. Parameters without a
+	record keep their value, so a partial set can be imported.
+
+    @param[in] buf Records from strain_gauge_param_export() or built to the same format
+
+    @param[in] len Size of buf, a multiple of SG_PARAM_RECORD_SIZE
+
+    @ret SG_OK, SG_ERR_INVALID if a record is malformed, unknown or out of range, or SG_ERR_FULL
+	if the audit log hasn't room for a record per parameter
+*/
+sg_status_t strain_gauge_param_import(const uint8_t * buf, size_t len);
+
+/*
+    @brief Read the weight the way the parameters say
+
+    @note Filtered with SG_PARAM_FILTER, averaging SG_PARAM_FILTER_LENGTH samples or
+	oversampling by SG_PARAM_OVERSAMPLE_BITS, converted to SG_PARAM_UNITS and rounded to
+	SG_PARAM_DIVISION
+
+    @param[out] value Weight, only written on SG_OK
+
+    @ret SG_OK, SG_ERR_TIMEOUT or SG_ERR_FAULT
 */
-void strain_gauge_set_equation(float m, float b);
+sg_status_t strain_gauge_read(float * value);
 
+#ifdef __cplusplus
+}
+#endif
 
-#endif // STRAIN_GUAGE_H
\ No newline at end of file
+#endif // STRAIN_GUAGE_H
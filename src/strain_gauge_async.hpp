@@ -0,0 +1,447 @@
+/* ****************************************************************************/
+/** Strain Guage Async Library
+
+  @File Name
+    strain_gauge_async.hpp
+
+  @Summary
+    C++20 coroutine layer over the non-blocking strain guage calls, for host builds
+
+  @Description
+    Lets gateway services co_await readings, averages and tares instead of blocking a
+    thread in read_average() / strain_gauge_tare(). Suspended coroutines are parked on the
+    Source they wait for and only polled when it signals, so one thread can service
+    thousands of channels (test/bench_async.cpp). The driver has one strain gauge instance,
+    so only one coroutine should be reading it at a time, they share the same sample stream.
+******************************************************************************/
+
+#ifndef STRAIN_GUAGE_ASYNC_HPP
+#define STRAIN_GUAGE_ASYNC_HPP
+
+#include "strain_gauge.h"
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace strain_gauge {
+
+using Clock = std::chrono::steady_clock;
+
+// result of an awaited read
+struct Reading {
+    sg_status_t status; // SG_OK, SG_ERR_FAULT or SG_ERR_TIMEOUT
+    float kgs; // only valid on SG_OK
+};
+
+class Executor;
+class Source;
+
+/*
+    @brief A suspended coroutine and what it's waiting for
+
+    @note Kept in the awaiter, so in the coroutine frame, and linked into its source and the
+	executor's deadlines while suspended. No allocation per wait.
+*/
+class Parked {
+public:
+    // true once the coroutine can carry on, only called from the executor thread
+    virtual bool poll() = 0;
+    virtual ~Parked() = default;
+
+protected:
+    bool timed_out_ = false;
+
+private:
+    friend class Executor;
+    std::coroutine_handle<> handle_;
+    Source * parked_on_ = nullptr; // null when not parked
+    size_t index_ = 0; // position in parked_on_->parked_
+    std::multimap<Clock::time_point, Parked *>::iterator deadline_;
+};
+
+/*
+    @brief Something coroutines wait on, e.g. one channel's data ready or sample timer
+
+    @note Its parked coroutines are only polled after notify(), or every interval for sources
+	that can't signal. notify() may be called from any thread. Nothing may be parked on the
+	source when it's destroyed.
+*/
+class Source {
+public:
+    explicit Source(Executor & ex, Clock::duration interval = Clock::duration::zero())
+	: ex_(ex), interval_(interval) {}
+    Source(const Source &) = delete;
+    Source & operator=(const Source &) = delete;
+    ~Source();
+
+    // something changed, poll what's parked here on the next round
+    void notify();
+
+    Executor & executor() const { return ex_; }
+
+private:
+    friend class Executor;
+    Executor & ex_;
+    Clock::duration interval_;
+    std::vector<Parked *> parked_;
+    bool signaled_ = false; // guarded by the executor's mutex
+    bool interval_armed_ = false;
+};
+
+/*
+    @brief Single-threaded executor
+
+    @note Each round resumes the coroutines that are ready, then polls only the sources that
+	signaled or whose interval came up, then times out the waits past their deadline.
+	run() sleeps between rounds until a source signals or the next deadline, so a thousand
+	idle channels cost nothing.
+*/
+class Executor {
+public:
+    Executor() = default;
+    Executor(const Executor &) = delete;
+    Executor & operator=(const Executor &) = delete;
+
+    // resume h on the next round
+    void schedule(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+    // park h on source until p.poll() returns true or the deadline passes
+    void park(Source & source, Parked & p, std::coroutine_handle<> h, Clock::time_point deadline) {
+	p.handle_ = h;
+	p.parked_on_ = &source;
+	p.timed_out_ = false;
+	p.index_ = source.parked_.size();
+	source.parked_.push_back(&p);
+	p.deadline_ = deadlines_.emplace(deadline, &p);
+	arm(source, Clock::now());
+    }
+
+    // take p off its source without resuming it, for a frame destroyed while suspended
+    void cancel(Parked & p) {
+	if(p.parked_on_ != nullptr)
+	    unlink(p);
+    }
+
+    // poll source on the next round, safe from any thread
+    void signal(Source & source) {
+	{
+	    std::lock_guard<std::mutex> lock(mutex_);
+	    if(source.signaled_)
+		return;
+	    source.signaled_ = true;
+	    signaled_.push_back(&source);
+	}
+	wake_.notify_one();
+    }
+
+    // run one round, returns false when there is nothing left to do
+    bool run_once() {
+	std::vector<std::coroutine_handle<>> ready;
+	ready.swap(ready_);
+	for(auto h : ready)
+	    h.resume();
+	{
+	    std::lock_guard<std::mutex> lock(mutex_);
+	    polling_.swap(signaled_);
+	    for(Source * s : polling_)
+		s->signaled_ = false;
+	}
+	Clock::time_point now = Clock::now();
+	while(!intervals_.empty() && intervals_.begin()->first <= now) {
+	    Source * s = intervals_.begin()->second;
+	    intervals_.erase(intervals_.begin());
+	    s->interval_armed_ = false;
+	    polling_.push_back(s);
+	}
+	for(Source * s : polling_) {
+	    for(size_t i = 0; i < s->parked_.size();) {
+		Parked * p = s->parked_[i];
+		if(p->poll())
+		    wake(*p); // moves the last one into i
+		else
+		    i++;
+	    }
+	    arm(*s, now);
+	}
+	polling_.clear();
+	while(!deadlines_.empty() && deadlines_.begin()->first <= now) {
+	    Parked * p = deadlines_.begin()->second;
+	    p->timed_out_ = true;
+	    wake(*p);
+	}
+	return !ready_.empty() || !deadlines_.empty();
+    }
+
+    // run until every coroutine has finished, sleeping while nothing can make progress
+    void run() {
+	while(run_once()) {
+	    if(!ready_.empty())
+		continue;
+	    // something is parked, so there is a deadline to wake up for
+	    Clock::time_point until = deadlines_.begin()->first;
+	    if(!intervals_.empty() && intervals_.begin()->first < until)
+		until = intervals_.begin()->first;
+	    std::unique_lock<std::mutex> lock(mutex_);
+	    wake_.wait_until(lock, until, [this] { return !signaled_.empty(); });
+	}
+    }
+
+private:
+    friend class Source;
+
+    // poll source again after its interval while anything is parked on it
+    void arm(Source & s, Clock::time_point now) {
+	if(s.interval_ > Clock::duration::zero() && !s.parked_.empty() && !s.interval_armed_) {
+	    intervals_.emplace(now + s.interval_, &s);
+	    s.interval_armed_ = true;
+	}
+    }
+
+    void unlink(Parked & p) {
+	Source & s = *p.parked_on_;
+	s.parked_[p.index_] = s.parked_.back();
+	s.parked_[p.index_]->index_ = p.index_;
+	s.parked_.pop_back();
+	deadlines_.erase(p.deadline_);
+	p.parked_on_ = nullptr;
+    }
+
+    void wake(Parked & p) {
+	unlink(p);
+	ready_.push_back(p.handle_);
+    }
+
+    // a source going away mustn't be left in the queues
+    void forget(Source & s) {
+	for(auto it = intervals_.begin(); it != intervals_.end(); ++it) {
+	    if(it->second == &s) {
+		intervals_.erase(it);
+		break;
+	    }
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	for(size_t i = 0; i < signaled_.size(); i++) {
+	    if(signaled_[i] == &s) {
+		signaled_.erase(signaled_.begin() + i);
+		break;
+	    }
+	}
+    }
+
+    std::vector<std::coroutine_handle<>> ready_;
+    std::vector<Source *> polling_;
+    std::multimap<Clock::time_point, Parked *> deadlines_;
+    std::multimap<Clock::time_point, Source *> intervals_;
+    std::mutex mutex_; // guards signaled_ and Source::signaled_
+    std::condition_variable wake_;
+    std::vector<Source *> signaled_;
+};
+
+inline Source::~Source() {
+    if(interval_armed_ || signaled_)
+	ex_.forget(*this);
+}
+
+inline void Source::notify() {
+    ex_.signal(*this);
+}
+
+/*
+    @brief Coroutine task returning T
+
+    @note Lazily started, co_await it from another task or hand it to Executor::spawn()
+*/
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+	T value{};
+	std::exception_ptr error;
+	std::coroutine_handle<> continuation;
+
+	Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	auto final_suspend() noexcept {
+	    struct FinalAwaiter {
+		bool await_ready() noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+		    auto next = h.promise().continuation;
+		    return next ? next : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	    };
+	    return FinalAwaiter{};
+	}
+	void return_value(T v) { value = std::move(v); }
+	void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    Task(Task && other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task &) = delete;
+    Task & operator=(const Task &) = delete;
+    ~Task() {
+	if(handle_)
+	    handle_.destroy();
+    }
+
+    bool done() const { return handle_ && handle_.done(); }
+
+    // result of a finished task, rethrows if the coroutine threw
+    T result() const {
+	if(handle_.promise().error)
+	    std::rethrow_exception(handle_.promise().error);
+	return handle_.promise().value;
+    }
+
+    std::coroutine_handle<promise_type> handle() const { return handle_; }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+	handle_.promise().continuation = caller;
+	return handle_;
+    }
+    T await_resume() const { return result(); }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/*
+    @brief Awaitable that completes when poll() returns true or the timeout passes
+
+    @note Derived classes implement poll(), and start() if there's something to kick off.
+	Nothing happens until the awaiter is co_awaited, and the timeout counts from then.
+*/
+class PollAwaiter : public Parked {
+public:
+    PollAwaiter(Source & source, std::chrono::milliseconds timeout) : source_(source), timeout_(timeout) {}
+    PollAwaiter(const PollAwaiter &) = delete;
+    PollAwaiter & operator=(const PollAwaiter &) = delete;
+    ~PollAwaiter() override { source_.executor().cancel(*this); }
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+	start();
+	if(poll())
+	    return false; // carry on without suspending
+	source_.executor().park(source_, *this, h, Clock::now() + timeout_);
+	return true;
+    }
+
+protected:
+    virtual void start() {}
+
+private:
+    Source & source_;
+    std::chrono::milliseconds timeout_;
+};
+
+// next reading, optionally only once the readings are stable
+class ReadingAwaiter : public PollAwaiter {
+public:
+    ReadingAwaiter(Source & source, std::chrono::milliseconds timeout, bool stable_only)
+	: PollAwaiter(source, timeout), stable_only_(stable_only) {}
+
+    bool poll() override {
+	status_ = strain_gauge_poll(&kgs_);
+	if(status_ == SG_BUSY)
+	    return false;
+	return status_ != SG_OK || !stable_only_ || strain_gauge_is_stable();
+    }
+
+    Reading await_resume() const {
+	if(timed_out_)
+	    return {SG_ERR_TIMEOUT, 0};
+	return {status_, kgs_};
+    }
+
+private:
+    bool stable_only_;
+    sg_status_t status_ = SG_BUSY;
+    float kgs_ = 0;
+};
+
+// average or tare, driven by strain_gauge_job_poll()
+class JobAwaiter : public PollAwaiter {
+public:
+    JobAwaiter(Source & source, std::chrono::milliseconds timeout, uint8_t times, bool tare)
+	: PollAwaiter(source, timeout), times_(times), tare_(tare) {}
+
+    bool poll() override { return strain_gauge_job_poll(&job_) != SG_BUSY; }
+
+    Reading await_resume() {
+	if(timed_out_) {
+	    strain_gauge_job_cancel(&job_); // leaves taring mode
+	    return {SG_ERR_TIMEOUT, 0};
+	}
+	return {job_.status, job_.result};
+    }
+
+protected:
+    void start() override {
+	if(tare_)
+	    strain_gauge_tare_start(&job_);
+	else
+	    strain_gauge_average_start(&job_, times_);
+    }
+
+private:
+    uint8_t times_;
+    bool tare_;
+    SgAverageJob job_;
+};
+
+/*
+    @brief Coroutine view of the strain gauge
+
+    @note Call notify() where the sample timer sets read_sg, or on data ready, and waiting
+	coroutines are polled straight away. Without it they are polled every poll_interval,
+	one sample period by default. Pass zero to only poll on notify().
+
+    @note The awaitables are meant to be co_awaited straight away, they hold the state of the
+	read so they mustn't outlive the expression
+*/
+class Cell {
+public:
+    explicit Cell(Executor & ex, std::chrono::milliseconds timeout = std::chrono::milliseconds(SG_DEFAULT_TIMEOUT_MS),
+	    Clock::duration poll_interval = sample_period())
+	: source_(ex, poll_interval), timeout_(timeout) {}
+
+    // a sample may be ready, safe from any thread
+    void notify() { source_.notify(); }
+
+    ReadingAwaiter next_reading() { return ReadingAwaiter(source_, timeout_, false); }
+    ReadingAwaiter next_stable_reading() { return ReadingAwaiter(source_, timeout_, true); }
+    JobAwaiter average(uint8_t times) { return JobAwaiter(source_, timeout_ * times, times, false); }
+    JobAwaiter tare() {
+	sg_param_value_t samples;
+	strain_gauge_param_get(SG_PARAM_TARE_SAMPLES, &samples);
+	return JobAwaiter(source_, timeout_ * samples.u32, 0, true);
+    }
+
+    // one conversion at the backend's sample rate
+    static Clock::duration sample_period() {
+	return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(1 / strain_gauge_sample_rate()));
+    }
+
+private:
+    Source source_;
+    std::chrono::milliseconds timeout_;
+};
+
+// start a top level task on the executor, the task has to outlive the run
+template <typename T>
+void spawn(Executor & ex, Task<T> & task) {
+    ex.schedule(task.handle());
+}
+
+} // namespace strain_gauge
+
+#endif // STRAIN_GUAGE_ASYNC_HPP
@@ -0,0 +1,58 @@
+/* ****************************************************************************/
+/** Strain Guage Library Configuration
+
+  @File Name
+    strain_gauge_config.h
+
+  @Summary
+    Feature flags and table sizes for the strain guage library
+
+  @Description
+    Every table in the library is a fixed size static array, nothing is allocated at run
+    time, so these settings decide the whole RAM footprint. Turn off what you don't use and
+    shrink the tables to fit small parts. Each setting can also be overridden with -D on
+    the compiler command line. The optional modules (kalman, noise_analysis, spc,
+    hx711_spi, ads1220) cost nothing unless their .c file is built and called.
+******************************************************************************/
+
+#ifndef STRAIN_GUAGE_CONFIG_H
+#define STRAIN_GUAGE_CONFIG_H
+
+// features, 1 to build in, 0 to strip
+#ifndef SG_USE_THRESHOLDS
+#define SG_USE_THRESHOLDS 1 // weight thresholds with rising/falling events
+#endif
+#ifndef SG_USE_RAW_RING
+#define SG_USE_RAW_RING 1 // isr fed raw ring and strain_gauge_acquire(), needed by hx711_spi.c
+#endif
+#ifndef SG_USE_MULTIRATE
+#define SG_USE_MULTIRATE 1 // strain_gauge_attach_multirate(), needs multirate.c
+#endif
+#ifndef SG_USE_STATS
+#define SG_USE_STATS 1 // strain_gauge_attach_stats(), needs stats.c
+#endif
+#ifndef SG_USE_AUDIT_LOG
+#define SG_USE_AUDIT_LOG 1 // strain_gauge_attach_audit_log(), needs audit_log.c. crc32.c is always needed.
+#endif
+#ifndef SG_USE_WARMUP
+#define SG_USE_WARMUP 1 // warm-up drift compensation, needs warmup_model.c
+#endif
+#ifndef SG_USE_MOTION_COMP
+#define SG_USE_MOTION_COMP 1 // strain_gauge_attach_motion_comp(), needs motion_comp.c
+#endif
+
+// table sizes
+#ifndef SG_MAX_CAL_POINTS
+#define SG_MAX_CAL_POINTS 16 // known weights per calibration, sizes the static fit workspace
+#endif
+#ifndef SG_RAW_RING_SIZE
+#define SG_RAW_RING_SIZE 256 // raw samples in the ring, power of 2, 4 bytes each
+#endif
+#ifndef SG_MAX_THRESHOLDS
+#define SG_MAX_THRESHOLDS 32 // weight thresholds that can be registered
+#endif
+#ifndef SG_MAX_LISTENERS
+#define SG_MAX_LISTENERS 8 // state change subscribers that can be registered
+#endif
+
+#endif // STRAIN_GUAGE_CONFIG_H
@@ -0,0 +1,143 @@
+/* ****************************************************************************/
+/** Warm-up Drift Model Library 
+
+  @File Name
+    warmup_model.c
+
+  @Summary
+    Exponential zero drift model for the first minutes after power on
+
+  @Description
+    Implements the fit of z(t) = A*exp(-t/tau) above the settled zero to a power up log of
+    raw adc counts, and the drift the model predicts at a given time
+******************************************************************************/
+
+#include "warmup_model.h"
+#include <math.h>
+
+// least squares fit for one time constant
+typedef struct {
+    double amplitude;
+    double zero; // settled zero, relative to the first sample
+    double sse; // sum of squared residuals
+}WarmupFit;
+
+/*
+    @brief Fit amplitude and settled zero for a fixed time constant
+
+    @note y = zero + amplitude*exp(-t/tau) is linear in the two unknowns, so it's the closed
+	form two parameter least squares solution. Samples are taken relative to the first one
+	so the double sums don't lose precision on a large dc offset.
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] dt Sample period in s
+
+    @param[in] tau Time constant in s
+
+    @param[out] fit Fit result
+
+    @ret false if the basis is degenerate for this tau
+*/
+static bool fit_tau(const int32_t * samples, uint32_t n, double dt, double tau, WarmupFit * fit) {
+    double se = 0, see = 0, sy = 0, sey = 0, syy = 0;
+    double decay = exp(-dt / tau), e = 1;
+    for(uint32_t i = 0; i < n; i++) {
+	double y = (double)samples[i] - samples[0];
+	se += e;
+	see += e * e;
+	sy += y;
+	sey += e * y;
+	syy += y * y;
+	e *= decay;
+    }
+    double det = n * see - se * se;
+    if(det <= 0)
+	return false;
+    fit->amplitude = (n * sey - se * sy) / det;
+    fit->zero = (sy - fit->amplitude * se) / n;
+    fit->sse = syy - fit->zero * sy - fit->amplitude * sey;
+    return true;
+}
+
+/*
+    @brief Fit the drift model to a power up log
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] sample_rate Sample rate in Hz
+
+    @param[out] model Fitted model, only written when the fit succeeds
+
+    @ret true if the fit succeeded, false if the log is too short to see the drift settle
+*/
+bool warmup_model_fit(const int32_t * samples, uint32_t n, float sample_rate, WarmupModel * model) {
+    WarmupFit fit, best_fit = {0, 0, INFINITY};
+    if(n < 8 || sample_rate <= 0)
+	return false;
+    double dt = 1.0 / sample_rate;
+    // tau from a couple of samples up to the length of the log, log spaced
+    double tau_min = 2 * dt;
+    double ratio = pow(n * dt / tau_min, 1.0 / (WARMUP_FIT_STEPS - 1));
+    double tau = tau_min;
+    uint8_t best = 0;
+    for(uint8_t i = 0; i < WARMUP_FIT_STEPS; i++, tau *= ratio) {
+	if(fit_tau(samples, n, dt, tau, &fit) && fit.sse < best_fit.sse) {
+	    best_fit = fit;
+	    best = i;
+	}
+    }
+    // the best fit at the longest tau means the drift hadn't settled by the end of the log
+    if(isinf(best_fit.sse) || best == WARMUP_FIT_STEPS - 1)
+	return false;
+
+    // the error is smooth in log(tau), refine between the neighbours of the best grid point
+    const double golden = 0.618033989;
+    double lo = log(tau_min) + (best > 0 ? best - 1 : 0) * log(ratio);
+    double hi = log(tau_min) + (best + 1) * log(ratio);
+    double best_tau = tau_min * pow(ratio, best);
+    for(uint8_t i = 0; i < WARMUP_FIT_REFINE; i++) {
+	double a = hi - golden * (hi - lo);
+	double b = lo + golden * (hi - lo);
+	WarmupFit fa, fb;
+	bool ok_a = fit_tau(samples, n, dt, exp(a), &fa);
+	bool ok_b = fit_tau(samples, n, dt, exp(b), &fb);
+	if(!ok_a || !ok_b)
+	    break;
+	if(fa.sse < fb.sse)
+	    hi = b;
+	else
+	    lo = a;
+	if(fa.sse < best_fit.sse) {
+	    best_fit = fa;
+	    best_tau = exp(a);
+	}
+	if(fb.sse < best_fit.sse) {
+	    best_fit = fb;
+	    best_tau = exp(b);
+	}
+    }
+
+    model->amplitude = best_fit.amplitude;
+    model->tau = best_tau;
+    return true;
+}
+
+/*
+    @brief Calculate the drift left at a time after power on
+
+    @param[in] model Drift model
+
+    @param[in] t Time since power on in s
+
+    @ret Drift in raw counts above the settled zero
+*/
+float warmup_model_drift(const WarmupModel * model, float t) {
+    if(model->tau <= 0 || t >= WARMUP_SETTLED_TAUS * model->tau)
+	return 0;
+    return model->amplitude * expf(-t / model->tau);
+}
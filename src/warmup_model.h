@@ -0,0 +1,70 @@
+/* ****************************************************************************/
+/** Warm-up Drift Model Library 
+
+  @File Name
+    warmup_model.h
+
+  @Summary
+    Exponential zero drift model for the first minutes after power on
+
+  @Description
+    Defines a model of the zero drift of a cold load cell and amplifier, z(t) = A*exp(-t/tau)
+    above the settled zero, with a function that fits it to a power up log of raw adc counts,
+    either on the device or on a host from a log
+******************************************************************************/
+
+#ifndef WARMUP_MODEL_H
+#define WARMUP_MODEL_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WARMUP_FIT_STEPS 48 // time constants tried on the coarse grid
+#define WARMUP_FIT_REFINE 24 // golden section steps around the best grid point
+#define WARMUP_SETTLED_TAUS 8 // drift is treated as gone after this many time constants
+
+// zero drift after power on
+typedef struct {
+    float amplitude; // drift at power on, raw counts above the settled zero
+    float tau; // time constant in s
+}WarmupModel;
+
+/*
+    @brief Fit the drift model to a power up log
+
+    @note Record the log unloaded, starting at power on, e.g. with strain_gauge_capture_raw().
+	Averaging the logs of a few power ups first gives a better fit. Each tau tried is a
+	linear least squares fit for the amplitude and settled zero, O(n) with no extra memory.
+
+    @param[in] samples Raw adc counts
+
+    @param[in] n Number of samples
+
+    @param[in] sample_rate Sample rate in Hz
+
+    @param[out] model Fitted model, only written when the fit succeeds
+
+    @ret true if the fit succeeded, false if the log is too short to see the drift settle
+*/
+bool warmup_model_fit(const int32_t * samples, uint32_t n, float sample_rate, WarmupModel * model);
+
+/*
+    @brief Calculate the drift left at a time after power on
+
+    @param[in] model Drift model
+
+    @param[in] t Time since power on in s
+
+    @ret Drift in raw counts above the settled zero
+*/
+float warmup_model_drift(const WarmupModel * model, float t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WARMUP_MODEL_H
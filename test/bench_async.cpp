@@ -0,0 +1,148 @@
+/* ****************************************************************************/
+/** Coroutine Executor Benchmark
+
+  @File Name
+    bench_async.cpp
+
+  @Summary
+    One executor thread against one thread per channel, for thousands of channels
+
+  @Description
+    A producer thread plays the data ready interrupts: every period it makes a sample
+    available on each channel and signals it. Each channel's consumer takes BENCH_SAMPLES
+    samples, either as a coroutine parked on the channel's Source, or as a thread blocked on
+    the channel's condition variable. Reports the wall time, the cpu time of the whole
+    process and how many samples were late (taken after the next one arrived).
+
+    bench_async [channels] [samples] [period_us]
+******************************************************************************/
+
+#include "strain_gauge_async.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <thread>
+
+using namespace strain_gauge;
+
+namespace {
+
+struct Channel {
+    std::atomic<uint32_t> produced{0};
+    uint32_t consumed = 0;
+    uint32_t late = 0;
+    std::mutex mutex; // thread per channel only
+    std::condition_variable ready;
+};
+
+// next sample of one channel
+class NextSample : public PollAwaiter {
+public:
+    NextSample(Source & source, Channel & ch) : PollAwaiter(source, std::chrono::seconds(10)), ch_(ch) {}
+    bool poll() override {
+	uint32_t produced = ch_.produced.load(std::memory_order_acquire);
+	if(produced == ch_.consumed)
+	    return false;
+	ch_.late += produced - ch_.consumed > 1;
+	ch_.consumed = produced;
+	return true;
+    }
+    void await_resume() const {}
+
+private:
+    Channel & ch_;
+};
+
+Task<int> consume(Source & source, Channel & ch, uint32_t samples) {
+    while(ch.consumed < samples)
+	co_await NextSample(source, ch);
+    co_return 0;
+}
+
+// ticks every channel once per period, notify is called with the channel index
+template <typename Notify>
+void produce(std::deque<Channel> & channels, uint32_t samples, std::chrono::microseconds period, Notify notify) {
+    auto next = Clock::now();
+    for(uint32_t n = 0; n < samples; n++) {
+	next += period;
+	std::this_thread::sleep_until(next);
+	for(size_t i = 0; i < channels.size(); i++) {
+	    channels[i].produced.fetch_add(1, std::memory_order_release);
+	    notify(i);
+	}
+    }
+}
+
+struct Result {
+    double wall_s;
+    double cpu_s;
+    uint64_t late;
+};
+
+Result run_executor(size_t count, uint32_t samples, std::chrono::microseconds period) {
+    std::deque<Channel> channels(count);
+    Executor ex;
+    std::deque<Source> sources;
+    std::vector<Task<int>> tasks;
+    for(size_t i = 0; i < count; i++) {
+	sources.emplace_back(ex);
+	tasks.push_back(consume(sources[i], channels[i], samples));
+	spawn(ex, tasks.back());
+    }
+    auto start = Clock::now();
+    std::clock_t cpu = std::clock();
+    std::thread producer([&] { produce(channels, samples, period, [&](size_t i) { sources[i].notify(); }); });
+    ex.run();
+    producer.join();
+    Result r{std::chrono::duration<double>(Clock::now() - start).count(), double(std::clock() - cpu) / CLOCKS_PER_SEC, 0};
+    for(auto & ch : channels)
+	r.late += ch.late;
+    return r;
+}
+
+Result run_threads(size_t count, uint32_t samples, std::chrono::microseconds period) {
+    std::deque<Channel> channels(count);
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    std::clock_t cpu = std::clock();
+    for(size_t i = 0; i < count; i++) {
+	threads.emplace_back([&ch = channels[i], samples] {
+	    std::unique_lock<std::mutex> lock(ch.mutex);
+	    while(ch.consumed < samples) {
+		ch.ready.wait(lock, [&] { return ch.produced.load(std::memory_order_acquire) != ch.consumed; });
+		uint32_t produced = ch.produced.load(std::memory_order_acquire);
+		ch.late += produced - ch.consumed > 1;
+		ch.consumed = produced;
+	    }
+	});
+    }
+    produce(channels, samples, period, [&](size_t i) {
+	std::lock_guard<std::mutex> lock(channels[i].mutex);
+	channels[i].ready.notify_one();
+    });
+    for(auto & t : threads)
+	t.join();
+    Result r{std::chrono::duration<double>(Clock::now() - start).count(), double(std::clock() - cpu) / CLOCKS_PER_SEC, 0};
+    for(auto & ch : channels)
+	r.late += ch.late;
+    return r;
+}
+
+void print(const char * name, size_t threads, const Result & r) {
+    std::printf("%-20s %8zu %10.3f %10.3f %10llu\n", name, threads, r.wall_s, r.cpu_s, (unsigned long long)r.late);
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 2000;
+    uint32_t samples = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 100;
+    std::chrono::microseconds period(argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 12500);
+    std::printf("%zu channels, %u samples each every %lld us\n", count, samples, (long long)period.count());
+    std::printf("%-20s %8s %10s %10s %10s\n", "", "threads", "wall s", "cpu s", "late");
+    print("executor", 2, run_executor(count, samples, period));
+    print("thread per channel", count + 1, run_threads(count, samples, period));
+    return 0;
+}
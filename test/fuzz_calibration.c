@@ -0,0 +1,282 @@
+/* ****************************************************************************/
+/** Calibration Fuzz Target
+
+  @File Name
+    fuzz_calibration.c
+
+  @Summary
+    libFuzzer target for the calibration fit, the persisted calibration, the parameter
+    import and the conversion of readings
+
+  @Description
+    The first input byte picks what the rest of the input is fed to, and each path checks
+    the properties the driver promises for bad input: nothing non-finite gets into the
+    calibration, corrupted sets are rejected, an import is all or nothing, calibration
+    points convert back to their known weights and a tared reading is 0. Build with
+    clang -fsanitize=fuzzer,address,undefined (make fuzz CC=clang), or link fuzz_main.c
+    for a random run under gcc (make check).
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_CAPACITY 10
+#define FUZZ_RO 2.0f
+
+// fuzz input being consumed
+typedef struct {
+    const uint8_t * data;
+    size_t size;
+}Input;
+
+/*
+    @brief Fail the run, abort() so libFuzzer keeps the input
+*/
+#define PROPERTY(cond) do { \
+	if(!(cond)) { \
+	    fprintf(stderr, "%s:%d: property failed: %s\n", __FILE__, __LINE__, #cond); \
+	    abort(); \
+	} \
+    } while(0)
+
+/*
+    @brief Take bytes from the input, zero filled once it runs out
+*/
+static void take(Input * in, void * out, size_t len) {
+    size_t n = in->size < len ? in->size : len;
+    memcpy(out, in->data, n);
+    memset((uint8_t *)out + n, 0, len - n);
+    in->data += n;
+    in->size -= n;
+}
+
+static uint8_t take_u8(Input * in) {
+    uint8_t v;
+    take(in, &v, 1);
+    return v;
+}
+
+static float take_f32(Input * in) {
+    float v;
+    take(in, &v, sizeof(v));
+    return v;
+}
+
+/*
+    @brief Power on state for every input, so runs don't depend on each other
+*/
+static void reset(void) {
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_init(SIM_VE, FUZZ_CAPACITY, FUZZ_RO);
+    strain_gauge_set_equation(1, 0);
+}
+
+/*
+    @brief Check the active calibration is usable
+*/
+static void check_calibration(void) {
+    CalibrationSet cal;
+    strain_gauge_get_calibration(&cal);
+    PROPERTY(isfinite(cal.slope) && isfinite(cal.intercept) && isfinite(cal.offset));
+    PROPERTY(isfinite(cal.scale) && cal.scale > 0);
+    PROPERTY(isfinite(cal.gravity) && cal.gravity > 0);
+}
+
+/*
+    @brief Fit random points
+*/
+static void fuzz_fit(Input * in) {
+    float x[SG_MAX_CAL_POINTS + 1], y[SG_MAX_CAL_POINTS + 1];
+    float equation[2] = {NAN, NAN};
+    uint8_t weight_cnt = take_u8(in) % (SG_MAX_CAL_POINTS + 1);
+    double mean = 0, sxx = 0, sx2 = 0;
+    bool finite = true;
+    for(uint8_t i = 0; i <= weight_cnt; i++) {
+	x[i] = take_f32(in);
+	y[i] = take_f32(in);
+	finite = finite && isfinite(x[i]) && isfinite(y[i]);
+	mean += x[i];
+    }
+    sg_status_t status = strain_gauge_calculate_equation(weight_cnt, x, y, equation);
+    PROPERTY(status == SG_OK || status == SG_ERR_INVALID);
+    if(!finite) {
+	PROPERTY(status == SG_ERR_INVALID);
+	return;
+    }
+    mean /= weight_cnt + 1;
+    for(uint8_t i = 0; i <= weight_cnt; i++) {
+	sxx += (x[i] - mean) * (x[i] - mean);
+	sx2 += (double)x[i] * x[i];
+    }
+    // the spread computed exactly, with a margin for the float rounding in the driver
+    if(sxx <= 0.5 * SG_CAL_MIN_SPREAD * sx2)
+	PROPERTY(status == SG_ERR_INVALID);
+    if(status == SG_OK) {
+	PROPERTY(isfinite(equation[0]) && isfinite(equation[1]));
+	strain_gauge_set_equation(equation[0], equation[1]);
+	check_calibration();
+    }
+}
+
+/*
+    @brief Restore a random persisted calibration
+*/
+static void fuzz_restore(Input * in) {
+    CalibrationSet cal, before, after;
+    bool seal = take_u8(in) & 1;
+    take(in, &cal, sizeof(cal));
+    if(seal)
+	strain_gauge_seal_calibration(&cal);
+    strain_gauge_get_calibration(&before);
+    bool usable = isfinite(cal.slope) && isfinite(cal.intercept) && isfinite(cal.offset) &&
+	isfinite(cal.scale) && cal.scale > 0 && isfinite(cal.gravity) && cal.gravity > 0;
+    bool accepted = strain_gauge_set_calibration(&cal);
+    strain_gauge_get_calibration(&after);
+    if(!usable)
+	PROPERTY(!accepted);
+    if(seal)
+	PROPERTY(accepted == usable);
+    if(accepted) {
+	PROPERTY(after.slope == cal.slope && after.intercept == cal.intercept);
+	PROPERTY(after.offset == cal.offset && after.scale == cal.scale);
+	PROPERTY(after.gravity == cal.gravity);
+    }
+    else
+	PROPERTY(after.version == before.version);
+    check_calibration();
+    float kgs;
+    sg_status_t status = read_kgs_timeout(1000, &kgs);
+    PROPERTY(status == SG_OK || status == SG_ERR_FAULT);
+}
+
+/*
+    @brief Start up from a random persisted calibration
+*/
+static void fuzz_startup(Input * in) {
+    CalibrationSet cal;
+    bool seal = take_u8(in) & 1;
+    take(in, &cal, sizeof(cal));
+    if(seal)
+	strain_gauge_seal_calibration(&cal);
+    sg_status_t status = strain_gauge_startup(&cal, 10000);
+    PROPERTY(status == SG_OK || status == SG_ERR_INVALID || status == SG_ERR_TIMEOUT);
+    PROPERTY(strain_gauge_is_valid() == (status == SG_OK));
+    check_calibration();
+}
+
+/*
+    @brief Import random parameter records
+*/
+static void fuzz_import(Input * in) {
+    uint8_t before[SG_PARAM_COUNT * SG_PARAM_RECORD_SIZE];
+    uint8_t after[SG_PARAM_COUNT * SG_PARAM_RECORD_SIZE];
+    strain_gauge_param_export(before, sizeof(before));
+    sg_status_t status = strain_gauge_param_import(in->data, in->size);
+    strain_gauge_param_export(after, sizeof(after));
+    PROPERTY(status == SG_OK || status == SG_ERR_INVALID);
+    if(status != SG_OK)
+	PROPERTY(memcmp(before, after, sizeof(before)) == 0); // all or nothing
+    for(uint16_t id = 0; id < SG_PARAM_COUNT; id++) {
+	const SgParamInfo * info = strain_gauge_param_info(id);
+	sg_param_value_t v;
+	strain_gauge_param_get(id, &v);
+	if(info->type == SG_PARAM_TYPE_FLOAT)
+	    PROPERTY(v.f >= info->min.f && v.f <= info->max.f);
+	else
+	    PROPERTY(v.u32 >= info->min.u32 && v.u32 <= info->max.u32);
+    }
+}
+
+/*
+    @brief Let samples through until a job finishes
+*/
+static sg_status_t finish(SgAverageJob * job) {
+    sg_status_t status;
+    while((status = strain_gauge_job_poll(job)) == SG_BUSY)
+	sim_tick();
+    return status;
+}
+
+/*
+    @brief Read the weight at a bridge output
+*/
+static float weigh(float mv) {
+    float kgs = NAN;
+    sim_mv = mv;
+    PROPERTY(read_kgs_timeout(1000, &kgs) == SG_OK);
+    return kgs;
+}
+
+/*
+    @brief Calibrate on random points of a random line, tare at a random load and weigh
+
+    @note The bridge outputs are kept inside the adc range, either sign, so readings,
+	intercepts and tare offsets below zero are all covered
+*/
+static void fuzz_convert(Input * in) {
+    float mv[SG_MAX_CAL_POINTS + 1], known[SG_MAX_CAL_POINTS + 1];
+    SgAverageJob job;
+    float equation[2];
+    uint8_t points = 2 + take_u8(in) % SG_MAX_CAL_POINTS;
+    float slope = 0.25f + take_u8(in) / 64.0f; // kg per kg of cell output
+    float intercept = (int8_t)take_u8(in) / 16.0f; // kg
+    float start = (int8_t)take_u8(in) / 16.0f; // mV, -8 to 8
+    float step = (start > 0 ? -1 : 1) * (0.5f + (take_u8(in) & 0x0F) / 16.0f);
+    CalibrationSet cal;
+    strain_gauge_get_calibration(&cal);
+
+    PROPERTY(strain_gauge_cal_begin() == SG_OK);
+    for(uint8_t i = 0; i < points; i++) {
+	mv[i] = start + i * step * 8 / points;
+	known[i] = slope * mv[i] * cal.scale + intercept;
+	sim_mv = mv[i];
+	strain_gauge_cal_point_start(&job, known[i]);
+	PROPERTY(finish(&job) == SG_OK);
+    }
+    PROPERTY(strain_gauge_cal_commit(equation) == SG_OK);
+    check_calibration();
+
+    // every point converts back to its known weight, the offset is still 0
+    for(uint8_t i = 0; i < points; i++)
+	PROPERTY(fabsf(weigh(mv[i]) - known[i]) <= 0.01f * (1 + fabsf(known[i])));
+
+    // right after a tare the reading is 0, for a tare offset of either sign
+    float tare_mv = (int8_t)take_u8(in) / 16.0f;
+    sim_mv = tare_mv;
+    strain_gauge_tare_start(&job);
+    PROPERTY(finish(&job) == SG_OK);
+    strain_gauge_get_calibration(&cal);
+    PROPERTY(fabsf(cal.offset - (slope * tare_mv * cal.scale + intercept)) <= 0.01f * (1 + fabsf(cal.offset)));
+    PROPERTY(fabsf(weigh(tare_mv)) <= 0.01f);
+    // and the net weight of the points is their known weight less the tare
+    for(uint8_t i = 0; i < points; i++)
+	PROPERTY(fabsf(weigh(mv[i]) - (known[i] - cal.offset)) <= 0.01f * (1 + fabsf(known[i])));
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    Input in = {data, size};
+    reset();
+    switch(take_u8(&in) % 5) {
+	case 0:
+	    fuzz_fit(&in);
+	    break;
+	case 1:
+	    fuzz_restore(&in);
+	    break;
+	case 2:
+	    fuzz_startup(&in);
+	    break;
+	case 3:
+	    fuzz_import(&in);
+	    break;
+	case 4:
+	    fuzz_convert(&in);
+	    break;
+    }
+    return 0;
+}
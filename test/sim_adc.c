@@ -0,0 +1,136 @@
+/* ****************************************************************************/
+/** Simulated HX711
+
+  @File Name
+    sim_adc.c
+
+  @Summary
+    Host stand-in for the hx711f adc driver, the nordic delays and the read_sg timer
+
+  @Description
+    Implements the hx711f and nrf_delay functions the driver links against
+******************************************************************************/
+
+#include "sim_adc.h"
+#include "hx711_adc.h"
+#include "nrf_delay.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+bool read_sg = true; // the timer flag main.c owns on the target
+
+float sim_mv;
+int32_t sim_noise;
+bool sim_dead;
+uint64_t sim_time_us;
+uint32_t sim_period_us;
+
+static uint64_t last_tick_us;
+static uint64_t read_period; // sample period the last conversion was read in
+static uint32_t noise_state;
+
+/*
+    @brief Back to power on
+*/
+void sim_reset(void) {
+    sim_mv = 0;
+    sim_noise = 1;
+    sim_dead = false;
+    sim_time_us = 0;
+    sim_period_us = 100000;
+    last_tick_us = 0;
+    read_period = UINT64_MAX;
+    noise_state = 1;
+    read_sg = true;
+}
+
+/*
+    @brief Let time pass, setting the timer flag every sample period
+
+    @param[in] us Microseconds
+*/
+void sim_advance(uint32_t us) {
+    sim_time_us += us;
+    while(sim_time_us - last_tick_us >= sim_period_us) {
+	last_tick_us += sim_period_us;
+	read_sg = true;
+    }
+}
+
+/*
+    @brief Let one sample period pass
+*/
+void sim_tick(void) {
+    sim_advance(sim_period_us);
+}
+
+/*
+    @brief Simulated time for strain_gauge_set_clock()
+
+    @ret ms since sim_reset()
+*/
+uint32_t sim_millis(void) {
+    return (uint32_t)(sim_time_us / 1000);
+}
+
+/*
+    @brief Convert a bridge voltage to the hx711 count for it
+
+    @param[in] mv Bridge output in mV
+
+    @ret 24 bit count, clamped to the rails
+*/
+int32_t sim_counts(float mv) {
+    float full_scale_mv = 1000.0f * 0.5f * SIM_VE / 128;
+    float counts = roundf(mv / full_scale_mv * 8388608.0f);
+    if(!(counts < 8388607.0f))
+	return 8388607;
+    if(!(counts > -8388608.0f))
+	return -8388608;
+    return (int32_t)counts;
+}
+
+/*
+    @brief Next noise value, a small lcg so runs are repeatable
+
+    @ret -sim_noise to sim_noise, never the same twice in a row
+*/
+static int32_t noise(void) {
+    static int32_t last;
+    if(sim_noise <= 0)
+	return 0;
+    int32_t n;
+    do {
+	noise_state = noise_state * 1664525u + 1013904223u;
+	n = (int32_t)((noise_state >> 8) % (2 * (uint32_t)sim_noise + 1)) - sim_noise;
+    } while(n == last);
+    last = n;
+    return n;
+}
+
+float adc_read_voltage(void) {
+    return sim_mv;
+}
+
+int32_t adc_read(void) {
+    if(sim_dead) {
+	fprintf(stderr, "adc_read() called with DOUT high, this hangs on the target\n");
+	abort();
+    }
+    read_period = sim_time_us / sim_period_us;
+    int32_t counts = sim_counts(sim_mv) + noise();
+    return counts > 8388607 ? 8388607 : counts < -8388608 ? -8388608 : counts;
+}
+
+bool adc_is_ready(void) {
+    return !sim_dead && sim_time_us / sim_period_us != read_period; // one conversion per period
+}
+
+void nrf_delay_ms(uint32_t ms) {
+    sim_advance(ms * 1000);
+}
+
+void nrf_delay_us(uint32_t us) {
+    sim_advance(us);
+}
@@ -0,0 +1,73 @@
+/* ****************************************************************************/
+/** Simulated HX711
+
+  @File Name
+    sim_adc.h
+
+  @Summary
+    Host stand-in for the hx711f adc driver, the nordic delays and the read_sg timer
+
+  @Description
+    Presents a bridge voltage to the driver as hx711 counts with a little deterministic
+    noise, so the diagnostics see a live adc. Time only passes in the delay functions and
+    sim_tick(), and the read_sg timer flag is set once every sample period of simulated
+    time, so timeouts and sample rates behave like on the target without real waiting. Like
+    DOUT, adc_is_ready() is true once per sample period until the conversion is read.
+******************************************************************************/
+
+#ifndef SIM_ADC_H
+#define SIM_ADC_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_VE 5.0f // excitation the tests pass to strain_gauge_init()
+
+extern float sim_mv; // bridge output in mV
+extern int32_t sim_noise; // peak noise in counts, at least 1 or the stuck check trips
+extern bool sim_dead; // DOUT stuck high, adc_read() aborts because it would hang on target
+extern uint64_t sim_time_us; // simulated time since sim_reset()
+extern uint32_t sim_period_us; // sample period, 100000 for the hx711 at 10 SPS
+
+/*
+    @brief Back to power on: 0 mV, 1 count of noise, 10 SPS, time 0, timer flag set
+*/
+void sim_reset(void);
+
+/*
+    @brief Let time pass, setting the timer flag every sample period
+
+    @param[in] us Microseconds
+*/
+void sim_advance(uint32_t us);
+
+/*
+    @brief Let one sample period pass
+*/
+void sim_tick(void);
+
+/*
+    @brief Simulated time for strain_gauge_set_clock()
+
+    @ret ms since sim_reset()
+*/
+uint32_t sim_millis(void);
+
+/*
+    @brief Convert a bridge voltage to the hx711 count for it, gain 128 and VE = SIM_VE
+
+    @param[in] mv Bridge output in mV
+
+    @ret 24 bit count, clamped to the rails
+*/
+int32_t sim_counts(float mv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_ADC_H
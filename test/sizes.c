@@ -0,0 +1,37 @@
+/* ****************************************************************************/
+/** Struct Sizes
+
+  @File Name
+    sizes.c
+
+  @Summary
+    One object of every struct the application owns, for sizes.sh
+
+  @Description
+    Only compiled, never linked, so it builds with a cross compiler that has no libc for
+    the host. sizes.sh reads the size of each size_ symbol with nm, which is sizeof() as
+    the target compiler lays the struct out.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "multirate.h"
+#include "stats.h"
+#include "audit_log.h"
+#include "warmup_model.h"
+#include "kalman.h"
+#include "motion_comp.h"
+#include "spc.h"
+#include "command.h"
+
+Multirate size_Multirate = {0};
+Stats size_Stats = {0};
+AuditLog size_AuditLog = {0};
+WarmupModel size_WarmupModel = {0};
+Kalman size_Kalman = {0};
+KalmanFixed size_KalmanFixed = {0};
+MotionComp size_MotionComp = {0};
+Spc size_Spc = {0};
+SgAverageJob size_SgAverageJob = {0};
+CalibrationSet size_CalibrationSet = {0};
+Command size_Command = {0};
+CommandLoopback size_CommandLoopback = {0};
@@ -0,0 +1,86 @@
+#!/bin/sh
+# Prints the memory footprint tables of README.md for a target build.
+#
+# Objects are only compiled, never linked, and the sizes are read with size and nm, so the
+# numbers are the target compiler's own and no target libc is needed. Run it through make,
+# which passes the minimal configuration and the compiler:
+#
+#   make -C test sizes                                   nrf52, arm-none-eabi-gcc
+#   make -C test sizes SIZE_CC=... SIZE_NM=... SIZE_SIZE=... SIZE_CFLAGS=...
+#
+# The spi backends include the nordic sdk, add its include paths to SIZE_CFLAGS to get
+# their row, otherwise they are listed as not built.
+
+set -e
+: "${CC:?}" "${NM:?}" "${SIZE:?}" "${MINIMAL:?}"
+HERE=$(dirname "$0")
+SRC=$HERE/../src
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# shellcheck disable=SC2086 # the flags are word lists
+compile() {
+    $CC $CFLAGS -std=c99 -I"$SRC" -I"$HERE/stubs" -c "$@"
+}
+
+compile "$SRC/strain_gauge.c" -o "$OUT/full.o"
+compile $MINIMAL "$SRC/strain_gauge.c" -o "$OUT/minimal.o"
+compile "$HERE/sizes.c" -o "$OUT/sizes.o"
+
+# text (code and constants), data and bss of every module, the flash is text + data
+echo "| Module | text | data | bss |"
+echo "|---|---|---|---|"
+for c in "$SRC"/*.c; do
+    m=$(basename "$c" .c)
+    if [ "$m" = strain_gauge ]; then
+        cp "$OUT/full.o" "$OUT/$m.o"
+    elif ! compile "$c" -o "$OUT/$m.o" 2>/dev/null; then
+        echo "| \`$m.c\` | not built, needs the nordic sdk in SIZE_CFLAGS | | |"
+        continue
+    fi
+    $SIZE "$OUT/$m.o" | awk -v m="$m" 'NR == 2 { printf "| `%s.c` | %d | %d | %d |\n", m, $1, $2, $3 }'
+done
+$SIZE "$OUT/minimal.o" | awk 'NR == 2 { printf "| `strain_gauge.c`, every `SG_USE_` flag 0 | %d | %d | %d |\n", $1, $2, $3 }'
+echo
+
+# name and size in bytes of every ram symbol (.bss and .data)
+ram() {
+    $NM -S -t d "$1" | awk '$3 ~ /^[bBdD]$/ { print $4, $2 + 0 }'
+}
+
+echo "| Feature | RAM (bytes) |"
+echo "|---|---|"
+ram "$OUT/full.o" | awk '
+    /^raw_/ { g["Raw ring (`SG_RAW_RING_SIZE` samples)"] += $2; next }
+    /^(thresholds|threshold_cnt|next_threshold_id|max_hysteresis) / { g["Thresholds (`SG_MAX_THRESHOLDS`)"] += $2; next }
+    /^listener/ { g["Listeners (`SG_MAX_LISTENERS`)"] += $2; next }
+    /^cal_(x|y|session|points) / { g["Calibration workspace (`SG_MAX_CAL_POINTS` + 1 points)"] += $2; next }
+    /^cal_/ { g["Double-buffered calibration"] += $2; next }
+    /^params / { g["Parameters"] += $2; next }
+    /^(multirate|stats|audit_log|motion|wait_hook|clock_ms|backend) / { g["Attached stages, hooks and clock (pointers)"] += $2; next }
+    { g["Everything else (diagnostics, stability, startup, warm-up, ...)"] += $2 }
+    END {
+        n = split("Raw ring (`SG_RAW_RING_SIZE` samples)|Thresholds (`SG_MAX_THRESHOLDS`)|Listeners (`SG_MAX_LISTENERS`)|Calibration workspace (`SG_MAX_CAL_POINTS` + 1 points)|Double-buffered calibration|Parameters|Attached stages, hooks and clock (pointers)|Everything else (diagnostics, stability, startup, warm-up, ...)", order, "|")
+        for(i = 1; i <= n; i++)
+            if(order[i] in g)
+                printf "| %s | %d |\n", order[i], g[order[i]]
+    }'
+ram "$OUT/full.o" | awk '{ t += $2 } END { printf "| **Total, all features** | **%d** |\n", t }'
+ram "$OUT/minimal.o" | awk '{ t += $2 } END { printf "| **Total, every `SG_USE_` flag 0** | **%d** |\n", t }'
+
+echo
+echo "| Struct | Bytes |"
+echo "|---|---|"
+ram "$OUT/sizes.o" | awk '{ sub(/^size_/, "", $1); size[$1] = $2 }
+    END {
+        printf "| `Multirate` | %d |\n", size["Multirate"]
+        printf "| `Stats` | %d |\n", size["Stats"]
+        printf "| `AuditLog` | %d |\n", size["AuditLog"]
+        printf "| `WarmupModel` | %d |\n", size["WarmupModel"]
+        printf "| `Kalman` / `KalmanFixed` | %d / %d |\n", size["Kalman"], size["KalmanFixed"]
+        printf "| `MotionComp` | %d |\n", size["MotionComp"]
+        printf "| `Spc` | %d |\n", size["Spc"]
+        printf "| `SgAverageJob` | %d |\n", size["SgAverageJob"]
+        printf "| `CalibrationSet` | %d |\n", size["CalibrationSet"]
+        printf "| `Command` / `CommandLoopback` | %d / %d |\n", size["Command"], size["CommandLoopback"]
+    }'
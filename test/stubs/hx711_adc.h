@@ -0,0 +1,12 @@
+// host stand-in for the hx711f adc driver, implemented by sim_adc.c
+#ifndef HX711_ADC_H
+#define HX711_ADC_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+float adc_read_voltage(void);
+int32_t adc_read(void);
+bool adc_is_ready(void);
+
+#endif // HX711_ADC_H
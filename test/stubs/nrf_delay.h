@@ -0,0 +1,10 @@
+// host stand-in for the nordic sdk delay, implemented by sim_adc.c on the simulated clock
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+
+#include <inttypes.h>
+
+void nrf_delay_ms(uint32_t ms);
+void nrf_delay_us(uint32_t us);
+
+#endif // NRF_DELAY_H
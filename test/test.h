@@ -0,0 +1,37 @@
+/* ****************************************************************************/
+/** Host Test Helpers
+
+  @File Name
+    test.h
+
+  @Summary
+    Minimal check macros for the host tests
+
+  @Description
+    Each test is its own program. CHECK() reports a failed condition and carries on, so one
+    run shows every failure, and TEST_RESULT() is the exit code for make.
+******************************************************************************/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <math.h>
+#include <stdio.h>
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+	test_checks++; \
+	if(!(cond)) { \
+	    test_failures++; \
+	    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+	} \
+    } while(0)
+
+#define CHECK_NEAR(a, b, tol) CHECK(fabs((double)(a) - (double)(b)) <= (tol))
+
+#define TEST_RESULT() (printf("%s: %d checks, %d failed\n", __FILE__, test_checks, test_failures), \
+	test_failures != 0)
+
+#endif // TEST_H
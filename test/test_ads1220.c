@@ -0,0 +1,149 @@
+/* ****************************************************************************/
+/** ADS1220 Backend Tests
+
+  @File Name
+    test_ads1220.c
+
+  @Summary
+    Register encoding of the ads1220 backend and the oversampling limit for adcs that
+    aren't 24 bits
+
+  @Description
+    The configuration bytes are checked against the register map in the datasheet. The
+    oversampling checks run the driver on a simulated adc with more bits than the hx711,
+    where the decimated count has to stay inside an int32_t, and on that adc a failed
+    transfer has to show up as a fault. Built with ADS1220_HOST, so without the nordic
+    glue.
+******************************************************************************/
+
+#include "ads1220.h"
+#include "sim_adc.h"
+#include "test.h"
+
+static void test_config(void) {
+    uint8_t regs[ADS1220_REG_COUNT];
+    ads1220_encode_config(ADS1220_RATE_20, ADS1220_GAIN_128, regs);
+    CHECK(regs[0] == 0x0E && regs[1] == 0x04 && regs[2] == 0x40 && regs[3] == 0x00);
+    ads1220_encode_config(ADS1220_RATE_1000, ADS1220_GAIN_1, regs);
+    CHECK(regs[0] == 0x00 && regs[1] == 0xC4);
+    ads1220_encode_config(ADS1220_RATE_330, ADS1220_GAIN_32, regs);
+    CHECK(regs[0] == 0x0A && regs[1] == 0x84);
+    ads1220_encode_config(7, 8, regs); // out of range
+    CHECK(regs[0] == 0x0E && regs[1] == 0x04);
+    CHECK(ads1220_sample_rate(ADS1220_RATE_600) == 600);
+    CHECK(ads1220_sample_rate(9) == 20);
+}
+
+static void test_decode(void) {
+    uint8_t max[3] = {0x7F, 0xFF, 0xFF}, min[3] = {0x80, 0x00, 0x00}, one[3] = {0xFF, 0xFF, 0xFF};
+    uint8_t mid[3] = {0x12, 0x34, 0x56};
+    CHECK(ads1220_decode(max) == 0x7FFFFF);
+    CHECK(ads1220_decode(min) == -0x800000);
+    CHECK(ads1220_decode(one) == -1);
+    CHECK(ads1220_decode(mid) == 0x123456);
+}
+
+// a 28 bit adc with a fixed reading, the simulated timer paces it
+#define WIDE_BITS 28
+static int32_t wide_raw;
+static uint32_t wide_reads;
+static uint8_t wide_failures; // reads to fail, like a failed spi transfer
+
+static bool wide_is_ready(void) {
+    return true;
+}
+
+static int32_t wide_read(void) {
+    if(wide_failures > 0) {
+	wide_failures--;
+	return SG_RAW_INVALID;
+    }
+    // a fixed reading is stuck, add noise the float diagnostics can still see at 28 bits
+    return wide_raw + 64 * (int32_t)(wide_reads++ % 2);
+}
+
+static const StrainGaugeBackend wide_backend = {
+    .name = "wide",
+    .is_ready = wide_is_ready,
+    .read_raw = wide_read,
+    .sample_rate = 10,
+    .resolution_bits = WIDE_BITS,
+    .full_scale = 0.5f,
+    .gain = 128,
+};
+
+static void test_oversample_limit(void) {
+    int32_t out = 0;
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_backend(&wide_backend);
+
+    // 3/4 of full scale, 4 extra bits are all that fit in 32 (the rails are faults)
+    wide_raw = 3 << (WIDE_BITS - 3);
+    CHECK(read_raw_oversampled(8, 100000, &out) == SG_OK);
+    CHECK(out > 0);
+    CHECK_NEAR(out, (double)wide_raw * 16, 1024);
+
+    wide_raw = -wide_raw;
+    CHECK(read_raw_oversampled(SG_MAX_OVERSAMPLE_BITS, 100000, &out) == SG_OK);
+    CHECK(out < 0);
+    CHECK_NEAR(out, (double)wide_raw * 16, 1024);
+
+    // within the limit the request is used as is
+    CHECK(read_raw_oversampled(2, 100000, &out) == SG_OK);
+    CHECK_NEAR(out, (double)wide_raw * 4, 256);
+    strain_gauge_set_backend(&hx711_backend);
+}
+
+static void test_failed_read(void) {
+    float kgs = NAN;
+    int32_t raw[4];
+    SgAverageJob job;
+    CalibrationSet before, after;
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    strain_gauge_set_backend(&wide_backend);
+    wide_raw = 1 << (WIDE_BITS - 6);
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    float good = kgs;
+
+    // a failed transfer is a fault, not a reading of 0
+    wide_failures = 1;
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_ERR_FAULT);
+    CHECK(strain_gauge_get_faults() == SG_FAULT_READ);
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    CHECK(strain_gauge_get_faults() == SG_FAULT_NONE);
+    CHECK_NEAR(kgs, good, 0.001);
+
+    // it doesn't get into a tare
+    strain_gauge_get_calibration(&before);
+    strain_gauge_tare_start(&job);
+    wide_failures = 1;
+    sg_status_t status;
+    while((status = strain_gauge_job_poll(&job)) == SG_BUSY)
+	sim_tick();
+    CHECK(status == SG_ERR_FAULT);
+    strain_gauge_get_calibration(&after);
+    CHECK(after.offset == before.offset);
+
+    // nor into a raw capture or the raw ring
+    wide_failures = 1;
+    CHECK(strain_gauge_capture_raw(raw, 4, 1000) == SG_ERR_FAULT);
+    CHECK(strain_gauge_get_faults() & SG_FAULT_READ);
+#if SG_USE_RAW_RING
+    size_t got = 0;
+    strain_gauge_push_raw(SG_RAW_INVALID);
+    strain_gauge_push_raw(wide_raw);
+    CHECK(strain_gauge_acquire(raw, 1, 0, &got) == SG_OK && got == 1 && raw[0] == wide_raw);
+#endif
+    strain_gauge_set_backend(&hx711_backend);
+}
+
+int main(void) {
+    test_config();
+    test_decode();
+    test_oversample_limit();
+    test_failed_read();
+    return TEST_RESULT();
+}
@@ -0,0 +1,142 @@
+/* ****************************************************************************/
+/** Coroutine API Tests
+
+  @File Name
+    test_async.cpp
+
+  @Summary
+    strain_gauge_async.hpp against the simulated hx711
+
+  @Description
+    The executor is stepped with run_once() and the simulated sample timer is ticked
+    between rounds, the way a data ready callback would call Cell::notify() on a gateway.
+******************************************************************************/
+
+#include "strain_gauge_async.hpp"
+#include "sim_adc.h"
+#include "test.h"
+
+using namespace strain_gauge;
+using namespace std::chrono_literals;
+
+// counts how often it's polled, completes once ready is set
+class Counter : public PollAwaiter {
+public:
+    Counter(Source & source, bool & ready, int & polls) : PollAwaiter(source, 10s), ready_(ready), polls_(polls) {}
+    bool poll() override {
+	polls_++;
+	return ready_;
+    }
+    bool await_resume() const { return !timed_out_; }
+
+private:
+    bool & ready_;
+    int & polls_;
+};
+
+// run the executor, one sample period per round, until everything is done
+static void run(Executor & ex, Cell & cell) {
+    while(ex.run_once()) {
+	sim_tick();
+	cell.notify();
+    }
+}
+
+static void test_tare_and_read(void) {
+    Executor ex;
+    Cell cell(ex, 1000ms, Clock::duration::zero());
+    Reading tare{}, stable{};
+    sim_mv = 3;
+    auto body = [&]() -> Task<int> {
+	tare = co_await cell.tare();
+	sim_mv = 5;
+	stable = co_await cell.next_stable_reading();
+	co_return 0;
+    };
+    Task<int> task = body(); // the closure has to outlive the coroutine
+    spawn(ex, task);
+    run(ex, cell);
+    CHECK(task.done());
+    CHECK(tare.status == SG_OK);
+    CHECK(stable.status == SG_OK);
+    CHECK_NEAR(stable.kgs, 2, 0.01); // 1 kg per mV at this capacity and ro
+    CHECK(strain_gauge_get_mode() == SG_MODE_MEASURING);
+}
+
+static void test_job_starts_when_awaited(void) {
+    Executor ex;
+    Cell cell(ex, 1000ms, Clock::duration::zero());
+    {
+	JobAwaiter unused = cell.tare();
+	CHECK(strain_gauge_get_mode() != SG_MODE_TARING);
+    }
+    Reading r{};
+    auto body = [&]() -> Task<int> {
+	JobAwaiter tare = cell.tare();
+	CHECK(strain_gauge_get_mode() != SG_MODE_TARING);
+	r = co_await tare;
+	co_return 0;
+    };
+    Task<int> task = body(); // the closure has to outlive the coroutine
+    spawn(ex, task);
+    ex.run_once();
+    CHECK(strain_gauge_get_mode() == SG_MODE_TARING);
+    run(ex, cell);
+    CHECK(r.status == SG_OK);
+}
+
+static void test_parked_until_notify(void) {
+    Executor ex;
+    Source source(ex);
+    bool ready = false, ok = false;
+    int polls = 0;
+    auto body = [&]() -> Task<int> {
+	ok = co_await Counter(source, ready, polls);
+	co_return 0;
+    };
+    Task<int> task = body(); // the closure has to outlive the coroutine
+    spawn(ex, task);
+    for(int i = 0; i < 100; i++)
+	ex.run_once();
+    CHECK(polls == 1); // once when it suspended, never again without a notify
+    source.notify();
+    ex.run_once();
+    CHECK(polls == 2);
+    ready = true;
+    source.notify();
+    source.notify(); // a second notify in the same round is one poll
+    ex.run_once();
+    CHECK(polls == 3);
+    CHECK(!ex.run_once());
+    CHECK(task.done() && ok);
+}
+
+static void test_timeout(void) {
+    Executor ex;
+    Cell cell(ex, 20ms, Clock::duration::zero());
+    Reading read{}, tare{};
+    sim_dead = true;
+    auto body = [&]() -> Task<int> {
+	read = co_await cell.next_reading();
+	tare = co_await cell.tare();
+	co_return 0;
+    };
+    Task<int> task = body(); // the closure has to outlive the coroutine
+    spawn(ex, task);
+    ex.run(); // nothing notifies, so this sleeps until the deadlines
+    sim_dead = false;
+    CHECK(read.status == SG_ERR_TIMEOUT);
+    CHECK(tare.status == SG_ERR_TIMEOUT);
+    CHECK(strain_gauge_get_mode() != SG_MODE_TARING);
+}
+
+int main(void) {
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    test_tare_and_read();
+    test_job_starts_when_awaited();
+    test_parked_until_notify();
+    test_timeout();
+    return TEST_RESULT();
+}
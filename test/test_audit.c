@@ -0,0 +1,166 @@
+/* ****************************************************************************/
+/** Audit Log Tests
+
+  @File Name
+    test_audit.c
+
+  @Summary
+    A full audit trail, releasing exported records, and the driver refusing unlogged changes
+
+  @Description
+    Built twice, as is and with AUDIT_LOG_OVERWRITE, where a full trail overwrites its
+    oldest record instead of refusing.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+#include <string.h>
+
+static AuditLog trail;
+
+static void fill(void) {
+    audit_log_init(&trail);
+    for(uint16_t i = 0; i < AUDIT_LOG_SIZE; i++)
+	CHECK(audit_log_append(&trail, AUDIT_CONFIG, i, 0));
+    CHECK(audit_log_room(&trail) == (AUDIT_LOG_OVERWRITE ? AUDIT_LOG_SIZE : 0));
+}
+
+static void test_crc_layout(void) {
+    // the field by field crc is the crc of the memory image on a little endian host
+    AuditRecord r[2];
+    uint32_t base;
+    audit_log_init(&trail);
+    audit_log_append(&trail, AUDIT_EQUATION, 1.5f, -2);
+    audit_log_export(&trail, r, 2, &base);
+    CHECK(r[0].crc == crc32_update(base, &r[0], offsetof(AuditRecord, crc)));
+    CHECK(trail.cal_counter == 1);
+}
+
+static void test_full(void) {
+    AuditRecord first[AUDIT_LOG_SIZE], second[AUDIT_LOG_SIZE];
+    uint32_t base1, base2;
+    fill();
+    uint8_t n = audit_log_export(&trail, first, AUDIT_LOG_SIZE, &base1);
+    CHECK(n == AUDIT_LOG_SIZE);
+    CHECK(audit_log_verify(first, n, base1) == n);
+#if AUDIT_LOG_OVERWRITE
+    CHECK(audit_log_append(&trail, AUDIT_TARE, 1, 0));
+    CHECK(trail.overwritten == 1);
+    audit_log_export(&trail, second, AUDIT_LOG_SIZE, &base2);
+    CHECK(second[0].seq == 1); // the gap is in the chain
+    CHECK(audit_log_verify(second, AUDIT_LOG_SIZE, base2) == AUDIT_LOG_SIZE);
+#else
+    CHECK(!audit_log_append(&trail, AUDIT_TARE, 1, 0));
+    CHECK(trail.count == AUDIT_LOG_SIZE && trail.next_seq == AUDIT_LOG_SIZE);
+
+    // stored, released, and the next part of the chain follows on from the first
+    audit_log_release(&trail, n);
+    CHECK(audit_log_room(&trail) == AUDIT_LOG_SIZE);
+    CHECK(audit_log_append(&trail, AUDIT_TARE, 1, 0));
+    CHECK(audit_log_export(&trail, second, AUDIT_LOG_SIZE, &base2) == 1);
+    CHECK(base2 == first[n - 1].crc);
+    CHECK(second[0].seq == first[n - 1].seq + 1);
+    CHECK(audit_log_verify(second, 1, base2) == 1);
+    audit_log_release(&trail, 200); // more than there are
+    CHECK(trail.count == 0);
+#endif
+}
+
+static void test_driver(void) {
+    CalibrationSet before, after;
+    SgAverageJob job;
+    float equation[2];
+    fill();
+    strain_gauge_attach_audit_log(&trail);
+    strain_gauge_get_calibration(&before);
+    sg_param_value_t samples = {.u32 = 3};
+#if AUDIT_LOG_OVERWRITE
+    CHECK(strain_gauge_set_equation(2, 0) == SG_OK);
+    CHECK(strain_gauge_set_gravity(9.8f, 9.7f) == SG_OK);
+    CHECK(strain_gauge_param_set(SG_PARAM_TARE_SAMPLES, samples) == SG_OK);
+    (void)job;
+    (void)equation;
+    (void)after;
+#else
+    CHECK(strain_gauge_set_equation(2, 0) == SG_ERR_FULL);
+    CHECK(strain_gauge_set_gravity(9.8f, 9.7f) == SG_ERR_FULL);
+    CHECK(strain_gauge_set_calibration(&before) == false);
+    CHECK(strain_gauge_param_set(SG_PARAM_TARE_SAMPLES, samples) == SG_ERR_FULL);
+    CHECK(strain_gauge_tare_timeout(10000) == SG_ERR_FULL);
+    strain_gauge_tare_start(&job);
+    while(strain_gauge_job_poll(&job) == SG_BUSY)
+	sim_tick();
+    CHECK(job.status == SG_ERR_FULL);
+    CHECK(strain_gauge_get_mode() != SG_MODE_TARING);
+
+    // a calibration session keeps its points until there is room to commit them
+    CHECK(strain_gauge_cal_begin() == SG_OK);
+    for(int i = 0; i < 2; i++) {
+	sim_mv = 1 + i;
+	strain_gauge_cal_point_start(&job, 5.0f * i);
+	while(strain_gauge_job_poll(&job) == SG_BUSY)
+	    sim_tick();
+    }
+    CHECK(strain_gauge_cal_commit(equation) == SG_ERR_FULL);
+    strain_gauge_get_calibration(&after);
+    CHECK(after.version == before.version); // nothing changed
+    audit_log_release(&trail, AUDIT_LOG_SIZE);
+    CHECK(strain_gauge_cal_commit(equation) == SG_OK);
+    CHECK(trail.count == 1 && trail.records[0].type == AUDIT_EQUATION);
+#endif
+    strain_gauge_attach_audit_log(NULL);
+}
+
+static void test_restore(void) {
+    CalibrationSet saved, changed;
+    AuditRecord r[4];
+    uint32_t base;
+    audit_log_init(&trail);
+    strain_gauge_attach_audit_log(&trail);
+    strain_gauge_get_calibration(&saved);
+
+    // the same set again, only the equation record marks the restore
+    CHECK(strain_gauge_set_calibration(&saved));
+    CHECK(trail.count == 1 && trail.records[0].type == AUDIT_EQUATION);
+
+    // a restore that moves the tare, gravity and scale leaves a record for each
+    changed = saved;
+    changed.offset += 1.5f;
+    changed.gravity = 1.001f;
+    changed.scale *= 1.001f;
+    strain_gauge_seal_calibration(&changed);
+    audit_log_init(&trail);
+    CHECK(strain_gauge_set_calibration(&changed));
+    CHECK(audit_log_export(&trail, r, 4, &base) == 4);
+    CHECK(r[0].type == AUDIT_EQUATION && r[1].type == AUDIT_TARE && r[2].type == AUDIT_GRAVITY &&
+	    r[3].type == AUDIT_SCALE);
+    CHECK(r[1].value[0] == changed.offset && r[2].value[0] == changed.gravity && r[3].value[0] == changed.scale);
+    CHECK(trail.cal_counter == 3); // the tare isn't a calibration event
+
+#if !AUDIT_LOG_OVERWRITE
+    // refused unless all of its records fit
+    audit_log_init(&trail);
+    for(uint16_t i = 0; i < AUDIT_LOG_SIZE - 3; i++)
+	audit_log_append(&trail, AUDIT_CONFIG, i, 0);
+    strain_gauge_seal_calibration(&saved);
+    CHECK(!strain_gauge_set_calibration(&saved));
+    CHECK(trail.count == AUDIT_LOG_SIZE - 3);
+    audit_log_release(&trail, 1);
+    CHECK(strain_gauge_set_calibration(&saved));
+    CHECK(trail.count == AUDIT_LOG_SIZE);
+#endif
+    strain_gauge_attach_audit_log(NULL);
+}
+
+int main(void) {
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    test_crc_layout();
+    test_full();
+    test_driver();
+    test_restore();
+    return TEST_RESULT();
+}
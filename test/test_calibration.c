@@ -0,0 +1,164 @@
+/* ****************************************************************************/
+/** Calibration Tests
+
+  @File Name
+    test_calibration.c
+
+  @Summary
+    Properties of the calibration fit and the persisted calibration on known bad input
+
+  @Description
+    The cases the fuzz target only reaches by chance: a fit whose x differ in the last bits,
+    points far from the origin, and persisted sets with one thing wrong at a time.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+#include <string.h>
+
+static void test_fit(void) {
+    float eq[2];
+
+    // exact line
+    float x[4] = {0.1f, 1, 2, 5};
+    float y[4];
+    for(int i = 0; i < 4; i++)
+	y[i] = 3 * x[i] + 0.5f;
+    CHECK(strain_gauge_calculate_equation(3, x, y, eq) == SG_OK);
+    CHECK_NEAR(eq[0], 3, 1e-5);
+    CHECK_NEAR(eq[1], 0.5, 1e-5);
+
+    // far from the origin, single pass sums lose most of the spread here
+    float xo[3] = {5000, 5010, 5020};
+    float yo[3] = {0, 10, 20};
+    CHECK(strain_gauge_calculate_equation(2, xo, yo, eq) == SG_OK);
+    CHECK_NEAR(eq[0], 1, 1e-4);
+    CHECK_NEAR(eq[1], -5000, 0.5);
+
+    // x one ulp apart, only rounding tells them apart
+    float xn[3] = {1000, nextafterf(1000, 2000), nextafterf(nextafterf(1000, 2000), 2000)};
+    float yn[3] = {0, 5, 10};
+    eq[0] = eq[1] = 42;
+    CHECK(strain_gauge_calculate_equation(2, xn, yn, eq) == SG_ERR_INVALID);
+    CHECK(eq[0] == 42 && eq[1] == 42); // untouched
+
+    // the same x, one point, non-finite points
+    float xs[3] = {2, 2, 2};
+    CHECK(strain_gauge_calculate_equation(2, xs, yn, eq) == SG_ERR_INVALID);
+    CHECK(strain_gauge_calculate_equation(0, x, y, eq) == SG_ERR_INVALID);
+    float xnan[2] = {0, NAN}, yinf[2] = {0, INFINITY};
+    CHECK(strain_gauge_calculate_equation(1, xnan, y, eq) == SG_ERR_INVALID);
+    CHECK(strain_gauge_calculate_equation(1, x, yinf, eq) == SG_ERR_INVALID);
+
+    // points that overflow the sums
+    float xb[2] = {-3e38f, 3e38f}, yb[2] = {0, 1};
+    CHECK(strain_gauge_calculate_equation(1, xb, yb, eq) == SG_ERR_INVALID);
+
+    // out of range counts never touch the workspace
+    float known[1] = {1};
+    CHECK(strain_gauge_calibrate(0, known, eq) == SG_ERR_INVALID);
+    CHECK(strain_gauge_calibrate(SG_MAX_CAL_POINTS + 1, known, eq) == SG_ERR_INVALID);
+}
+
+static void test_persisted(void) {
+    CalibrationSet good, bad, now;
+    strain_gauge_set_equation(2, 0.25f);
+    strain_gauge_get_calibration(&good);
+    CHECK(strain_gauge_set_calibration(&good));
+
+    bad = good;
+    bad.crc ^= 1;
+    CHECK(!strain_gauge_set_calibration(&bad));
+    bad = good;
+    bad.slope = 3; // changed without resealing
+    CHECK(!strain_gauge_set_calibration(&bad));
+    bad = good;
+    bad.scale = 0;
+    strain_gauge_seal_calibration(&bad);
+    CHECK(!strain_gauge_set_calibration(&bad));
+    bad = good;
+    bad.intercept = NAN;
+    strain_gauge_seal_calibration(&bad);
+    CHECK(!strain_gauge_set_calibration(&bad));
+
+    strain_gauge_get_calibration(&now);
+    CHECK(now.slope == 2 && now.intercept == 0.25f);
+
+    // startup refuses a corrupted set and keeps the current one
+    bad = good;
+    bad.offset = 7;
+    CHECK(strain_gauge_startup(&bad, 10000) == SG_ERR_INVALID);
+    CHECK(!strain_gauge_is_valid());
+    strain_gauge_get_calibration(&now);
+    CHECK(now.offset == good.offset);
+    CHECK(strain_gauge_startup(&good, 10000) == SG_OK);
+    CHECK(strain_gauge_is_valid());
+}
+
+static void test_gravity(void) {
+    CalibrationSet before, after;
+    strain_gauge_get_calibration(&before);
+    float g_cal = 9.81f, g_site = 9.78f;
+    strain_gauge_set_gravity(g_cal, g_site);
+    strain_gauge_set_gravity(g_cal, g_site); // replaces, doesn't compound
+    strain_gauge_get_calibration(&after);
+    CHECK_NEAR(after.gravity, g_cal / g_site, 1e-6);
+    CHECK_NEAR(after.scale, before.scale / before.gravity * g_cal / g_site, 1e-5);
+
+    // a restored set keeps its own correction
+    CalibrationSet restored = before;
+    restored.scale = 1.5f;
+    restored.gravity = 1.002f;
+    strain_gauge_seal_calibration(&restored);
+    CHECK(strain_gauge_set_calibration(&restored));
+    strain_gauge_set_gravity(1, 1);
+    strain_gauge_get_calibration(&after);
+    CHECK(after.gravity == 1);
+    CHECK_NEAR(after.scale, 1.5f / 1.002f, 1e-5);
+
+    restored.gravity = 0;
+    strain_gauge_seal_calibration(&restored);
+    CHECK(!strain_gauge_set_calibration(&restored));
+    CHECK(strain_gauge_set_calibration(&before));
+}
+
+static void test_import(void) {
+    uint8_t buf[2 * SG_PARAM_RECORD_SIZE] = {
+	SG_PARAM_TARE_SAMPLES, 0, 30, 0, 0, 0, // fine
+	SG_PARAM_SAMPLE_TIMEOUT_MS, 0, 0, 0, 0, 0, // 0 is out of range
+    };
+    sg_param_value_t v;
+    CHECK(strain_gauge_param_import(buf, sizeof(buf)) == SG_ERR_INVALID);
+    strain_gauge_param_get(SG_PARAM_TARE_SAMPLES, &v);
+    CHECK(v.u32 == 15); // nothing applied
+    CHECK(strain_gauge_param_import(buf, SG_PARAM_RECORD_SIZE) == SG_OK);
+    strain_gauge_param_get(SG_PARAM_TARE_SAMPLES, &v);
+    CHECK(v.u32 == 30);
+    CHECK(strain_gauge_param_import(buf, 5) == SG_ERR_INVALID);
+
+    // the oversampling bits have their own, much smaller, range than the filter length
+    CHECK(strain_gauge_param_set(SG_PARAM_OVERSAMPLE_BITS, (sg_param_value_t){.u32 = SG_READ_MAX_OVERSAMPLE_BITS + 1}) == SG_ERR_INVALID);
+    uint8_t bits[SG_PARAM_RECORD_SIZE] = {SG_PARAM_OVERSAMPLE_BITS, 0, 255, 0, 0, 0};
+    CHECK(strain_gauge_param_import(bits, sizeof(bits)) == SG_ERR_INVALID);
+    bits[2] = 1;
+    CHECK(strain_gauge_param_import(bits, sizeof(bits)) == SG_OK);
+    CHECK(strain_gauge_param_set(SG_PARAM_FILTER_LENGTH, (sg_param_value_t){.u32 = 255}) == SG_OK);
+    CHECK(strain_gauge_param_set(SG_PARAM_FILTER, (sg_param_value_t){.u32 = SG_FILTER_OVERSAMPLE}) == SG_OK);
+    uint32_t start = sim_millis();
+    float kgs = NAN;
+    CHECK(strain_gauge_read(&kgs) == SG_OK);
+    CHECK(sim_millis() - start <= 500); // 4 samples at 10 SPS, not 4^255
+    CHECK(strain_gauge_param_set(SG_PARAM_FILTER, (sg_param_value_t){.u32 = SG_FILTER_NONE}) == SG_OK);
+}
+
+int main(void) {
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_init(SIM_VE, 10, 2);
+    test_fit();
+    test_persisted();
+    test_gravity();
+    test_import();
+    return TEST_RESULT();
+}
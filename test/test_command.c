@@ -0,0 +1,222 @@
+/* ****************************************************************************/
+/** Remote Command Tests
+
+  @File Name
+    test_command.c
+
+  @Summary
+    A host driving the command processor over the loopback: calibration, tare, parameters,
+    corrupted frames and a transport that doesn't take whole responses
+
+  @Description
+    The host side uses command_encode_request() and command_decode_response() like a host
+    tool would, and lets simulated time pass while it waits so the commands that need
+    samples get them from the simulated adc.
+******************************************************************************/
+
+#include "command.h"
+#include "sim_adc.h"
+#include "test.h"
+#include <string.h>
+
+static CommandLoopback lb;
+static CommandTransport device;
+static Command cmd;
+static uint8_t seq;
+static uint8_t rx[COMMAND_LOOPBACK_SIZE]; // host side bytes not yet decoded
+static size_t rx_len;
+static size_t write_limit = SIZE_MAX; // bytes the device transport takes per write
+
+#define CAPACITY 20 // kg, 2 kg per mV from the rating so kg and mV don't look alike
+#define SCALE (CAPACITY / (SIM_VE * 2))
+
+static size_t limited_write(void * context, const uint8_t * buf, size_t len) {
+    return device.write(context, buf, len < write_limit ? len : write_limit);
+}
+
+static void send(uint8_t id, const uint8_t * payload, uint8_t len) {
+    uint8_t frame[COMMAND_MAX_PAYLOAD + COMMAND_REQUEST_OVERHEAD];
+    size_t n = command_encode_request(id, ++seq, payload, len, frame);
+    CHECK(n == (size_t)len + COMMAND_REQUEST_OVERHEAD);
+    CHECK(command_loopback_send(&lb, frame, n) == n);
+}
+
+/*
+    @brief Run the processor until a response arrives, 10 ms of simulated time a pass
+
+    @ret true if one arrived within timeout_ms
+*/
+static bool receive(CommandResponse * resp, uint32_t timeout_ms) {
+    for(uint32_t t = 0; t <= timeout_ms; t += 10) {
+	command_process(&cmd, sim_millis());
+	rx_len += command_loopback_receive(&lb, &rx[rx_len], sizeof(rx) - rx_len);
+	size_t n = command_decode_response(rx, rx_len, resp);
+	if(n > 0) {
+	    rx_len -= n;
+	    memmove(rx, &rx[n], rx_len);
+	    return true;
+	}
+	sim_advance(10000);
+    }
+    return false;
+}
+
+/*
+    @brief Send a request and wait for its response
+
+    @ret Response status, SG_ERR_TIMEOUT if none came back
+*/
+static sg_status_t request(uint8_t id, const uint8_t * payload, uint8_t len, CommandResponse * resp) {
+    send(id, payload, len);
+    if(!receive(resp, 5000))
+	return SG_ERR_TIMEOUT;
+    CHECK(resp->cmd == id && resp->seq == seq);
+    return resp->status;
+}
+
+static void setup(void) {
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_init(SIM_VE, CAPACITY, 2);
+    command_loopback_init(&lb, &device);
+    CommandTransport limited = device;
+    limited.write = limited_write;
+    command_init(&cmd, &limited);
+    rx_len = 0;
+}
+
+static void test_calibration(void) {
+    CommandResponse resp;
+    uint8_t kg[4];
+    CHECK(request(COMMAND_CAL_BEGIN, NULL, 0, &resp) == SG_OK);
+    for(int i = 0; i < 2; i++) {
+	sim_mv = 1 + i;
+	command_put_f32(kg, 5.0f * i);
+	CHECK(request(COMMAND_CAL_POINT, kg, 4, &resp) == SG_OK);
+	CHECK(resp.len == 4);
+	CHECK_NEAR(command_get_f32(resp.payload), sim_mv * SCALE, 0.001); // kg from the rating
+    }
+    CHECK(request(COMMAND_CAL_COMMIT, NULL, 0, &resp) == SG_OK);
+    CHECK(resp.len == 8);
+    CHECK_NEAR(command_get_f32(&resp.payload[0]), 5 / SCALE, 0.01);
+    CHECK_NEAR(command_get_f32(&resp.payload[4]), -5, 0.01);
+    CHECK(request(COMMAND_CAL_COMMIT, NULL, 0, &resp) == SG_ERR_INVALID); // nothing begun
+
+    // tare the empty scale, then weigh
+    sim_mv = 1.2f;
+    CHECK(request(COMMAND_TARE, NULL, 0, &resp) == SG_OK);
+    CHECK_NEAR(command_get_f32(resp.payload), 1, 0.01);
+    sim_mv = 1.7f;
+    CHECK(request(COMMAND_READ, NULL, 0, &resp) == SG_OK);
+    CHECK_NEAR(command_get_f32(resp.payload), 2.5, 0.01);
+}
+
+static void test_params(void) {
+    CommandResponse resp;
+    uint8_t req[6] = {SG_PARAM_TARE_SAMPLES, 0};
+    CHECK(request(COMMAND_PARAM_GET, req, 2, &resp) == SG_OK);
+    CHECK(resp.len == 6 && resp.payload[0] == SG_PARAM_TARE_SAMPLES && command_get_u32(&resp.payload[2]) == 15);
+    command_put_u32(&req[2], 4);
+    CHECK(request(COMMAND_PARAM_SET, req, 6, &resp) == SG_OK);
+    CHECK(command_get_u32(&resp.payload[2]) == 4);
+    sg_param_value_t v;
+    strain_gauge_param_get(SG_PARAM_TARE_SAMPLES, &v);
+    CHECK(v.u32 == 4);
+    command_put_u32(&req[2], 0); // out of range
+    CHECK(request(COMMAND_PARAM_SET, req, 6, &resp) == SG_ERR_INVALID);
+    CHECK(request(COMMAND_PARAM_SET, req, 2, &resp) == SG_ERR_INVALID); // short payload
+    req[0] = SG_PARAM_COUNT;
+    CHECK(request(COMMAND_PARAM_GET, req, 2, &resp) == SG_ERR_INVALID);
+    CHECK(request(0x7F, NULL, 0, &resp) == SG_ERR_INVALID);
+
+#if SG_USE_AUDIT_LOG && !AUDIT_LOG_OVERWRITE
+    // a full audit log refuses the change and the host is told why
+    static AuditLog trail;
+    audit_log_init(&trail);
+    for(uint16_t i = 0; i < AUDIT_LOG_SIZE; i++)
+	audit_log_append(&trail, AUDIT_CONFIG, i, 0);
+    strain_gauge_attach_audit_log(&trail);
+    req[0] = SG_PARAM_TARE_SAMPLES;
+    command_put_u32(&req[2], 8);
+    CHECK(request(COMMAND_PARAM_SET, req, 6, &resp) == SG_ERR_FULL);
+    CHECK(request(COMMAND_TARE, NULL, 0, &resp) == SG_ERR_FULL);
+    strain_gauge_attach_audit_log(NULL);
+#endif
+}
+
+static void test_busy(void) {
+    CommandResponse resp;
+    send(COMMAND_TARE, NULL, 0);
+    uint8_t tare_seq = seq;
+    send(COMMAND_READ, NULL, 0);
+    CHECK(receive(&resp, 0));
+    CHECK(resp.cmd == COMMAND_READ && resp.status == SG_ERR_BUSY);
+    // commands that don't need samples are still answered
+    CHECK(request(COMMAND_STATUS, NULL, 0, &resp) == SG_OK);
+    CHECK(resp.len == 7 && resp.payload[0] == SG_MODE_TARING);
+    CHECK(receive(&resp, 5000));
+    CHECK(resp.cmd == COMMAND_TARE && resp.seq == tare_seq && resp.status == SG_OK);
+}
+
+static void test_resync(void) {
+    CommandResponse resp;
+    uint8_t frame[COMMAND_MAX_PAYLOAD + COMMAND_REQUEST_OVERHEAD];
+    uint8_t noise[] = {0x00, 0x5A, 0xFF};
+    uint32_t bad = cmd.bad_frames;
+
+    // bad crc, then noise before the next frame
+    size_t n = command_encode_request(COMMAND_STATUS, ++seq, NULL, 0, frame);
+    frame[n - 1] ^= 1;
+    command_loopback_send(&lb, frame, n);
+    command_loopback_send(&lb, noise, sizeof(noise));
+    CHECK(request(COMMAND_STATUS, NULL, 0, &resp) == SG_OK);
+    CHECK(cmd.bad_frames == bad + 1);
+
+    // a truncated frame swallows the start of the next one, which is found again
+    uint8_t cut[] = {COMMAND_SYNC_REQUEST, COMMAND_STATUS, 0, 4, 0x01};
+    command_loopback_send(&lb, cut, sizeof(cut));
+    CHECK(request(COMMAND_STATUS, NULL, 0, &resp) == SG_OK);
+    CHECK(cmd.bad_frames == bad + 2);
+
+    // a length over COMMAND_MAX_PAYLOAD is dropped as soon as it's seen
+    uint8_t huge[] = {COMMAND_SYNC_REQUEST, COMMAND_STATUS, 0, COMMAND_MAX_PAYLOAD + 1};
+    command_loopback_send(&lb, huge, sizeof(huge));
+    CHECK(request(COMMAND_STATUS, NULL, 0, &resp) == SG_OK);
+    CHECK(cmd.bad_frames == bad + 3);
+
+    // a frame split over many process calls
+    n = command_encode_request(COMMAND_STATUS, ++seq, NULL, 0, frame);
+    for(size_t i = 0; i < n; i++) {
+	command_loopback_send(&lb, &frame[i], 1);
+	command_process(&cmd, sim_millis());
+    }
+    CHECK(receive(&resp, 0) && resp.seq == seq);
+}
+
+static void test_short_write(void) {
+    CommandResponse resp;
+    // the transport takes a few bytes at a time, the rest follows on the next calls
+    write_limit = 3;
+    CHECK(request(COMMAND_STATUS, NULL, 0, &resp) == SG_OK);
+    CHECK(resp.len == 7);
+
+    // nothing is taken while the host isn't reading, the requests wait in the transport
+    write_limit = 0;
+    send(COMMAND_STATUS, NULL, 0);
+    send(COMMAND_CAL_ABORT, NULL, 0);
+    CHECK(!receive(&resp, 100));
+    write_limit = SIZE_MAX;
+    CHECK(receive(&resp, 0) && resp.cmd == COMMAND_STATUS && resp.seq == seq - 1);
+    CHECK(receive(&resp, 0) && resp.cmd == COMMAND_CAL_ABORT && resp.seq == seq);
+    CHECK(cmd.bad_frames == 3);
+}
+
+int main(void) {
+    setup();
+    test_calibration();
+    test_params();
+    test_busy();
+    test_resync();
+    test_short_write();
+    return TEST_RESULT();
+}
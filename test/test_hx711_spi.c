@@ -0,0 +1,116 @@
+/* ****************************************************************************/
+/** HX711 SPI Readout Tests
+
+  @File Name
+    test_hx711_spi.c
+
+  @Summary
+    Bit exact check of the spi pulse train and decoding against a model of the hx711
+
+  @Description
+    The hx711 is modelled at the spi bit level: MOSI is PD_SCK, DOUT shifts out the next
+    data bit on every rising edge and goes high after the 24th, and MISO is sampled in the
+    middle of every spi bit. Every pattern hx711_spi_encode() sends has to clock out the
+    exact count it was given, and the decoded count has to reach the driver through
+    hx711_spi_backend and the raw ring. Built with HX711_SPI_HOST, so without the nordic glue.
+******************************************************************************/
+
+#include "hx711_spi.h"
+#include "sim_adc.h"
+#include "test.h"
+
+#define SPI_BITS (8 * HX711_SPI_BYTES)
+
+/*
+    @brief Clock one transfer through the model hx711
+
+    @param[in] tx MOSI bytes, PD_SCK
+
+    @param[in] value 24 bit count the hx711 has ready
+
+    @param[out] rx MISO bytes, DOUT
+
+    @ret Number of PD_SCK pulses
+*/
+static uint8_t hx711_model(const uint8_t * tx, uint32_t value, uint8_t * rx) {
+    uint8_t pulses = 0;
+    bool sck = false;
+    for(uint8_t i = 0; i < HX711_SPI_BYTES; i++)
+	rx[i] = 0;
+    for(uint8_t bit = 0; bit < SPI_BITS; bit++) {
+	bool level = (tx[bit / 8] >> (7 - bit % 8)) & 1;
+	if(level && !sck)
+	    pulses++; // rising edge, the next data bit is valid within 0.1 us
+	sck = level;
+	bool dout = pulses == 0 ? false : pulses <= 24 ? (value >> (24 - pulses)) & 1 : true;
+	if(dout)
+	    rx[bit / 8] |= 0x80 >> (bit % 8);
+    }
+    return pulses;
+}
+
+static void test_encode(void) {
+    uint8_t tx[HX711_SPI_BYTES], rx[HX711_SPI_BYTES];
+    for(uint8_t gain = HX711_GAIN_A128; gain <= HX711_GAIN_A64; gain++) {
+	hx711_spi_encode(gain, tx);
+	CHECK(hx711_model(tx, 0, rx) == 24 + gain);
+	CHECK((tx[HX711_SPI_BYTES - 1] & 1) == 0); // PD_SCK idles low
+    }
+    hx711_spi_encode(0, tx); // out of range is channel A gain 128
+    CHECK(hx711_model(tx, 0, rx) == 25);
+    hx711_spi_encode(4, tx);
+    CHECK(hx711_model(tx, 0, rx) == 25);
+}
+
+static void test_decode(void) {
+    uint8_t tx[HX711_SPI_BYTES], rx[HX711_SPI_BYTES];
+    uint32_t mismatches = 0;
+    hx711_spi_encode(HX711_GAIN_A128, tx);
+    // a stride that walks every byte value in every position, plus each bit on its own
+    for(uint32_t value = 0; value < 0x1000000; value += 251) {
+	hx711_model(tx, value, rx);
+	int32_t expected = value & 0x800000 ? (int32_t)value - 0x1000000 : (int32_t)value;
+	mismatches += hx711_spi_decode(rx) != expected;
+    }
+    CHECK(mismatches == 0);
+    for(uint8_t b = 0; b < 24; b++) {
+	hx711_model(tx, 1u << b, rx);
+	CHECK(hx711_spi_decode(rx) == (b == 23 ? -0x800000 : 1 << b));
+    }
+    hx711_model(tx, 0xFFFFFF, rx);
+    CHECK(hx711_spi_decode(rx) == -1);
+    hx711_model(tx, 0x7FFFFF, rx);
+    CHECK(hx711_spi_decode(rx) == 0x7FFFFF);
+}
+
+static void test_backend(void) {
+    uint8_t tx[HX711_SPI_BYTES], rx[HX711_SPI_BYTES];
+    int32_t raw[2];
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_backend(&hx711_spi_backend);
+    CHECK(strain_gauge_sample_rate() == 10);
+    CHECK(strain_gauge_capture_raw(raw, 1, 300) == SG_ERR_TIMEOUT); // no transfer yet
+
+    hx711_spi_encode(HX711_GAIN_A128, tx);
+    hx711_model(tx, 0xFFF000, rx); // -4096
+    hx711_spi_transfer_done(rx);
+    sim_tick();
+    CHECK(strain_gauge_capture_raw(raw, 1, 300) == SG_OK);
+    CHECK(raw[0] == -4096);
+    CHECK(!hx711_spi_backend.is_ready()); // read once only
+
+    hx711_model(tx, 12345, rx);
+    hx711_spi_transfer_done(rx);
+    size_t acquired = 0;
+    CHECK(strain_gauge_acquire(raw, 2, 300, &acquired) == SG_OK && acquired == 2);
+    CHECK(raw[0] == -4096 && raw[1] == 12345);
+    strain_gauge_set_backend(&hx711_backend);
+}
+
+int main(void) {
+    test_encode();
+    test_decode();
+    test_backend();
+    return TEST_RESULT();
+}
@@ -0,0 +1,125 @@
+/* ****************************************************************************/
+/** Kalman Filter Tests
+
+  @File Name
+    test_kalman.c
+
+  @Summary
+    Start up of the float filter on a load that is already moving, the fixed point filter
+    against the float one, and fault detection from the innovations
+
+  @Description
+    A fill running at a steady rate when the filter starts should be tracked from the
+    second reading, not after the rate variance has grown from r. The fixed point filter
+    with the gains of a converged float filter has to give the same weight and rate on the
+    same noisy fill, and a step the model can't explain, like something landing on the
+    scale, has to show up in the running nis.
+******************************************************************************/
+
+#include "kalman.h"
+#include "test.h"
+
+#define Q 0.01f // (kg/s)^2/s
+#define NOISE 0.01f // kg rms
+#define PERIOD_MS 10 // 100 SPS
+
+static uint32_t state = 1;
+
+/*
+    @brief xorshift32, repeatable across platforms unlike rand()
+*/
+static uint32_t next(void) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/*
+    @brief Reading of a load with the measurement noise added
+*/
+static float reading(float kgs) {
+    double u1 = (next() + 1.0) / 4294967296.0;
+    double u2 = (next() + 1.0) / 4294967296.0;
+    return kgs + NOISE * (float)(sqrt(-2 * log(u1)) * cos(6.283185307179586 * u2));
+}
+
+/*
+    @brief Float filter converged on a constant 10 kg, timestamps 0 to 4990 ms
+*/
+static void converge(Kalman * kf) {
+    kalman_init(kf, Q, NOISE * NOISE);
+    for(uint32_t i = 0; i < 500; i++)
+	kalman_update(kf, reading(10), i * PERIOD_MS);
+}
+
+static void test_ramp(void) {
+    Kalman kf;
+    kalman_init(&kf, 0.01f, 0.0001f);
+    kalman_update(&kf, NAN, 0);
+    CHECK(!kf.initialized);
+    kalman_update(&kf, 10, 0);
+    kalman_update(&kf, 11, 0); // no time has passed, can't tell a rate from it
+    CHECK(kf.mass == 10 && !kf.rate_known);
+    for(uint32_t i = 1; i <= 20; i++) {
+	kalman_update(&kf, 10 + 5 * i * 0.01f, i * 10); // 5 kg/s at 100 SPS
+	if(i == 1) {
+	    CHECK(kf.rate_known);
+	    CHECK_NEAR(kf.rate, 5, 1e-3);
+	}
+    }
+    CHECK_NEAR(kf.mass, 11, 1e-3);
+    CHECK_NEAR(kf.rate, 5, 1e-2);
+    CHECK(kalman_consistent(&kf, 3));
+}
+
+static void test_fixed(void) {
+    Kalman kf;
+    KalmanFixed kx;
+    converge(&kf);
+    kalman_fixed_init(&kx, &kf, PERIOD_MS / 1000.0f);
+    CHECK(kx.k0 > 0 && kx.k0 < (1 << 30) && kx.k1 > 0);
+
+    // both on the same readings, standing then a 0.5 kg/s fill from 2 s
+    float worst_mass = 0, worst_rate = 0;
+    for(uint32_t i = 0; i < 1000; i++) {
+	float kgs = reading(i < 200 ? 10 : 10 + 0.5f * (i - 200) * PERIOD_MS / 1000.0f);
+	kalman_update(&kf, kgs, (500 + i) * PERIOD_MS);
+	kalman_fixed_update(&kx, (int32_t)lroundf(kgs * 65536.0f));
+	if(i < 100)
+	    continue; // the fixed filter starts at its first reading with no rate
+	worst_mass = fmaxf(worst_mass, fabsf(kx.mass / 65536.0f - kf.mass));
+	worst_rate = fmaxf(worst_rate, fabsf(kx.rate / 65536.0f - kf.rate));
+    }
+    CHECK(worst_mass < 0.02f * NOISE);
+    CHECK(worst_rate < 0.005f);
+    CHECK_NEAR(kx.mass / 65536.0f, 14, 0.02);
+    CHECK_NEAR(kx.rate / 65536.0f, 0.5, 0.1);
+}
+
+static void test_fault(void) {
+    Kalman kf;
+    converge(&kf);
+    CHECK(kalman_consistent(&kf, 3));
+
+    // 0.2 kg lands on the scale, 20 times the noise in one sample
+    uint32_t t = 5000, inconsistent = 0;
+    for(uint32_t i = 0; i < 5; i++, t += PERIOD_MS) {
+	kalman_update(&kf, reading(10.2f), t);
+	inconsistent += !kalman_consistent(&kf, 3);
+    }
+    CHECK(inconsistent == 5);
+
+    // once the filter has followed the step the running nis comes back down
+    for(uint32_t i = 0; i < 300; i++, t += PERIOD_MS)
+	kalman_update(&kf, reading(10.2f), t);
+    CHECK(kalman_consistent(&kf, 3));
+    CHECK_NEAR(kf.mass, 10.2, 3 * NOISE);
+}
+
+int main(void) {
+    test_ramp();
+    test_fixed();
+    test_fault();
+    return TEST_RESULT();
+}
@@ -0,0 +1,105 @@
+/* ****************************************************************************/
+/** Motion Compensation Tests
+
+  @File Name
+    test_motion.c
+
+  @Summary
+    A tared container weighed on a platform moving up and down
+
+  @Description
+    The simulated bridge sees (tare + load) * (g + a) / g with a(t) a 0.5 Hz heave, and
+    the imu samples the same a(t) at 100 Hz. The tare is taken on the move as well. With
+    the stage attached to the driver the net weight comes out flat. Correcting the tared
+    reading afterwards, the old way, leaves tare * a / g in it. With a bridge that isn't
+    balanced the correction has to come after the intercept, or the zero offset is scaled
+    as if it were load.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+
+#define G 9.80665f
+#define HEAVE 2.0f // peak vertical acceleration, m/s^2
+#define TARE_KG 5.0f
+#define LOAD_KG 2.0f
+
+static MotionComp mc;
+static float mass; // on the platform, kg
+static float zero_mv; // bridge output with nothing on the cell
+static uint32_t imu_ms; // next imu sample
+
+static float heave(uint32_t ms) {
+    return HEAVE * sinf(2 * 3.14159265f * 0.5f * ms / 1000);
+}
+
+/*
+    @brief Advance one sample period, feeding the imu on the way, then present the load
+*/
+static void step(void) {
+    sim_tick();
+    for(; imu_ms <= sim_millis(); imu_ms += 10)
+	motion_comp_push_imu(&mc, heave(imu_ms), imu_ms);
+    sim_mv = zero_mv + mass * (G + heave(sim_millis())) / G; // 1 kg per mV at this capacity and ro
+}
+
+static void test_moving_tare(void) {
+    SgAverageJob job;
+    float kgs, worst = 0, worst_net_only = 0;
+    mass = TARE_KG;
+    step();
+    strain_gauge_tare_start(&job);
+    while(strain_gauge_job_poll(&job) == SG_BUSY)
+	step();
+    CHECK(job.status == SG_OK);
+    CHECK_NEAR(job.result, TARE_KG, 0.01);
+
+    mass = TARE_KG + LOAD_KG;
+    for(int i = 0; i < 40; i++) {
+	step();
+	CHECK(strain_gauge_poll(&kgs) == SG_OK);
+	float err = fabsf(kgs - LOAD_KG);
+	worst = err > worst ? err : worst;
+	// what correcting the net weight gives, the driver reading uncorrected then scaled
+	float a = heave(sim_millis());
+	float net_only = ((TARE_KG + LOAD_KG) * (G + a) / G - TARE_KG) * G / (G + a);
+	err = fabsf(net_only - LOAD_KG);
+	worst_net_only = err > worst_net_only ? err : worst_net_only;
+    }
+    CHECK(worst < 0.01f);
+    CHECK(worst_net_only > 0.5f); // about TARE_KG * HEAVE / G
+}
+
+static void test_bridge_offset(void) {
+    // the electrical zero doesn't move with the platform, the intercept takes it off
+    // before the correction
+    zero_mv = 0.8f;
+    strain_gauge_set_equation(1, -zero_mv);
+    test_moving_tare();
+    zero_mv = 0;
+    strain_gauge_set_equation(1, 0);
+}
+
+static void test_no_imu(void) {
+    float kgs;
+    motion_comp_init(&mc, G, 0); // nothing buffered
+    sim_tick();
+    CHECK(strain_gauge_poll(&kgs) == SG_ERR_FAULT);
+    strain_gauge_attach_motion_comp(NULL);
+    sim_tick();
+    CHECK(strain_gauge_poll(&kgs) == SG_OK);
+}
+
+int main(void) {
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    strain_gauge_set_clock(sim_millis);
+    motion_comp_init(&mc, G, 0);
+    strain_gauge_attach_motion_comp(&mc);
+    test_moving_tare();
+    test_bridge_offset();
+    test_no_imu();
+    return TEST_RESULT();
+}
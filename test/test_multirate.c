@@ -0,0 +1,73 @@
+/* ****************************************************************************/
+/** Multirate Tests
+
+  @File Name
+    test_multirate.c
+
+  @Summary
+    What the driver feeds an attached multirate stage
+
+  @Description
+    Faulted samples are held over instead of poisoning the windows, and only base rate
+    conversions reach the stage, not oversampled reads.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+
+static float last_out;
+static int outputs;
+
+static void on_output(float value, void * context) {
+    (void)context;
+    last_out = value;
+    outputs++;
+}
+
+static void test_hold(void) {
+    Multirate mr;
+    multirate_init(&mr);
+    multirate_add(&mr, 2, on_output, NULL);
+    multirate_push(&mr, NAN); // nothing to hold yet
+    CHECK(outputs == 0 && mr.held == 0);
+    multirate_push(&mr, 4);
+    multirate_push(&mr, NAN);
+    CHECK(outputs == 1 && last_out == 4 && mr.held == 1);
+    multirate_push(&mr, INFINITY);
+    multirate_push(&mr, 2);
+    CHECK(outputs == 2 && last_out == 3 && mr.held == 2);
+}
+
+static void test_driver(void) {
+    Multirate mr;
+    multirate_init(&mr);
+    multirate_add(&mr, 1, on_output, NULL);
+    strain_gauge_attach_multirate(&mr);
+    outputs = 0;
+    sim_mv = 2;
+    CHECK(!isnan(read_kgs()));
+    CHECK(outputs == 1);
+    CHECK_NEAR(last_out, 2, 0.01);
+    CHECK(!isnan(read_kgs_oversampled(1)));
+    CHECK(outputs == 1);
+    sim_mv = 100; // pinned to the rail, reported from the SG_DIAG_RAIL_COUNT th sample
+    float good = NAN;
+    for(int i = 1; i < SG_DIAG_RAIL_COUNT; i++)
+	good = read_kgs();
+    outputs = 0;
+    CHECK(isnan(read_kgs()));
+    CHECK(outputs == 1 && mr.held == 1);
+    CHECK(last_out == good); // held over
+    sim_mv = 2;
+    strain_gauge_attach_multirate(NULL);
+}
+
+int main(void) {
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    test_hold();
+    test_driver();
+    return TEST_RESULT();
+}
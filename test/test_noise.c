@@ -0,0 +1,118 @@
+/* ****************************************************************************/
+/** Noise Analysis Tests
+
+  @File Name
+    test_noise.c
+
+  @Summary
+    Noise statistics and the Allan deviation of captures with a known noise
+
+  @Description
+    Gaussian white noise of a known sigma on a large bridge offset has to come back as that
+    rms, and its Allan deviation has to fall with a slope of -1/2 on a log-log plot. A
+    noiseless capture is limited by the adc alone.
+******************************************************************************/
+
+#include "noise_analysis.h"
+#include "test.h"
+
+#define N 65536
+#define OFFSET 8000000 // counts, most of the 24-bit range so the two-pass variance matters
+#define SIGMA 100.0 // counts, well above the 1 count quantization
+#define RATE 80.0f // Hz
+
+static int32_t samples[N];
+
+/*
+    @brief xorshift32, repeatable across platforms unlike rand()
+*/
+static uint32_t next(uint32_t * state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/*
+    @brief Standard normal value, Box-Muller over two uniform values in (0, 1]
+*/
+static double gauss(uint32_t * state) {
+    double u1 = (next(state) + 1.0) / 4294967296.0;
+    double u2 = (next(state) + 1.0) / 4294967296.0;
+    return sqrt(-2 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+static void test_white(void) {
+    uint32_t state = 12345;
+    for(uint32_t i = 0; i < N; i++)
+	samples[i] = OFFSET + (int32_t)lround(SIGMA * gauss(&state));
+
+    NoiseStats st;
+    noise_calculate(samples, N, 24, &st);
+    CHECK_NEAR(st.mean, OFFSET, 2);
+    CHECK_NEAR(st.rms, SIGMA, SIGMA * 0.02);
+    CHECK(st.peak_to_peak > 6 * SIGMA && st.peak_to_peak < 12 * SIGMA);
+    CHECK_NEAR(st.effective_bits, 24 - log2(SIGMA), 0.03);
+    CHECK(st.noise_free_bits < st.effective_bits - 2);
+
+    // white noise averages down as 1/sqrt(m), from sigma at a single sample
+    float tau[16], adev[16];
+    uint8_t points = noise_allan_deviation(samples, N, RATE, tau, adev, 16);
+    CHECK(points == 16);
+    CHECK_NEAR(tau[0], 1 / RATE, 1e-6);
+    CHECK_NEAR(tau[3], 8 / RATE, 1e-6);
+    CHECK_NEAR(adev[0], SIGMA, SIGMA * 0.02);
+
+    // least squares slope of log adev over log tau, on the points that still average many windows
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int k = 0;
+    for(int i = 0; i < points && (1u << i) <= N / 64; i++, k++) {
+	double x = log(tau[i]), y = log(adev[i]);
+	sx += x;
+	sy += y;
+	sxx += x * x;
+	sxy += x * y;
+    }
+    CHECK(k == 11);
+    double slope = (k * sxy - sx * sy) / (k * sxx - sx * sx);
+    CHECK_NEAR(slope, -0.5, 0.03);
+
+    // the points are capped by the arrays, and by 2m <= n
+    CHECK(noise_allan_deviation(samples, N, RATE, tau, adev, 4) == 4);
+    CHECK(noise_allan_deviation(samples, 7, RATE, tau, adev, 16) == 2);
+}
+
+static void test_constant(void) {
+    for(uint32_t i = 0; i < 1000; i++)
+	samples[i] = -OFFSET;
+
+    NoiseStats st;
+    noise_calculate(samples, 1000, 24, &st);
+    CHECK(st.mean == -OFFSET);
+    CHECK(st.rms == 0 && st.peak_to_peak == 0);
+    CHECK(st.effective_bits == 24 && st.noise_free_bits == 24);
+
+    float tau[8], adev[8];
+    uint8_t points = noise_allan_deviation(samples, 1000, RATE, tau, adev, 8);
+    CHECK(points == 8);
+    for(uint8_t i = 0; i < points; i++)
+	CHECK(adev[i] == 0);
+
+    // a 4 count peak to peak costs 2 noise-free bits
+    for(uint32_t i = 0; i < 1000; i++)
+	samples[i] = OFFSET + (int32_t)(i % 5);
+    noise_calculate(samples, 1000, 24, &st);
+    CHECK(st.peak_to_peak == 4);
+    CHECK_NEAR(st.noise_free_bits, 22, 1e-6);
+
+    // nothing to measure
+    noise_calculate(samples, 0, 24, &st);
+    CHECK(st.mean == 0 && st.rms == 0 && st.noise_free_bits == 0);
+}
+
+int main(void) {
+    test_white();
+    test_constant();
+    return TEST_RESULT();
+}
@@ -0,0 +1,174 @@
+/* ****************************************************************************/
+/** SPC Tests
+
+  @File Name
+    test_spc.c
+
+  @Summary
+    Lot changes in the middle of a subgroup, alarm run lengths on a shifted fill and
+    underfill counting
+
+  @Description
+    A new lot starts with an empty subgroup, so the packages of the old lot left in a
+    partial subgroup don't end up in the first subgroup of the new one.
+
+    1 kg packages with a 5 g spread and a 15 g tolerable negative error. The charts learn
+    their limits and sigma from an in-control baseline and stay quiet on in-control packages.
+    Then the filler drifts 2 sigma low, and over many lots the mean number of packages to
+    the first CUSUM, EWMA and X-bar alarm has to match the run lengths these charts are
+    designed for, far below the in-control ones.
+******************************************************************************/
+
+#include "spc.h"
+#include "test.h"
+
+#define TARGET 1.0f
+#define SIGMA 0.005f
+#define LOWER_LIMIT (TARGET - 0.015f)
+#define SUBGROUP 5
+#define LOTS 500 // lots the run lengths are averaged over
+#define MAX_RUN 1000 // packages per lot
+
+static uint32_t state = 1; // one fixed stream, a single in-control lot can still alarm by chance
+
+/*
+    @brief xorshift32, repeatable across platforms unlike rand()
+*/
+static uint32_t next(void) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/*
+    @brief Package weight, normal around mean with the process sigma
+*/
+static float package(float mean) {
+    double u1 = (next() + 1.0) / 4294967296.0;
+    double u2 = (next() + 1.0) / 4294967296.0;
+    return mean + SIGMA * (float)(sqrt(-2 * log(u1)) * cos(6.283185307179586 * u2));
+}
+
+/*
+    @brief Mean number of packages to the first alarm of each chart, over LOTS lots
+
+    @param[in] spc Stage with its limits learned
+
+    @param[in] mean Fill of every package
+
+    @param[out] cusum Mean run length to SPC_ALARM_CUSUM_LOW
+
+    @param[out] ewma Mean run length to SPC_ALARM_EWMA_LOW
+
+    @param[out] xbar Mean run length to SPC_ALARM_XBAR_LOW, in packages
+*/
+static void run_lengths(Spc * spc, float mean, double * cusum, double * ewma, double * xbar) {
+    uint32_t sum[3] = {0};
+    static const uint16_t bits[3] = {SPC_ALARM_CUSUM_LOW, SPC_ALARM_EWMA_LOW, SPC_ALARM_XBAR_LOW};
+    for(uint32_t lot = 0; lot < LOTS; lot++) {
+	uint32_t first[3] = {MAX_RUN, MAX_RUN, MAX_RUN};
+	spc_reset(spc);
+	for(uint32_t i = 1; i <= MAX_RUN; i++) {
+	    uint16_t alarms = spc_push(spc, package(mean));
+	    for(uint8_t c = 0; c < 3; c++)
+		if((alarms & bits[c]) && first[c] == MAX_RUN)
+		    first[c] = i;
+	    if(first[0] < MAX_RUN && first[1] < MAX_RUN && first[2] < MAX_RUN)
+		break;
+	}
+	for(uint8_t c = 0; c < 3; c++)
+	    sum[c] += first[c];
+    }
+    *cusum = (double)sum[0] / LOTS;
+    *ewma = (double)sum[1] / LOTS;
+    *xbar = (double)sum[2] / LOTS;
+}
+
+static void test_reset(void) {
+    Spc spc;
+    CHECK(spc_init(&spc, 1, 0.95f, 5, 0.01f));
+    for(uint8_t i = 0; i < 3; i++)
+	spc_push(&spc, 0.5f); // old lot, 3 of 5
+    spc_reset(&spc);
+    CHECK(spc.sub_cnt == 0);
+    for(uint8_t i = 0; i < 4; i++)
+	spc_push(&spc, 1.0f);
+    CHECK(isnan(spc.xbar)); // still open
+    spc_push(&spc, 1.02f);
+    CHECK_NEAR(spc.xbar, 1.004f, 1e-6);
+    CHECK_NEAR(spc.range, 0.02f, 1e-6);
+    CHECK(spc.packages == 5 && spc.underfills == 0);
+}
+
+static void test_baseline(void) {
+    Spc spc;
+    CHECK(spc_init(&spc, TARGET, LOWER_LIMIT, SUBGROUP, 0)); // sigma from the baseline
+    uint16_t alarms = SPC_ALARM_NONE;
+    for(uint32_t i = 0; i < SPC_BASELINE_SUBGROUPS * SUBGROUP; i++)
+	alarms |= spc_push(&spc, package(TARGET));
+    CHECK(alarms == SPC_ALARM_NONE);
+    CHECK(spc.baseline_cnt == SPC_BASELINE_SUBGROUPS);
+    CHECK_NEAR(spc.sigma, SIGMA, SIGMA * 0.2);
+    CHECK_NEAR(spc.xbar_center, TARGET, SIGMA * 0.3);
+    CHECK(spc.xbar_lcl < TARGET - SIGMA && spc.xbar_ucl > TARGET + SIGMA);
+
+    // an in-control lot raises nothing
+    spc_reset(&spc);
+    for(uint32_t i = 0; i < 100; i++)
+	alarms |= spc_push(&spc, package(TARGET));
+    CHECK(alarms == SPC_ALARM_NONE);
+}
+
+static void test_shift(void) {
+    // sigma given, so the run lengths are the charts' own and not those of an estimate
+    Spc spc;
+    CHECK(spc_init(&spc, TARGET, LOWER_LIMIT, SUBGROUP, SIGMA));
+    for(uint32_t i = 0; i < SPC_BASELINE_SUBGROUPS * SUBGROUP; i++)
+	spc_push(&spc, package(TARGET));
+
+    // in control the charts run hundreds of packages between false alarms
+    double cusum, ewma, xbar;
+    run_lengths(&spc, TARGET, &cusum, &ewma, &xbar);
+    CHECK(cusum > 200 && ewma > 200 && xbar > 200);
+
+    // 2 sigma low: about 4 packages for this cusum, a few for the ewma with its narrow
+    // starting limits, and the first or second subgroup for X-bar at n = 5
+    run_lengths(&spc, TARGET - 2 * SIGMA, &cusum, &ewma, &xbar);
+    CHECK(cusum > 3.5 && cusum < 4.5);
+    CHECK(ewma > 2 && ewma < 8);
+    CHECK(xbar >= SUBGROUP && xbar < 2 * SUBGROUP);
+}
+
+static void test_underfill(void) {
+    Spc spc;
+    CHECK(spc_init(&spc, TARGET, LOWER_LIMIT, SUBGROUP, SIGMA));
+    CHECK(spc_underfill_rate(&spc) == 0);
+    CHECK(spc_push(&spc, LOWER_LIMIT - 0.001f) & SPC_ALARM_UNDERFILL);
+    CHECK(!(spc_push(&spc, LOWER_LIMIT) & SPC_ALARM_UNDERFILL)); // on the limit is in tolerance
+    CHECK(!(spc_push(&spc, LOWER_LIMIT + 0.001f) & SPC_ALARM_UNDERFILL));
+    spc_push(&spc, NAN); // a faulted weighing isn't a package
+    CHECK(spc.packages == 3 && spc.underfills == 1);
+    CHECK_NEAR(spc_underfill_rate(&spc), 1.0 / 3, 1e-6);
+
+    // a lot centred 2 sigma above the limit has about 2.3 % under it
+    spc_reset(&spc);
+    CHECK(spc.packages == 0 && spc.underfills == 0);
+    uint32_t under = 0;
+    for(uint32_t i = 0; i < 10000; i++) {
+	float kgs = package(LOWER_LIMIT + 2 * SIGMA);
+	under += kgs < LOWER_LIMIT;
+	spc_push(&spc, kgs);
+    }
+    CHECK(spc.packages == 10000 && spc.underfills == under);
+    CHECK_NEAR(spc_underfill_rate(&spc), under / 10000.0, 1e-6);
+    CHECK_NEAR(spc_underfill_rate(&spc), 0.0228, 0.005);
+}
+
+int main(void) {
+    test_reset();
+    test_baseline();
+    test_shift();
+    test_underfill();
+    return TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+/* ****************************************************************************/
+/** Startup Tests
+
+  @File Name
+    test_startup.c
+
+  @Summary
+    Boot to first valid reading on a steady and on a settling load, and the threshold
+    states after boot
+
+  @Description
+    The latency is read from the simulated ms clock, so it's measured from power on like on
+    the target. A steady load has to be valid straight after the discarded conversions and
+    one stability window, a settling one only once it has stopped moving.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+
+#define APP_BOOT_MS 300 // time the application takes before it calls startup
+
+/*
+    @brief A load still settling after power on, 50 g decaying with a 0.5 s time constant
+*/
+static void settling(void) {
+    sim_mv = 1 + 0.05f * expf(-(float)sim_time_us / 500000);
+}
+
+/*
+    @brief Power on, boot the application and start up
+
+    @ret Startup status
+*/
+static sg_status_t boot(void) {
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    strain_gauge_set_clock(sim_millis);
+    sim_advance(APP_BOOT_MS * 1000);
+    return strain_gauge_startup(NULL, 10000);
+}
+
+static void test_steady(void) {
+    CHECK(boot() == SG_OK);
+    CHECK(strain_gauge_is_valid() && strain_gauge_is_stable());
+    uint32_t latency = strain_gauge_boot_latency_ms();
+    CHECK(latency == sim_millis());
+    // discard + one window of 800 ms, a conversion every 100 ms
+    uint32_t window = (SG_STARTUP_DISCARD + SG_STABLE_TIME_MS / 100) * 100;
+    CHECK(latency >= APP_BOOT_MS + window - 100 && latency <= APP_BOOT_MS + window);
+    printf("boot to valid, steady load: %" PRIu32 " ms\n", latency);
+
+    // without a clock it's estimated from the conversions read
+    sim_reset();
+    sim_mv = 1;
+    strain_gauge_set_clock(NULL);
+    CHECK(strain_gauge_startup(NULL, 10000) == SG_OK);
+    CHECK(strain_gauge_boot_latency_ms() == window);
+}
+
+static void test_settling(void) {
+    strain_gauge_set_wait_hook(settling);
+    CHECK(boot() == SG_OK);
+    strain_gauge_set_wait_hook(NULL);
+    uint32_t latency = strain_gauge_boot_latency_ms();
+    CHECK(latency > APP_BOOT_MS + (SG_STARTUP_DISCARD + SG_STABLE_TIME_MS / 100) * 100);
+    CHECK(latency < 10000);
+    float kgs = NAN;
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    CHECK_NEAR(kgs, 1, 2 * SG_STABLE_BAND);
+    printf("boot to valid, settling load: %" PRIu32 " ms\n", latency);
+}
+
+static uint8_t rising, falling;
+
+static void on_threshold(sg_event_t event, float weight, void * context) {
+    (void)weight;
+    (void)context;
+    rising += event == SG_EVENT_RISING;
+    falling += event == SG_EVENT_FALLING;
+}
+
+static void test_thresholds(void) {
+    // both thresholds left above by a heavy load read before the restart
+    float kgs = NAN;
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    CHECK(strain_gauge_add_threshold(0.5f, 0.05f, on_threshold, NULL) >= 0);
+    CHECK(strain_gauge_add_threshold(2, 0.05f, on_threshold, NULL) >= 0);
+    sim_mv = 3;
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+
+    // booting onto a load between them isn't a crossing
+    rising = falling = 0;
+    sim_mv = 1;
+    CHECK(strain_gauge_startup(NULL, 10000) == SG_OK);
+    CHECK(rising == 0 && falling == 0);
+
+    // the states came from the boot weight, so real crossings are still seen
+    sim_mv = 0.2f;
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    CHECK(rising == 0 && falling == 1);
+    sim_mv = 2.5f;
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    CHECK(rising == 2 && falling == 1);
+}
+
+int main(void) {
+    test_steady();
+    test_settling();
+    test_thresholds();
+    return TEST_RESULT();
+}
@@ -0,0 +1,156 @@
+/* ****************************************************************************/
+/** Statistics Tests
+
+  @File Name
+    test_stats.c
+
+  @Summary
+    Running mean and variance over a long batch of heavy, nearly equal readings, P-square
+    percentiles against the sorted samples, and a reset between batches
+
+  @Description
+    A filling line weighing the same 1000 kg product all shift, with a spread of a few
+    grams. A float mean and sum of squares can't hold the spread next to the weight and
+    the standard deviation drifts off; the accumulator has to keep it. The percentile
+    estimates of a normal and a skewed stream are checked against the exact percentiles of
+    the same samples sorted.
+******************************************************************************/
+
+#include "stats.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define BATCH 1000000
+#define SAMPLES 20000 // percentile streams
+
+static float sorted[SAMPLES];
+
+/*
+    @brief Reading i of the batch, a -5 to +5 g sawtooth on 1000 kg
+*/
+static float reading(uint32_t i) {
+    return 1000 + 0.001f * (float)(i % 11) - 0.005f;
+}
+
+static void test_long_batch(void) {
+    Stats st;
+    stats_init(&st);
+    double sum = 0, ss = 0;
+    for(uint32_t i = 0; i < BATCH; i++) {
+	stats_push(&st, reading(i));
+	sum += reading(i);
+    }
+    // two pass reference in double over the same float readings
+    double mean = sum / BATCH;
+    for(uint32_t i = 0; i < BATCH; i++)
+	ss += (reading(i) - mean) * (reading(i) - mean);
+    double expected = sqrt(ss / (BATCH - 1));
+    CHECK(st.count == BATCH);
+    CHECK_NEAR(st.mean, mean, 1e-6);
+    CHECK_NEAR(stats_stddev(&st), expected, expected * 0.001);
+    CHECK(st.min < 999.996f && st.max > 1000.004f);
+}
+
+/*
+    @brief xorshift32, repeatable across platforms unlike rand()
+*/
+static uint32_t next(uint32_t * state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/*
+    @brief Uniform value in (0, 1]
+*/
+static double uniform(uint32_t * state) {
+    return (next(state) + 1.0) / 4294967296.0;
+}
+
+static int compare(const void * a, const void * b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+    @brief Exact percentile of the sorted samples, the sample at rank p * (n - 1)
+*/
+static float exact(float p, uint32_t n) {
+    return sorted[(uint32_t)lround(p * (n - 1))];
+}
+
+static void test_quantiles(void) {
+    static const float p[] = {0.05f, 0.5f, 0.95f, 0.99f};
+    Stats st;
+    stats_init(&st);
+    for(uint8_t i = 0; i < 4; i++)
+	CHECK(stats_add_quantile(&st, p[i]));
+    CHECK(!stats_add_quantile(&st, 0.25f)); // full
+    CHECK(isnan(stats_quantile(&st, 0.5f))); // no samples yet
+    CHECK(isnan(stats_quantile(&st, 0.25f))); // not tracked
+
+    // 500 g packages with a 2 g spread
+    uint32_t state = 2024;
+    for(uint32_t i = 0; i < SAMPLES; i++) {
+	sorted[i] = 500 + 2 * (float)(sqrt(-2 * log(uniform(&state))) * cos(6.283185307179586 * uniform(&state)));
+	stats_push(&st, sorted[i]);
+    }
+    qsort(sorted, SAMPLES, sizeof(sorted[0]), compare);
+    for(uint8_t i = 0; i < 4; i++)
+	CHECK_NEAR(stats_quantile(&st, p[i]), exact(p[i], SAMPLES), 0.05); // 0.025 sigma
+    CHECK(st.min == sorted[0] && st.max == sorted[SAMPLES - 1]);
+
+    // skewed, exponential settling times with a 40 ms mean, the tail is what matters
+    stats_reset(&st);
+    for(uint32_t i = 0; i < SAMPLES; i++) {
+	sorted[i] = -40 * (float)log(uniform(&state));
+	stats_push(&st, sorted[i]);
+    }
+    qsort(sorted, SAMPLES, sizeof(sorted[0]), compare);
+    for(uint8_t i = 0; i < 4; i++)
+	CHECK_NEAR(stats_quantile(&st, p[i]), exact(p[i], SAMPLES), 0.02 * exact(p[i], SAMPLES) + 0.1);
+
+    // exact from the sorted markers while there are 5 samples or fewer
+    static const float few[] = {7, 3, 9, 1, 5};
+    stats_reset(&st);
+    for(uint8_t i = 0; i < 5; i++)
+	stats_push(&st, few[i]);
+    CHECK(stats_quantile(&st, 0.5f) == 5);
+    CHECK(stats_quantile(&st, 0.05f) == 1);
+    CHECK(stats_quantile(&st, 0.99f) == 9);
+}
+
+static void test_reset(void) {
+    Stats st;
+    stats_init(&st);
+    CHECK(stats_add_quantile(&st, 0.5f));
+    CHECK(!stats_add_quantile(&st, 0) && !stats_add_quantile(&st, 1));
+
+    // a heavy first batch, then a light one that mustn't see any of it
+    for(uint32_t i = 0; i < 1000; i++)
+	stats_push(&st, 1000 + (float)(i % 10));
+    CHECK_NEAR(st.mean, 1004.5, 1e-6);
+    stats_reset(&st);
+    CHECK(st.count == 0 && isnan(stats_quantile(&st, 0.5f)));
+    CHECK(stats_variance(&st) == 0);
+    CHECK(st.quantile_cnt == 1); // still tracked
+
+    for(uint32_t i = 0; i < 999; i++) {
+	stats_push(&st, 10 + (float)(i % 3));
+	stats_push(&st, NAN); // a faulted reading
+    }
+    CHECK(st.count == 999);
+    CHECK_NEAR(st.mean, 11, 1e-6);
+    CHECK(st.min == 10 && st.max == 12);
+    CHECK_NEAR(stats_stddev(&st), sqrt(666.0 / 998), 1e-6);
+    CHECK_NEAR(stats_quantile(&st, 0.5f), 11, 0.5);
+}
+
+int main(void) {
+    test_long_batch();
+    test_quantiles();
+    test_reset();
+    return TEST_RESULT();
+}
@@ -0,0 +1,56 @@
+/* ****************************************************************************/
+/** Timeout Tests
+
+  @File Name
+    test_timeout.c
+
+  @Summary
+    Every acquisition call gives up on a dead amplifier
+
+  @Description
+    With DOUT stuck high the simulated adc_read() aborts, because on the target it would
+    hang waiting for the conversion, so a call that reads without waiting fails the test.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+
+static void test_dead(void) {
+    float kgs;
+    uint64_t start;
+    sim_dead = true;
+
+    start = sim_time_us;
+    CHECK(isnan(read_kgs()));
+    CHECK(strain_gauge_get_faults() & SG_FAULT_TIMEOUT);
+    CHECK(sim_time_us - start <= SG_DEFAULT_TIMEOUT_MS * 1000ull + SG_WAIT_POLL_US);
+
+    CHECK(isnan(read_lbs()));
+    CHECK(isnan(read_average(3)));
+    CHECK(read_kgs_timeout(50, &kgs) == SG_ERR_TIMEOUT);
+    CHECK(strain_gauge_tare_timeout(200) == SG_ERR_TIMEOUT);
+    CHECK(strain_gauge_get_mode() != SG_MODE_TARING);
+    CHECK(strain_gauge_read(&kgs) == SG_ERR_TIMEOUT);
+    int32_t raw[4];
+    CHECK(strain_gauge_capture_raw(raw, 4, 200) == SG_ERR_TIMEOUT);
+    CHECK(read_raw_oversampled(1, 200, raw) == SG_ERR_TIMEOUT);
+}
+
+static void test_recover(void) {
+    sim_dead = false;
+    sim_mv = 2;
+    float kgs = read_kgs();
+    CHECK_NEAR(kgs, 10.0 / (SIM_VE * 2) * 2, 0.01);
+    CHECK(!(strain_gauge_get_faults() & SG_FAULT_TIMEOUT));
+    CHECK_NEAR(read_lbs(), kgs / 0.45359237, 0.01);
+}
+
+int main(void) {
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    test_dead();
+    test_recover();
+    return TEST_RESULT();
+}
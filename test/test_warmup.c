@@ -0,0 +1,82 @@
+/* ****************************************************************************/
+/** Warm-up Drift Tests
+
+  @File Name
+    test_warmup.c
+
+  @Summary
+    Fit of the warm-up model to a power up log and the compensation of readings taken at
+    irregular times
+
+  @Description
+    The simulated bridge drifts exponentially from power on. The model fitted from the log
+    has to take the drift off readings whenever they are taken, including after long gaps
+    with no conversions read, because time since power on comes from the clock.
+******************************************************************************/
+
+#include "strain_gauge.h"
+#include "sim_adc.h"
+#include "test.h"
+
+#define DRIFT_COUNTS 200000.0f // drift at power on, about 0.47 kg here
+#define DRIFT_TAU 20.0f // s
+#define LOG_LEN 1200 // 2 minutes at 10 SPS
+
+static float counts_mv; // mV per count
+
+/*
+    @brief Bridge output at the current simulated time, 1 kg plus the drift
+*/
+static void drifting(void) {
+    float t = (float)sim_time_us / 1000000;
+    sim_mv = 1 + DRIFT_COUNTS * expf(-t / DRIFT_TAU) * counts_mv;
+}
+
+static void test_fit(WarmupModel * model) {
+    static int32_t power_up[LOG_LEN];
+    for(uint32_t i = 0; i < LOG_LEN; i++)
+	power_up[i] = sim_counts(1) + (int32_t)lroundf(DRIFT_COUNTS * expf(-(i / 10.0f) / DRIFT_TAU));
+    CHECK(warmup_model_fit(power_up, LOG_LEN, 10, model));
+    CHECK_NEAR(model->amplitude, DRIFT_COUNTS, DRIFT_COUNTS * 0.01);
+    CHECK_NEAR(model->tau, DRIFT_TAU, DRIFT_TAU * 0.01);
+    WarmupModel short_log;
+    CHECK(!warmup_model_fit(power_up, 100, 10, &short_log)); // 10 s doesn't see it settle
+}
+
+static void test_compensation(const WarmupModel * model) {
+    float kgs = NAN;
+    sim_reset();
+    strain_gauge_init(SIM_VE, 10, 2);
+    strain_gauge_set_equation(1, 0);
+    strain_gauge_set_clock(sim_millis);
+    strain_gauge_set_warmup(model);
+    strain_gauge_set_wait_hook(drifting);
+
+    // right after power on, then after gaps with nothing read
+    const uint32_t gaps_ms[] = {100, 5000, 30000, 1000, 60000};
+    for(uint8_t i = 0; i < sizeof(gaps_ms) / sizeof(gaps_ms[0]); i++) {
+	sim_advance(gaps_ms[i] * 1000);
+	drifting();
+	CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+	CHECK_NEAR(kgs, 1, 0.002);
+    }
+
+    // without a clock there's no time since power on, so nothing is taken off
+    sim_reset();
+    strain_gauge_set_clock(NULL);
+    strain_gauge_set_warmup(model);
+    sim_advance(5000 * 1000);
+    drifting();
+    CHECK(read_kgs_timeout(1000, &kgs) == SG_OK);
+    CHECK(kgs > 1.3f);
+    strain_gauge_set_wait_hook(NULL);
+    strain_gauge_set_warmup(NULL);
+}
+
+int main(void) {
+    WarmupModel model = {0, 0};
+    counts_mv = ldexpf(1000.0f * 0.5f * SIM_VE / 128, -23);
+    test_fit(&model);
+    test_compensation(&model);
+    return TEST_RESULT();
+}
@@ -0,0 +1,362 @@
+/* ****************************************************************************/
+/** Remote Command Tool
+
+  @File Name
+    sgcmd.c
+
+  @Summary
+    Host command line tool that drives the scale over a serial port with the command.h
+    protocol
+
+  @Description
+    Sends one request and prints the response. Uses command_encode_request() and
+    command_decode_response() from command.c built with COMMAND_HOST, so the framing is the
+    same code the device runs. POSIX only: termios for the port, poll() for the timeout.
+
+    sgcmd [-d device] [-b baud] [-t timeout_ms] command [args]
+******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "command.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+#define DEFAULT_BAUD 115200
+#define DEFAULT_TIMEOUT_MS 10000 // a tare or calibration point averages for a few seconds
+
+// exit codes
+#define EXIT_STATUS 1 // the scale answered with an error status
+#define EXIT_USAGE 2 // bad arguments, port or no answer
+
+// sg_status_t as the scale reports it
+static const char * const status_names[] = {
+    [SG_OK] = "ok",
+    [SG_ERR_TIMEOUT] = "timeout, no sample from the adc",
+    [SG_ERR_FAULT] = "bridge fault",
+    [SG_BUSY] = "busy",
+    [SG_ERR_BUSY] = "busy, a tare or calibration is already running",
+    [SG_ERR_INVALID] = "invalid command or value",
+    [SG_ERR_FULL] = "audit log full, read out and release the audit log first",
+};
+
+static const struct {
+    const char * name;
+    uint8_t id;
+    const char * args;
+} commands[] = {
+    {"read", COMMAND_READ, ""},
+    {"status", COMMAND_STATUS, ""},
+    {"tare", COMMAND_TARE, ""},
+    {"zero", COMMAND_ZERO, ""},
+    {"cal-begin", COMMAND_CAL_BEGIN, ""},
+    {"cal-point", COMMAND_CAL_POINT, "<kg>"},
+    {"cal-commit", COMMAND_CAL_COMMIT, ""},
+    {"cal-abort", COMMAND_CAL_ABORT, ""},
+    {"stats", COMMAND_STATS, "[reset]"},
+    {"get", COMMAND_PARAM_GET, "<id>"},
+    {"set", COMMAND_PARAM_SET, "<id> <value, with a . for a float parameter>"},
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+static void usage(void) {
+    fprintf(stderr, "usage: sgcmd [-d device] [-b baud] [-t timeout_ms] command [args]\n"
+	    "  device defaults to " DEFAULT_DEVICE ", baud to %d\n\ncommands:\n", DEFAULT_BAUD);
+    for(size_t i = 0; i < COMMAND_COUNT; i++)
+	fprintf(stderr, "  %s %s\n", commands[i].name, commands[i].args);
+    exit(EXIT_USAGE);
+}
+
+/*
+    @brief termios speed for a baud rate
+
+    @ret Speed, B0 if unsupported
+*/
+static speed_t baud_speed(long baud) {
+    switch(baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	default: return B0;
+    }
+}
+
+/*
+    @brief Open the port raw, 8N1, no flow control
+
+    @ret File descriptor, -1 on error
+*/
+static int open_port(const char * device, speed_t speed) {
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if(fd < 0)
+	return -1;
+    struct termios tio;
+    if(tcgetattr(fd, &tio) != 0) {
+	close(fd);
+	return -1;
+    }
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if(cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0 || tcsetattr(fd, TCSANOW, &tio) != 0) {
+	close(fd);
+	return -1;
+    }
+    tcflush(fd, TCIOFLUSH); // drop anything left from an earlier session
+    return fd;
+}
+
+/*
+    @brief Write all of buf, a serial port can take it in parts
+
+    @ret true if it was all written
+*/
+static bool write_all(int fd, const uint8_t * buf, size_t len) {
+    while(len > 0) {
+	ssize_t n = write(fd, buf, len);
+	if(n < 0 && errno == EINTR)
+	    continue;
+	if(n <= 0)
+	    return false;
+	buf += n;
+	len -= (size_t)n;
+    }
+    return true;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+    @brief Wait for the response to a request
+
+    @note Skips bytes until a sync byte, and drops the sync byte of a frame that fails its
+	crc so the search carries on inside it. Responses to other requests are ignored.
+
+    @ret true if the response arrived before the timeout
+*/
+static bool receive(int fd, uint8_t id, uint8_t seq, int timeout_ms, CommandResponse * resp) {
+    uint8_t buf[4 * (COMMAND_MAX_PAYLOAD + COMMAND_RESPONSE_OVERHEAD)];
+    size_t len = 0;
+    int64_t deadline = now_ms() + timeout_ms;
+    for(;;) {
+	// drop whatever can't start a good frame
+	size_t skip = 0;
+	while(skip < len) {
+	    if(buf[skip] != COMMAND_SYNC_RESPONSE) {
+		skip++;
+		continue;
+	    }
+	    size_t n = command_decode_response(&buf[skip], len - skip, resp);
+	    if(n > 0) {
+		memmove(buf, &buf[skip + n], len - skip - n);
+		len -= skip + n;
+		skip = 0;
+		if(resp->cmd == id && resp->seq == seq)
+		    return true;
+		continue;
+	    }
+	    // complete but corrupted, or a length no response has
+	    if(len - skip >= COMMAND_RESPONSE_OVERHEAD && (buf[skip + 4] > COMMAND_MAX_PAYLOAD ||
+		    len - skip >= (size_t)buf[skip + 4] + COMMAND_RESPONSE_OVERHEAD)) {
+		skip++;
+		continue;
+	    }
+	    break; // the rest is still to come
+	}
+	memmove(buf, &buf[skip], len - skip);
+	len -= skip;
+
+	int64_t left = deadline - now_ms();
+	if(left <= 0)
+	    return false;
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	int ready = poll(&pfd, 1, (int)left);
+	if(ready < 0 && errno != EINTR)
+	    return false;
+	if(ready <= 0)
+	    continue;
+	ssize_t n = read(fd, &buf[len], sizeof(buf) - len);
+	if(n < 0 && errno != EINTR && errno != EAGAIN)
+	    return false;
+	if(n > 0)
+	    len += (size_t)n;
+    }
+}
+
+/*
+    @brief Parse a number argument
+
+    @ret true if all of arg was a number
+*/
+static bool parse_u32(const char * arg, uint32_t * v) {
+    char * end;
+    errno = 0;
+    unsigned long n = strtoul(arg, &end, 0);
+    *v = (uint32_t)n;
+    return *arg != '\0' && *end == '\0' && errno == 0 && n <= UINT32_MAX;
+}
+
+static bool parse_f32(const char * arg, float * v) {
+    char * end;
+    *v = strtof(arg, &end);
+    return *arg != '\0' && *end == '\0';
+}
+
+/*
+    @brief Print a response payload the way its command defines it
+*/
+static void print_response(uint8_t id, const CommandResponse * resp) {
+    const uint8_t * p = resp->payload;
+    switch(id) {
+	case COMMAND_READ:
+	    printf("%.4f kg\n", command_get_f32(p));
+	    break;
+	case COMMAND_STATUS:
+	    printf("mode %u, faults 0x%02X, %s, calibration version %" PRIu32 "\n",
+		    p[0], p[1], p[2] ? "valid" : "not valid", command_get_u32(&p[3]));
+	    break;
+	case COMMAND_TARE:
+	case COMMAND_ZERO:
+	    printf("offset %.4f kg\n", command_get_f32(p));
+	    break;
+	case COMMAND_CAL_POINT:
+	    printf("measured %.4f kg (rated output, uncalibrated)\n", command_get_f32(p));
+	    break;
+	case COMMAND_CAL_COMMIT:
+	    printf("slope %.6f, intercept %.6f\n", command_get_f32(p), command_get_f32(&p[4]));
+	    break;
+	case COMMAND_STATS:
+	    printf("count %" PRIu32 ", mean %.4f, stddev %.4f, min %.4f, max %.4f\n", command_get_u32(p),
+		    command_get_f32(&p[4]), command_get_f32(&p[8]), command_get_f32(&p[12]), command_get_f32(&p[16]));
+	    break;
+	case COMMAND_PARAM_GET:
+	case COMMAND_PARAM_SET: {
+	    // the type isn't sent, so show both readings of the bits
+	    uint32_t v = command_get_u32(&p[2]);
+	    printf("param %u = %" PRIu32 " (as float %g)\n", p[0] | p[1] << 8, v, command_get_f32(&p[2]));
+	    break;
+	}
+	default:
+	    printf("ok\n");
+	    break;
+    }
+}
+
+int main(int argc, char ** argv) {
+    const char * device = DEFAULT_DEVICE;
+    long baud = DEFAULT_BAUD;
+    long timeout_ms = DEFAULT_TIMEOUT_MS;
+    int opt;
+    while((opt = getopt(argc, argv, "d:b:t:")) != -1) {
+	switch(opt) {
+	    case 'd': device = optarg; break;
+	    case 'b': baud = strtol(optarg, NULL, 10); break;
+	    case 't': timeout_ms = strtol(optarg, NULL, 10); break;
+	    default: usage();
+	}
+    }
+    if(optind >= argc || baud_speed(baud) == B0 || timeout_ms <= 0 || timeout_ms > INT32_MAX)
+	usage();
+
+    const char * name = argv[optind];
+    char ** args = &argv[optind + 1];
+    int nargs = argc - optind - 1;
+    size_t c = 0;
+    while(c < COMMAND_COUNT && strcmp(commands[c].name, name) != 0)
+	c++;
+    if(c == COMMAND_COUNT)
+	usage();
+    uint8_t id = commands[c].id;
+
+    uint8_t payload[COMMAND_MAX_PAYLOAD];
+    uint8_t len = 0;
+    uint32_t u;
+    float f;
+    switch(id) {
+	case COMMAND_CAL_POINT:
+	    if(nargs != 1 || !parse_f32(args[0], &f))
+		usage();
+	    command_put_f32(payload, f);
+	    len = 4;
+	    break;
+	case COMMAND_STATS:
+	    if(nargs > 1 || (nargs == 1 && strcmp(args[0], "reset") != 0))
+		usage();
+	    payload[0] = nargs == 1;
+	    len = 1;
+	    break;
+	case COMMAND_PARAM_GET:
+	case COMMAND_PARAM_SET:
+	    if(nargs != (id == COMMAND_PARAM_GET ? 1 : 2) || !parse_u32(args[0], &u) || u > UINT16_MAX)
+		usage();
+	    payload[0] = u & 0xFF;
+	    payload[1] = u >> 8;
+	    len = 2;
+	    if(id == COMMAND_PARAM_SET) {
+		if(strpbrk(args[1], ".eE") != NULL && strncmp(args[1], "0x", 2) != 0) {
+		    if(!parse_f32(args[1], &f))
+			usage();
+		    command_put_f32(&payload[2], f);
+		}
+		else if(parse_u32(args[1], &u))
+		    command_put_u32(&payload[2], u);
+		else
+		    usage();
+		len = 6;
+	    }
+	    break;
+	default:
+	    if(nargs != 0)
+		usage();
+	    break;
+    }
+
+    int fd = open_port(device, baud_speed(baud));
+    if(fd < 0) {
+	fprintf(stderr, "sgcmd: %s: %s\n", device, strerror(errno));
+	return EXIT_USAGE;
+    }
+    uint8_t frame[COMMAND_MAX_PAYLOAD + COMMAND_REQUEST_OVERHEAD];
+    uint8_t seq = (uint8_t)now_ms(); // so a late response to an earlier run doesn't match
+    size_t n = command_encode_request(id, seq, payload, len, frame);
+    CommandResponse resp;
+    if(!write_all(fd, frame, n)) {
+	fprintf(stderr, "sgcmd: %s: %s\n", device, strerror(errno));
+	close(fd);
+	return EXIT_USAGE;
+    }
+    if(!receive(fd, id, seq, (int)timeout_ms, &resp)) {
+	fprintf(stderr, "sgcmd: no response in %ld ms\n", timeout_ms);
+	close(fd);
+	return EXIT_USAGE;
+    }
+    close(fd);
+
+    if(resp.status != SG_OK) {
+	const char * status = (size_t)resp.status < sizeof(status_names) / sizeof(status_names[0]) &&
+		status_names[resp.status] != NULL ? status_names[resp.status] : "unknown status";
+	fprintf(stderr, "sgcmd: %s: %s (%u)\n", name, status, (unsigned)resp.status);
+	return EXIT_STATUS;
+    }
+    print_response(id, &resp);
+    return EXIT_SUCCESS;
+}